@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "driver/gpio.h"
+#include "soc/gpio_reg.h" // GPIO_IN_REG, GPIO_IN1_REG
 #include "esp_timer.h" // esp_timer_get_time
 #include "esp_log.h"
 
@@ -17,19 +18,29 @@ namespace {
 // timer task for ESP32
 esp_timer_handle_t periodic_timer;
 
+// read a whole GPIO port in one register read
+// port 0 is gpio 0-31, port 1 is gpio 32-39
+uint32_t ReadPinsESP32(int port, uint32_t portMask)
+{
+    const uint32_t levels = port == 0 ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+    return levels & portMask;
+}
+
+// adaptive sampling, restart the timer at a new period
+// called from the timer task, so stopping our own timer is fine
+void SetSamplePeriodESP32(uint32_t periodMs)
+{
+    esp_timer_stop(periodic_timer); // error if not running, ignore
+    if (periodMs > 0)
+        ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, periodMs * 1000));
+}
+
 // timer interrupt for buttons
 void ButtonISR(void*)
 {
-    uint64_t elapsedMs = ButtonHW::ElapsedMs();
-    // process each button
-    for (auto & b : Button::buttonPtrs)
-    {
-        auto level = gpio_get_level((gpio_num_t)b->GpioNum());
-        auto isDown = level!=0; // assume down is high
-        if (!b->DownIsHigh())
-            isDown = !isDown;
-        b->DebounceInput(isDown, elapsedMs); // call debouncer code
-    }
+    uint64_t elapsedMs = ButtonHW::NowMs();
+    // process all buttons, one register read per port
+    Button::SamplePorts(elapsedMs);
 }
 
 } // anonymous namespace
@@ -38,6 +49,8 @@ namespace Lomont { namespace ButtonHelpers { namespace ButtonHW {
 
 void StartDebouncerInterrupt()
 {
+    ReadPins = ReadPinsESP32; // batched reads supported
+    SetSamplePeriodMs = SetSamplePeriodESP32; // slow down while buttons idle
 
     const esp_timer_create_args_t periodic_timer_args = {
                 .callback = ButtonISR,
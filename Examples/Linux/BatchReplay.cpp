@@ -0,0 +1,266 @@
+// fleet trace analysis: replay many device traces against several candidate
+// timing sets at once, on a work stealing pool, and total the match counts
+// and latencies per candidate. Each replay is its own button system (see
+// TraceReplay.h), so no process globals are shared between tasks.
+//   batch_replay               - record a synthetic fleet to build/fleet, analyze it
+//   batch_replay FILE...       - analyze the given traces
+// Runs are repeated over thread counts, every run must give the same totals
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "ClickModel.h"
+#include "TraceReplay.h"
+#include "WorkStealing.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+const int devices = 32;
+const uint64_t deviceMs = 15 * 60 * 1000; // 15 minutes each
+const int buttonsPerDevice = 4;
+
+const char* patternNames[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+
+// a timing set to try
+struct Candidate
+{
+    string name;
+    int debounceSamples; // 0 for the trace's own
+    vector<FSMDef> patterns;
+};
+
+vector<Candidate> Candidates()
+{
+    vector<Candidate> candidates;
+    const auto add = [&](const char* name, PatternTimings timings, int debounceSamples = 0)
+    {
+        candidates.push_back(Candidate{ name, debounceSamples, Button::MakeDefaultPatterns(timings) });
+    };
+    const auto defaults = PatternTimings::Current();
+    add("default", defaults);
+
+    auto fast = defaults;
+    fast.clickUpHighMs = fast.clickDownHighMs = 150;
+    add("fast clicks", fast);
+
+    auto slow = defaults;
+    slow.clickUpHighMs = slow.clickDownHighMs = 280;
+    add("slow clicks", slow);
+
+    auto holds = defaults;
+    holds.mediumPressMs = 450;
+    holds.longPressMs = 1800;
+    add("short holds", holds);
+
+    add("debounce 10", defaults, 10);
+    return candidates;
+}
+
+// record each device to build/fleet, click speed and polarity vary by device
+vector<string> RecordFleet()
+{
+    mkdir("build/fleet", 0755);
+    ButtonSim::UseVirtualClock();
+    mt19937 rand(12345);
+    vector<string> paths;
+    static uint8_t buffer[4096];
+    for (auto d = 0; d < devices; ++d)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "build/fleet/device-%03d.trace", d);
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            printf("ERROR - cannot write %s\n", path);
+            continue;
+        }
+        const bool downIsHigh = (rand() & 1) != 0;
+        const double medianMs = uniform_real_distribution<double>(100, 220)(rand);
+        TraceRecorder recorder(buffer, sizeof(buffer), ButtonSim::FileSink, file);
+        {
+            vector<ButtonPtr> buttons;
+            for (auto gpio = 0; gpio < buttonsPerDevice; ++gpio)
+            {
+                ButtonSim::SetPin(gpio, !downIsHigh);
+                buttons.push_back(make_shared<Button>(gpio, downIsHigh));
+            }
+            Button::trace = &recorder;
+            const uint64_t startMs = ButtonSim::NowMs();
+            for (auto gpio = 0; gpio < buttonsPerDevice; ++gpio)
+            {
+                ButtonSim::ClickModel model(d * 100 + gpio);
+                model.medianMs = medianMs;
+                for (auto& e : model.Edges(startMs, startMs + deviceMs))
+                    ButtonSim::SetPinAt(e.atMs, gpio, e.down == downIsHigh);
+            }
+            ButtonSim::RunUntil(startMs + deviceMs);
+            Button::trace = nullptr;
+            recorder.Finish();
+        }
+        fclose(file);
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+// totals for one candidate
+struct Totals
+{
+    uint64_t passes{ 0 };
+    uint64_t spanMs{ 0 };
+    uint64_t edges{ 0 };
+    uint64_t mismatches{ 0 };
+    uint64_t damaged{ 0 };
+    vector<ButtonSim::PatternStats> stats;
+
+    void Add(const ButtonSim::ReplayResult& r)
+    {
+        passes += r.passes;
+        spanMs += r.spanMs;
+        edges += r.edges;
+        mismatches += r.mismatches;
+        damaged += r.ok ? 0 : 1;
+        stats.resize(max(stats.size(), r.stats.size()));
+        for (auto p = 0U; p < r.stats.size(); ++p)
+            stats[p].Merge(r.stats[p]);
+    }
+
+    void Merge(const Totals& t)
+    {
+        passes += t.passes;
+        spanMs += t.spanMs;
+        edges += t.edges;
+        mismatches += t.mismatches;
+        damaged += t.damaged;
+        stats.resize(max(stats.size(), t.stats.size()));
+        for (auto p = 0U; p < t.stats.size(); ++p)
+            stats[p].Merge(t.stats[p]);
+    }
+
+    bool operator==(const Totals& t) const
+    {
+        if (passes != t.passes || edges != t.edges || mismatches != t.mismatches || stats.size() != t.stats.size())
+            return false;
+        for (auto p = 0U; p < stats.size(); ++p)
+            if (stats[p].counts != t.stats[p].counts || stats[p].latency != t.stats[p].latency)
+                return false;
+        return true;
+    }
+};
+
+// every trace against every candidate on workers threads
+vector<Totals> Analyze(const vector<unique_ptr<ButtonSim::MappedTrace>>& traces,
+    const vector<Candidate>& candidates, int workers, size_t& stolen)
+{
+    // each worker totals its own tasks, merged at the end, no sharing
+    vector<vector<Totals>> perWorker(workers, vector<Totals>(candidates.size()));
+    ButtonSim::WorkStealingPool pool;
+    stolen = pool.Run(traces.size() * candidates.size(), workers, [&](int worker, size_t index)
+    {
+        const auto& trace = *traces[index / candidates.size()];
+        const auto c = index % candidates.size();
+        ButtonSim::ReplayConfig config;
+        config.debounceSamples = candidates[c].debounceSamples;
+        config.patterns = &candidates[c].patterns;
+        config.keepReports = false;
+        perWorker[worker][c].Add(ButtonSim::Replay(trace.Data(), trace.Size(), config));
+    });
+    vector<Totals> totals(candidates.size());
+    for (auto& w : perWorker)
+        for (auto c = 0U; c < candidates.size(); ++c)
+            totals[c].Merge(w[c]);
+    return totals;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    vector<string> paths;
+    for (auto i = 1; i < argc; ++i)
+        paths.push_back(argv[i]);
+    if (paths.empty())
+    {
+        const auto start = chrono::steady_clock::now();
+        paths = RecordFleet();
+        printf("recorded %zu devices, %d buttons each, %.0f minutes each, in %.2f s\n", paths.size(),
+            buttonsPerDevice, deviceMs / 60000.0,
+            chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    vector<unique_ptr<ButtonSim::MappedTrace>> traces;
+    for (auto& p : paths)
+    {
+        auto trace = make_unique<ButtonSim::MappedTrace>(p.c_str());
+        if (trace->Valid())
+            traces.push_back(move(trace));
+    }
+    const auto candidates = Candidates();
+    printf("%zu traces x %zu candidates\n\n", traces.size(), candidates.size());
+
+    const int cores = max(1U, thread::hardware_concurrency());
+    vector<int> threadCounts;
+    for (auto t = 1; t <= max(cores, 4); t *= 2)
+        threadCounts.push_back(t);
+    if (threadCounts.back() != cores && cores > 4)
+        threadCounts.push_back(cores);
+
+    printf("%d cores\n%8s %10s %12s %10s %10s %8s %6s\n", cores, "threads", "wall s", "device h/s", "speedup",
+        "per core", "stolen", "same");
+    vector<Totals> reference;
+    double baseSeconds = 0;
+    bool allSame = true;
+    for (auto workers : threadCounts)
+    {
+        size_t stolen = 0;
+        const auto start = chrono::steady_clock::now();
+        const auto totals = Analyze(traces, candidates, workers, stolen);
+        const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (reference.empty())
+        {
+            reference = totals;
+            baseSeconds = seconds;
+        }
+        const bool same = totals == reference;
+        allSame &= same;
+        const double speedup = baseSeconds / seconds;
+        printf("%8d %10.3f %12.0f %9.2fx %9.0f%% %8zu %6s\n", workers, seconds,
+            totals[0].spanMs * candidates.size() / 3600000.0 / seconds, speedup,
+            100.0 * speedup / min(workers, cores), stolen, same ? "yes" : "NO");
+    }
+
+    printf("\n%-12s %-12s %8s %8s %6s %6s %6s %10s\n", "candidate", "pattern", "reports", "counts", "p50", "p90",
+        "p99", "mismatches");
+    for (auto c = 0U; c < candidates.size(); ++c)
+    {
+        const auto& t = reference[c];
+        for (auto p = 0U; p < t.stats.size(); ++p)
+        {
+            const auto& s = t.stats[p];
+            printf("%-12s %-12s %8llu %8llu %6d %6d %6d", p == 0 ? candidates[c].name.c_str() : "",
+                p < 4 ? patternNames[p] : "", static_cast<unsigned long long>(s.reports),
+                static_cast<unsigned long long>(s.counts), s.Percentile(0.5), s.Percentile(0.9), s.Percentile(0.99));
+            if (p == 0)
+                printf(" %10llu", static_cast<unsigned long long>(t.mismatches));
+            printf("\n");
+        }
+    }
+    printf("latency ms from the button's last raw edge to the first report after it; mismatches are passes\n"
+        "whose debounced edges differ from the recorded ones, expected when debounce differs\n");
+    if (!allSame)
+        printf("ERROR - totals differ between thread counts\n");
+    return allSame ? 0 : 1;
+}
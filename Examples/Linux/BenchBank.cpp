@@ -0,0 +1,173 @@
+// the four default patterns on n buttons: a ButtonFSM per button and
+// pattern (on FSMDefs, then on packed tables) against one FSMBank per
+// pattern holding every button, at 1, 100 and 10,000 buttons
+// patterns update every 10 ms, buttons press at human rates
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "FSMBank.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+constexpr int PassMs = 10;
+
+// button inputs at each pass, pass major
+struct Inputs
+{
+    int buttons{ 0 };
+    int passes{ 0 };
+    vector<uint8_t> down;
+    vector<uint32_t> timeInStateMs;
+};
+
+Inputs MakeInputs(int buttons, int passes)
+{
+    Inputs in;
+    in.buttons = buttons;
+    in.passes = passes;
+    in.down.resize(static_cast<size_t>(buttons) * passes);
+    in.timeInStateMs.resize(in.down.size());
+    mt19937 rand(1234);
+    uniform_int_distribution<int> click(50, 250), hold(600, 3500), gap(60, 400), idle(500, 8000);
+    vector<uint8_t> down(buttons, 0);
+    vector<uint32_t> changedMs(buttons, 0);
+    vector<uint32_t> nextMs(buttons);
+    for (auto& n : nextMs)
+        n = idle(rand);
+    for (auto p = 0; p < passes; ++p)
+    {
+        const uint32_t t = (p + 1) * PassMs;
+        for (auto b = 0; b < buttons; ++b)
+        {
+            while (nextMs[b] <= t)
+            {
+                down[b] ^= 1;
+                changedMs[b] = nextMs[b];
+                if (down[b])
+                    nextMs[b] += (rand() % 5) == 0 ? hold(rand) : click(rand);
+                else
+                    nextMs[b] += (rand() % 3) == 0 ? idle(rand) : gap(rand);
+            }
+            const size_t i = static_cast<size_t>(p) * buttons + b;
+            in.down[i] = down[b];
+            in.timeInStateMs[i] = t - changedMs[b];
+        }
+    }
+    return in;
+}
+
+// per button ButtonFSMs, as HasPatterns keeps them
+struct PerButton
+{
+    vector<ButtonFSM> fsms; // button major, 4 per button
+
+    template<typename Patterns>
+    PerButton(int buttons, const Patterns& patterns)
+    {
+        fsms.reserve(buttons * patterns.size());
+        for (auto b = 0; b < buttons; ++b)
+            for (auto& p : patterns)
+                fsms.emplace_back(&p);
+    }
+
+    void Pass(const Inputs& in, int p)
+    {
+        const uint64_t now = static_cast<uint64_t>(p + 1) * PassMs;
+        const size_t base = static_cast<size_t>(p) * in.buttons;
+        const int per = static_cast<int>(fsms.size()) / in.buttons;
+        for (auto b = 0; b < in.buttons; ++b)
+            for (auto k = 0; k < per; ++k)
+                fsms[b * per + k].Update(b + 1, in.down[base + b] != 0, in.timeInStateMs[base + b], now);
+    }
+
+    int Read0(int b, int pattern, int j) { return fsms[b * 4 + pattern].Read0(j); }
+};
+
+struct Banked
+{
+    vector<FSMBank> banks;
+
+    Banked(int buttons, const vector<FSMTable>& tables)
+    {
+        for (auto& t : tables)
+        {
+            banks.emplace_back(&t);
+            for (auto b = 0; b < buttons; ++b)
+                banks.back().Add(b + 1);
+        }
+    }
+
+    void Pass(const Inputs& in, int p)
+    {
+        const uint64_t now = static_cast<uint64_t>(p + 1) * PassMs;
+        const size_t base = static_cast<size_t>(p) * in.buttons;
+        for (auto& bank : banks)
+            bank.UpdateAll(&in.down[base], &in.timeInStateMs[base], now);
+    }
+
+    int Read0(int b, int pattern, int j) { return banks[pattern].Read0(b, j); }
+};
+
+template<typename Runner>
+double TimeNs(Runner& runner, const Inputs& in)
+{
+    const auto start = chrono::steady_clock::now();
+    for (auto p = 0; p < in.passes; ++p)
+        runner.Pass(in, p);
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main()
+{
+    const auto& defs = Button::DefaultPatterns();
+    const auto& tables = Button::DefaultPatternTables();
+    const int counters[] = { 2, 1, 1, 1 };
+
+    printf("%7s %7s %12s %12s %12s %8s\n", "buttons", "passes", "FSMDef ns", "table ns", "bank ns", "speedup");
+    for (auto buttons : { 1, 100, 10000 })
+    {
+        const int passes = 8000000 / buttons;
+        const auto in = MakeInputs(buttons, passes);
+
+        // same counts every pass
+        {
+            PerButton check(buttons, defs);
+            Banked bank(buttons, tables);
+            int mismatches = 0;
+            for (auto p = 0; p < passes; ++p)
+            {
+                check.Pass(in, p);
+                bank.Pass(in, p);
+                for (auto b = 0; b < buttons; ++b)
+                    for (auto k = 0; k < 4; ++k)
+                        for (auto j = 0; j < counters[k]; ++j)
+                            mismatches += check.Read0(b, k, j) != bank.Read0(b, k, j);
+            }
+            if (mismatches)
+            {
+                printf("ERROR - bank differs from ButtonFSM %d times\n", mismatches);
+                return 1;
+            }
+        }
+
+        PerButton perDef(buttons, defs);
+        PerButton perTable(buttons, tables);
+        Banked bank(buttons, tables);
+        const double updates = 4.0 * buttons * passes;
+        const double defNs = TimeNs(perDef, in) / updates;
+        const double tableNs = TimeNs(perTable, in) / updates;
+        const double bankNs = TimeNs(bank, in) / updates;
+        printf("%7d %7d %12.2f %12.2f %12.2f %7.1fx\n", buttons, passes, defNs, tableNs, bankNs, defNs / bankNs);
+    }
+    printf("ns per pattern update, speedup of bank over FSMDef\n");
+    return 0;
+}
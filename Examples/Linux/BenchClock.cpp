@@ -0,0 +1,149 @@
+// clock reads per pattern update pass: every FSM reading ButtonHW::ElapsedMs
+// itself (the old update path), one read per button, and one TickContext
+// for the whole pass, then a check that a tick taken just before the
+// sampler publishes an edge still reads sane state times
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+enum class Mode { PerFsm, PerButton, TickContext };
+
+// pattern update as it was before TickContext, clock read per FSM
+void UpdatePerFsm(HasPatterns& h, const Button& b)
+{
+    uint64_t timeStateChangedMs;
+    const bool isDown = b.IsDown(&timeStateChangedMs);
+    const uint64_t stateTime = ButtonHW::ElapsedMs() - timeStateChangedMs;
+    for (auto& p : h.patterns)
+        p.Update(b.buttonId, isDown, stateTime);
+}
+
+struct Result
+{
+    double nsPerPass;
+    double clockReadsPerPass;
+};
+
+// pattern passes over pseudo random pin activity
+// only the pattern update is timed and counted, not the sampling
+Result Run(Mode mode, int buttonCount, int passes)
+{
+    for (auto p = 0; p < ButtonSim::Ports; ++p)
+        ButtonSim::SetPort(p, 0);
+
+    vector<ButtonPtr> buttons;
+    for (auto i = 0; i < buttonCount; ++i)
+        buttons.push_back(make_shared<Button>(i, true));
+    ButtonMultiPattern multiPattern;
+    multiPattern.AddTestPatterns();
+
+    mt19937 rand(1234);
+    uint64_t clockReads = 0;
+    chrono::steady_clock::duration elapsed{ 0 };
+    for (auto pass = 0; pass < passes; ++pass)
+    {
+        if ((rand() & 3) == 0)
+            ButtonSim::SetPin(rand() % buttonCount, (rand() & 1) != 0);
+        ButtonSim::Tick(ButtonHW::ElapsedMs());
+
+        const auto reads0 = ButtonSim::ClockReads();
+        const auto start = chrono::steady_clock::now();
+        if (mode == Mode::PerFsm)
+        {
+            for (auto& b : buttons)
+                UpdatePerFsm(*b, *b);
+            for (auto& b : buttons)
+                UpdatePerFsm(multiPattern, *b);
+        }
+        else if (mode == Mode::PerButton)
+        {
+            for (auto& b : buttons)
+                b->UpdatePatternMatches();
+            multiPattern.UpdatePatternMatches();
+        }
+        else
+        {
+            const TickContext tick;
+            for (auto& b : buttons)
+                b->UpdatePatternMatches(tick);
+            multiPattern.UpdatePatternMatches(tick);
+        }
+        elapsed += chrono::steady_clock::now() - start;
+        clockReads += ButtonSim::ClockReads() - reads0;
+    }
+
+    Result r;
+    r.nsPerPass = chrono::duration<double, nano>(elapsed).count() / passes;
+    r.clockReadsPerPass = static_cast<double>(clockReads) / passes;
+    return r;
+}
+
+// state change time read at tick, or ~0 if not down
+uint64_t ChangedAt(const Debouncer& d, uint64_t tick)
+{
+    uint64_t changedMs = 0;
+    return d.IsDown(TickContext(tick), &changedMs) ? changedMs : ~0ULL;
+}
+
+// an edge newer than the pass tick is newer, not 2^31 ms old, and the
+// packed 31 bit time still wraps correctly
+bool CheckStaleTick()
+{
+    bool ok = true;
+    Debouncer d;
+    d.SetDebounced(true, 1000);
+    ok &= ChangedAt(d, 999) == 1000;
+    ok &= ChangedAt(d, 5000) == 1000;
+
+    const uint64_t wrap = 1ULL << 31;
+    d.SetDebounced(true, wrap + 3);
+    ok &= ChangedAt(d, wrap + 5) == wrap + 3;
+    d.SetDebounced(true, wrap - 2);
+    ok &= ChangedAt(d, wrap + 5) == wrap - 2;
+
+    // event driven patterns schedule near the edge, not at ~2^64
+    Button b(0, true);
+    const uint64_t t = 100000;
+    b.SetDebounced(true, t + 1);
+    const uint64_t first = b.UpdatePatternEvents(t);
+    ok &= first == FSM::NoDeadlineMs || (t < first && first < t + 10000);
+    const uint64_t later = b.UpdatePatternEvents(t + 2);
+    ok &= later == FSM::NoDeadlineMs || (t < later && later < t + 10000);
+    return ok;
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseInterruptThread(false); // drive passes directly
+
+    const int passes = 20000;
+    printf("clock reads (ns) per pass, %d passes\n", passes);
+    printf("%8s %20s %20s %20s\n", "buttons", "per FSM", "per button", "TickContext");
+    for (auto count : { 4, 16, 64, 128 })
+    {
+        printf("%8d", count);
+        for (auto mode : { Mode::PerFsm, Mode::PerButton, Mode::TickContext })
+        {
+            const auto r = Run(mode, count, passes);
+            printf(" %10.1f (%6.0f ns)", r.clockReadsPerPass, r.nsPerPass);
+        }
+        printf("\n");
+    }
+
+    const bool ok = CheckStaleTick();
+    printf("stale tick check: %s\n", ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// sampling interrupt wakeups per second: fixed 1 ms rate, slowing when all
+// debouncers settle, and stopping until a pin change wakes it
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+struct Result
+{
+    double idlePerSecond;
+    double activePerSecond;
+    int clicks;
+};
+
+// passes per second over ms of real time, polling patterns meanwhile
+double Measure(int ms, vector<ButtonPtr>& buttons, int& clicks)
+{
+    const auto passes0 = ButtonSim::Passes();
+    const auto start = chrono::steady_clock::now();
+    const auto end = start + chrono::milliseconds(ms);
+    while (chrono::steady_clock::now() < end)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        const TickContext tick;
+        for (auto& b : buttons)
+        {
+            b->UpdatePatternMatches(tick);
+            clicks += b->Clicks(0);
+        }
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return (ButtonSim::Passes() - passes0) / seconds;
+}
+
+// a user clicking one button now and then
+void Presser(int gpio, int count)
+{
+    for (auto i = 0; i < count; ++i)
+    {
+        this_thread::sleep_for(chrono::milliseconds(300));
+        ButtonSim::SetPin(gpio, true);
+        this_thread::sleep_for(chrono::milliseconds(100));
+        ButtonSim::SetPin(gpio, false);
+    }
+}
+
+Result Run(ButtonSim::Sampling mode)
+{
+    ButtonSim::UseSampling(mode);
+    vector<ButtonPtr> buttons;
+    for (auto i = 0; i < 4; ++i)
+        buttons.push_back(make_shared<Button>(i, true));
+
+    Result r{};
+    this_thread::sleep_for(chrono::milliseconds(200)); // settle
+    r.idlePerSecond = Measure(2000, buttons, r.clicks);
+
+    const int presses = 5;
+    thread presser(Presser, 2, presses);
+    r.activePerSecond = Measure(presses * 400 + 500, buttons, r.clicks);
+    presser.join();
+    return r;
+}
+
+}
+
+int main()
+{
+    const char* names[] = { "fixed", "slow when idle", "edge wakeup" };
+    const ButtonSim::Sampling modes[] = {
+        ButtonSim::Sampling::Fixed, ButtonSim::Sampling::Slow, ButtonSim::Sampling::EdgeWakeup };
+
+    printf("sampling interrupt passes per second, %d ms interrupt, idle after %d ms, idle period %d ms\n",
+        ButtonTimings::debouncerInterruptMs, ButtonTimings::idleAfterMs, ButtonTimings::idleSampleMs);
+    printf("%16s %12s %12s %8s\n", "mode", "idle", "clicking", "clicks");
+    for (auto i = 0; i < 3; ++i)
+    {
+        const auto r = Run(modes[i]);
+        printf("%16s %12.1f %12.1f %8d\n", names[i], r.idlePerSecond, r.activePerSecond, r.clicks);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// multi button patterns: every button x every pattern x every arrow,
+// against the arrow dispatch index in ButtonMultiPattern
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+// the old ButtonMultiPattern::UpdatePatternMatches
+void UpdateScan(HasPatterns& h, const TickContext& tick)
+{
+    for (const auto& b : Button::buttonPtrs.Read())
+    {
+        uint64_t timeStateChangedMs;
+        const bool isDown = b->IsDown(tick, &timeStateChangedMs);
+        const uint64_t stateTime = tick.AgeMs(timeStateChangedMs);
+        for (auto& p : h.patterns)
+            p.Update(b->buttonId, isDown, stateTime, tick.nowMs);
+    }
+}
+
+void Run(int buttonCount, int comboCount, int passes)
+{
+    for (auto p = 0; p < ButtonSim::Ports; ++p)
+        ButtonSim::SetPort(p, 0);
+    vector<ButtonPtr> buttons;
+    for (auto i = 0; i < buttonCount; ++i)
+        buttons.push_back(make_shared<Button>(i, true));
+
+    // a combo library over random button pairs, fast enough to fire
+    mt19937 rand(99);
+    ButtonMultiPattern indexed;
+    indexed.defs.reserve(comboCount); // patterns point into defs
+    for (auto i = 0; i < comboCount; ++i)
+    {
+        const int a = buttons[rand() % buttonCount]->buttonId;
+        int b = a;
+        while (b == a) b = buttons[rand() % buttonCount]->buttonId;
+        indexed.AddABABPattern(20, 400, a, b);
+    }
+    HasPatterns scan;
+    for (auto& d : indexed.defs)
+    {
+        indexed.patterns.emplace_back(&d);
+        scan.patterns.emplace_back(&d);
+    }
+
+    chrono::steady_clock::duration scanTime{ 0 }, indexTime{ 0 };
+    int matches = 0, mismatches = 0;
+    for (auto t = 1; t <= passes; ++t)
+    {
+        if ((rand() % 16) == 0)
+            ButtonSim::SetPin(rand() % buttonCount, (rand() & 1) != 0);
+        ButtonSim::Tick(t);
+        if (t % 10) continue; // patterns every 10 ms
+
+        const TickContext tick(t);
+        auto start = chrono::steady_clock::now();
+        UpdateScan(scan, tick);
+        scanTime += chrono::steady_clock::now() - start;
+
+        start = chrono::steady_clock::now();
+        indexed.UpdatePatternMatches(tick);
+        indexTime += chrono::steady_clock::now() - start;
+
+        for (auto i = 0; i < comboCount; ++i)
+        {
+            const int s = scan.Clicks(i), x = indexed.Clicks(i);
+            matches += x;
+            if (s != x || scan.patterns[i].StateIndex() != indexed.patterns[i].StateIndex())
+                ++mismatches;
+        }
+    }
+    const int updates = passes / 10;
+    printf("%8d %8d %12.0f %12.0f %8.1fx %8d %10d\n",
+        buttonCount, comboCount,
+        chrono::duration<double, nano>(scanTime).count() / updates,
+        chrono::duration<double, nano>(indexTime).count() / updates,
+        static_cast<double>(scanTime.count()) / indexTime.count(),
+        matches, mismatches);
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseInterruptThread(false); // drive passes directly
+    printf("ns per pattern update, ABAB combos over random button pairs\n");
+    printf("%8s %8s %12s %12s %9s %8s %10s\n", "buttons", "combos", "scan", "indexed", "speedup", "matches", "mismatches");
+    for (auto buttons : { 8, 32, 128 })
+        for (auto combos : { 8, 64, 256 })
+            Run(buttons, combos, 60000);
+    return 0;
+}
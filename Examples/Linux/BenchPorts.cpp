@@ -0,0 +1,76 @@
+// compare per pin sampling against batched port sampling
+// on the simulated Linux GPIO in ButtonSim.cpp
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+
+namespace {
+
+struct Result
+{
+    double nsPerPass;
+    double readsPerPass;
+    vector<bool> finalDown;
+};
+
+// run passes over the same pseudo random pin activity
+Result Run(bool batched, int buttonCount, int passes)
+{
+    ButtonSim::UseBatchedReads(batched);
+    for (auto p = 0; p < ButtonSim::Ports; ++p)
+        ButtonSim::SetPort(p, 0);
+
+    vector<ButtonPtr> buttons;
+    for (auto i = 0; i < buttonCount; ++i)
+        buttons.push_back(make_shared<Button>(i, true));
+    // two more on pins in use, one of each polarity, share the lane
+    buttons.push_back(make_shared<Button>(0, true));
+    buttons.push_back(make_shared<Button>(1, false));
+
+    mt19937 rand(1234);
+    const auto reads0 = ButtonSim::RegisterReads();
+    const auto start = chrono::steady_clock::now();
+    for (auto t = 1; t <= passes; ++t)
+    {
+        // a few pins change each ms, some of them bounce
+        if ((rand() & 7) == 0)
+            ButtonSim::SetPin(rand() % buttonCount, (rand() & 1) != 0);
+        ButtonSim::Tick(t);
+    }
+    const auto end = chrono::steady_clock::now();
+
+    Result r;
+    r.nsPerPass = chrono::duration<double, nano>(end - start).count() / passes;
+    r.readsPerPass = static_cast<double>(ButtonSim::RegisterReads() - reads0) / passes;
+    for (auto& b : buttons)
+        r.finalDown.push_back(b->IsDown());
+    return r;
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseInterruptThread(false); // drive passes directly
+
+    const int passes = 200000;
+    printf("%8s %14s %14s %12s %12s %8s\n", "buttons", "per pin ns", "batched ns", "pin reads", "port reads", "same");
+    for (int count : {8, 32, 64, 128, 256})
+    {
+        const auto perPin = Run(false, count, passes);
+        const auto batched = Run(true, count, passes);
+        printf("%8d %14.1f %14.1f %12.1f %12.1f %8s\n",
+            count, perPin.nsPerPass, batched.nsPerPass,
+            perPin.readsPerPass, batched.readsPerPass,
+            perPin.finalDown == batched.finalDown ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+// the four default patterns as four ButtonFSMs against one merged ProductFSM
+// checks both count the same clicks on a random human like trace, then
+// times the update cost per button
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonFSMTable.h"
+#include "ProductFSM.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// final states land here so the timed loops are not optimized away
+volatile uint64_t sinkOut;
+
+struct Sample
+{
+    bool down;
+    uint32_t timeInStateMs;
+};
+
+// one sample per ms, presses and gaps of human lengths
+vector<Sample> MakeTrace(int ms, uint32_t seed)
+{
+    mt19937 rand(seed);
+    uniform_int_distribution<int> click(50, 250), hold(600, 3500), gap(60, 400), idle(500, 4000);
+    vector<Sample> trace;
+    trace.reserve(ms);
+    bool down = false;
+    uint32_t changedMs = 0;
+    int nextChangeMs = idle(rand);
+    for (auto t = 0; t < ms; ++t)
+    {
+        if (t == nextChangeMs)
+        {
+            down = !down;
+            changedMs = t;
+            if (down)
+                nextChangeMs += (rand() % 5) == 0 ? hold(rand) : click(rand);
+            else
+                nextChangeMs += (rand() % 3) == 0 ? idle(rand) : gap(rand);
+        }
+        trace.push_back(Sample{ down, t - changedMs });
+    }
+    return trace;
+}
+
+}
+
+int main()
+{
+    const auto& defs = Button::DefaultPatterns();
+    vector<const FSMDef*> defPtrs;
+    for (auto& d : defs)
+        defPtrs.push_back(&d);
+
+    ProductTableStorage storage;
+    if (!CompileProduct(defPtrs, storage))
+        return 1;
+    const ProductTable table = storage.Table();
+
+    size_t separateBytes = 0;
+    for (auto& d : defs)
+    {
+        FSMTableStorage t;
+        if (!CompileFSM(d, t))
+            return 1;
+        separateBytes += t.Bytes();
+    }
+    printf("%d patterns merged: %d product states, %d cells, %d leaves, %d bytes (separate tables %d bytes)\n",
+        table.patternCount, table.stateCount,
+        static_cast<int>(storage.cells.size()), static_cast<int>(storage.leaves.size()),
+        static_cast<int>(storage.Bytes()), static_cast<int>(separateBytes));
+
+    // same inputs to both, compare states and counters every step
+    const auto trace = MakeTrace(600000, 7);
+    {
+        vector<ButtonFSM> separate;
+        for (auto& d : defs)
+            separate.emplace_back(&d);
+        ProductFSM merged(&table);
+        int mismatches = 0, clicks = 0;
+        for (auto t = 0U; t < trace.size(); ++t)
+        {
+            const auto& s = trace[t];
+            for (auto& f : separate)
+                f.Update(1, s.down, s.timeInStateMs, t);
+            merged.Update(1, s.down, s.timeInStateMs, t);
+            for (auto p = 0U; p < separate.size(); ++p)
+            {
+                if (separate[p].StateIndex() != merged.PatternState(p))
+                    ++mismatches;
+                for (auto j = 0; j < defs[p].counters_; ++j)
+                {
+                    const int a = separate[p].Read0(j), b = merged.Read0(p, j);
+                    if (a != b) ++mismatches;
+                    clicks += a;
+                }
+            }
+        }
+        printf("%d ms traced, %d counts, %d mismatches\n", static_cast<int>(trace.size()), clicks, mismatches);
+        if (mismatches != 0)
+            return 1;
+    }
+
+    // update cost, many buttons on shifted copies of the trace
+    const int buttons = 64, rounds = 4;
+    vector<vector<ButtonFSM>> separate(buttons);
+    vector<ProductFSM> merged;
+    for (auto b = 0; b < buttons; ++b)
+    {
+        for (auto& d : defs)
+            separate[b].emplace_back(&d);
+        merged.emplace_back(&table);
+    }
+    const auto steps = static_cast<uint64_t>(trace.size());
+    uint64_t sink = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (auto r = 0; r < rounds; ++r)
+        for (auto t = 0U; t < trace.size(); ++t)
+            for (auto b = 0; b < buttons; ++b)
+            {
+                const auto& s = trace[(t + b * 997) % trace.size()];
+                for (auto& f : separate[b])
+                    f.Update(b + 1, s.down, s.timeInStateMs, r * steps + t);
+            }
+    const double separateNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    for (auto& fs : separate)
+        for (auto& f : fs)
+            sink += f.StateIndex();
+
+    start = chrono::steady_clock::now();
+    for (auto r = 0; r < rounds; ++r)
+        for (auto t = 0U; t < trace.size(); ++t)
+            for (auto b = 0; b < buttons; ++b)
+            {
+                const auto& s = trace[(t + b * 997) % trace.size()];
+                merged[b].Update(b + 1, s.down, s.timeInStateMs, r * steps + t);
+            }
+    const double mergedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    for (auto& m : merged)
+        sink += m.StateIndex();
+
+    sinkOut = sink;
+
+    const double updates = static_cast<double>(rounds) * steps * buttons;
+    printf("per button update: separate %.1f ns, merged %.1f ns, %.2fx\n",
+        separateNs / updates, mergedNs / updates, separateNs / mergedNs);
+    return 0;
+}
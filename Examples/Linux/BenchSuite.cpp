@@ -0,0 +1,287 @@
+// benchmark suite for the button system, inputs from the human click
+// model (ClickModel.h), simulated parts on the virtual clock
+//  1 - ns per Debouncer::DebounceInput
+//  2 - ns per ButtonFSM::Update for each default pattern
+//  3 - ns per ButtonMultiPattern::UpdatePatternMatches, buttons x patterns
+//  4 - ns per interrupt pass over N buttons, batched and per pin
+//  5 - latency from a raw edge to Clicks() returning non zero, percentiles
+// run with make bench
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "ClickModel.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+double Ns(Clock::duration d)
+{
+    return chrono::duration<double, nano>(d).count();
+}
+
+const char* patternNames[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+
+// raw pin level every ms from edges, from 0 to endMs
+vector<uint8_t> Levels(const vector<ButtonSim::Edge>& edges, uint64_t endMs)
+{
+    vector<uint8_t> levels(endMs, 0);
+    bool down = false;
+    auto e = edges.begin();
+    for (uint64_t t = 0; t < endMs; ++t)
+    {
+        while (e != edges.end() && e->atMs <= t)
+            down = (e++)->down;
+        levels[t] = down;
+    }
+    return levels;
+}
+
+// value at fraction p of sorted v
+double Percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    return sorted[static_cast<size_t>(p * (sorted.size() - 1) + 0.5)];
+}
+
+// schedule click model presses for gpio 0 to buttons - 1 on the virtual clock
+vector<vector<ButtonSim::Edge>> Schedule(int buttons, uint64_t startMs, uint64_t runMs, uint32_t seed)
+{
+    vector<vector<ButtonSim::Edge>> all;
+    for (auto gpio = 0; gpio < buttons; ++gpio)
+    {
+        ButtonSim::ClickModel model(seed + gpio);
+        all.push_back(model.Edges(startMs, startMs + runMs));
+        for (auto& e : all.back())
+            ButtonSim::SetPinAt(e.atMs, gpio, e.down);
+    }
+    return all;
+}
+
+// 1 and 2: one button, 4 hours of 1 ms samples
+void DebounceAndPatterns()
+{
+    const uint64_t runMs = 4 * 3600 * 1000;
+    ButtonSim::ClickModel model(1);
+    const auto levels = Levels(model.Edges(0, runMs), runMs);
+
+    Debouncer debouncer;
+    int changes = 0;
+    const auto start = Clock::now();
+    for (uint64_t t = 0; t < runMs; ++t)
+        changes += debouncer.DebounceInput(levels[t] != 0, t) ? 1 : 0;
+    const double debounceNs = Ns(Clock::now() - start) / runMs;
+    printf("1 - Debouncer::DebounceInput: %.2f ns per call, %d debounced changes in %llu samples\n\n",
+        debounceNs, changes, static_cast<unsigned long long>(runMs));
+
+    // debounced state at each 10 ms pattern pass
+    struct Step
+    {
+        bool down;
+        uint32_t timeInStateMs;
+        uint64_t nowMs;
+    };
+    vector<Step> steps;
+    Debouncer d;
+    bool down = false;
+    uint64_t changedMs = 0;
+    for (uint64_t t = 0; t < runMs; ++t)
+    {
+        if (d.DebounceInput(levels[t] != 0, t))
+        {
+            down = !down;
+            changedMs = t;
+        }
+        if (t % 10 == 0)
+            steps.push_back(Step{ down, static_cast<uint32_t>(t - changedMs), t });
+    }
+
+    printf("2 - ButtonFSM::Update, %zu pattern passes at 10 ms\n", steps.size());
+    printf("    %-12s %8s %8s\n", "pattern", "ns", "matches");
+    const auto& defs = Button::DefaultPatterns();
+    for (auto p = 0U; p < defs.size(); ++p)
+    {
+        ButtonFSM fsm(&defs[p]);
+        int matches = 0;
+        const auto begin = Clock::now();
+        for (auto& s : steps)
+        {
+            fsm.Update(1, s.down, s.timeInStateMs, s.nowMs);
+            matches += fsm.Read0(0) != 0 ? 1 : 0;
+        }
+        printf("    %-12s %8.2f %8d\n", patternNames[p], Ns(Clock::now() - begin) / steps.size(), matches);
+    }
+    printf("\n");
+}
+
+// 3: multi button patterns over button and pattern counts, 10 minutes each
+void MultiPattern()
+{
+    const uint64_t runMs = 10 * 60 * 1000;
+    printf("3 - ButtonMultiPattern::UpdatePatternMatches, ABAB patterns on random button pairs\n");
+    printf("    %8s %8s %10s %8s\n", "buttons", "patterns", "ns/call", "matches");
+    for (auto buttonCount : { 4, 16, 64 })
+    {
+        for (auto patternCount : { 4, 16, 64 })
+        {
+            vector<ButtonPtr> buttons;
+            for (auto gpio = 0; gpio < buttonCount; ++gpio)
+                buttons.push_back(make_shared<Button>(gpio, true));
+            ButtonMultiPattern multi;
+            multi.defs.reserve(patternCount);
+            mt19937 rand(patternCount);
+            for (auto i = 0; i < patternCount; ++i)
+            {
+                const int a = rand() % buttonCount;
+                const int b = (a + 1 + rand() % (buttonCount - 1)) % buttonCount;
+                multi.AddABABPattern(20, 1000, buttons[a]->buttonId, buttons[b]->buttonId);
+            }
+            for (auto& def : multi.defs)
+                multi.patterns.emplace_back(&def);
+
+            const uint64_t startMs = ButtonSim::NowMs();
+            Schedule(buttonCount, startMs, runMs, 7);
+            Clock::duration spent{ 0 };
+            int calls = 0, matches = 0;
+            for (auto t = startMs + 10; t <= startMs + runMs; t += 10)
+            {
+                ButtonSim::RunUntil(t);
+                const TickContext tick(t);
+                const auto begin = Clock::now();
+                multi.UpdatePatternMatches(tick);
+                spent += Clock::now() - begin;
+                ++calls;
+                for (auto i = 0; i < patternCount; ++i)
+                    matches += multi.Clicks(i);
+            }
+            ButtonSim::RunUntil(startMs + runMs + 10000); // let go of everything
+            printf("    %8d %8d %10.1f %8d\n", buttonCount, patternCount, Ns(spent) / calls, matches);
+        }
+    }
+    printf("\n");
+}
+
+// 4: interrupt passes over N buttons, 10 minutes each
+void InterruptPass()
+{
+    const uint64_t runMs = 10 * 60 * 1000;
+    printf("4 - interrupt pass (ButtonSim::Tick) over N buttons, 1 ms passes\n");
+    printf("    %8s %12s %12s\n", "buttons", "batched ns", "per pin ns");
+    for (auto buttonCount : { 1, 8, 32, 128 })
+    {
+        double ns[2] = {};
+        for (auto batched = 0; batched < 2; ++batched)
+        {
+            ButtonSim::UseBatchedReads(batched == 0);
+            vector<ButtonPtr> buttons;
+            for (auto gpio = 0; gpio < buttonCount; ++gpio)
+                buttons.push_back(make_shared<Button>(gpio, true));
+
+            // pins set here, passes timed here, RunUntil not used
+            const uint64_t startMs = ButtonSim::NowMs();
+            vector<pair<uint64_t, pair<int, bool>>> changes;
+            for (auto gpio = 0; gpio < buttonCount; ++gpio)
+            {
+                ButtonSim::ClickModel model(100 + gpio);
+                for (auto& e : model.Edges(0, runMs))
+                    changes.push_back({ e.atMs, { gpio, e.down } });
+            }
+            sort(changes.begin(), changes.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+
+            auto next = changes.begin();
+            Clock::duration spent{ 0 };
+            for (uint64_t t = 0; t < runMs; ++t)
+            {
+                while (next != changes.end() && next->first <= t)
+                {
+                    ButtonSim::SetPin(next->second.first, next->second.second);
+                    ++next;
+                }
+                const auto begin = Clock::now();
+                ButtonSim::Tick(startMs + t);
+                spent += Clock::now() - begin;
+            }
+            for (auto gpio = 0; gpio < buttonCount; ++gpio)
+                ButtonSim::SetPin(gpio, false);
+            ns[1 - batched] = Ns(spent) / runMs;
+        }
+        printf("    %8d %12.1f %12.1f\n", buttonCount, ns[1], ns[0]);
+    }
+    ButtonSim::UseBatchedReads(true);
+    printf("\n");
+}
+
+// 5: raw edge to Clicks() non zero, 8 buttons for 4 hours per update period
+void Latency()
+{
+    const int buttonCount = 8;
+    const uint64_t runMs = 4 * 3600 * 1000;
+    printf("5 - latency, last raw edge to Clicks() non zero, first report after each edge, ms\n");
+    printf("    %-12s %6s %8s %8s %8s %8s %8s\n", "pattern", "poll", "reports", "p50", "p90", "p99", "max");
+    for (auto pollMs : { 10, 1 })
+    {
+        vector<ButtonPtr> buttons;
+        for (auto gpio = 0; gpio < buttonCount; ++gpio)
+            buttons.push_back(make_shared<Button>(gpio, true));
+        const uint64_t startMs = ButtonSim::NowMs();
+        const auto edges = Schedule(buttonCount, startMs, runMs, 500);
+
+        vector<size_t> nextEdge(buttonCount, 0);
+        vector<uint64_t> lastEdgeMs(buttonCount, 0);
+        vector<vector<uint64_t>> reportedEdge(buttonCount, vector<uint64_t>(4, ~0ULL));
+        vector<double> latency[4];
+        for (auto t = startMs + pollMs; t <= startMs + runMs; t += pollMs)
+        {
+            ButtonSim::RunUntil(t);
+            Button::UpdateAllPatternMatches(TickContext(t));
+            for (auto b = 0; b < buttonCount; ++b)
+            {
+                const auto& e = edges[b];
+                while (nextEdge[b] < e.size() && e[nextEdge[b]].atMs <= t)
+                    lastEdgeMs[b] = e[nextEdge[b]++].atMs;
+                for (auto p = 0; p < 4; ++p)
+                {
+                    if (buttons[b]->Clicks(p) == 0 || reportedEdge[b][p] == lastEdgeMs[b])
+                        continue;
+                    reportedEdge[b][p] = lastEdgeMs[b];
+                    latency[p].push_back(static_cast<double>(t - lastEdgeMs[b]));
+                }
+            }
+        }
+        for (auto p = 0; p < 4; ++p)
+        {
+            auto& l = latency[p];
+            sort(l.begin(), l.end());
+            printf("    %-12s %6d %8zu %8.0f %8.0f %8.0f %8.0f\n", patternNames[p], pollMs, l.size(),
+                Percentile(l, 0.5), Percentile(l, 0.9), Percentile(l, 0.99), l.empty() ? 0.0 : l.back());
+        }
+        ButtonSim::RunUntil(startMs + runMs + 10000);
+    }
+    printf("    ClickN waits clickUpHighMs (%d ms) after the last release, holds count from the press\n",
+        ButtonTimings::clickUpHighMs);
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseVirtualClock();
+    printf("click model: press and release lengths median 150 ms, std dev 120 ms\n\n");
+    DebounceAndPatterns();
+    MultiPattern();
+    InterruptPass();
+    Latency();
+    return 0;
+}
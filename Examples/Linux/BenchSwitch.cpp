@@ -0,0 +1,146 @@
+// generated switch FSMs (DefaultFSMSwitch.h from fsm_switch) checked
+// against the ButtonFSM interpreter on the same random button input, every
+// update compared, then timed against ButtonFSM on FSMDefs and on tables
+// cycles are TSC ticks on x86, elsewhere ns
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Button.h"
+#include "ButtonFSMTable.h"
+#include "DefaultFSMSwitch.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+uint64_t Cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// one Update call
+struct Step
+{
+    int buttonId;
+    bool down;
+    uint32_t timeInStateMs;
+    uint64_t nowMs;
+};
+
+// buttons 1 to buttons pressed at human rates, each seen every 1-10 ms
+vector<Step> MakeSteps(int buttons, int count, uint32_t seed)
+{
+    mt19937 rand(seed);
+    uniform_int_distribution<int> pass(1, 10), click(30, 250), hold(400, 3500), gap(30, 400), idle(200, 3000);
+    vector<bool> down(buttons, false);
+    vector<uint64_t> changedMs(buttons, 0), nextMs(buttons);
+    for (auto& n : nextMs)
+        n = idle(rand);
+    vector<Step> steps;
+    steps.reserve(count);
+    uint64_t now = 0;
+    while (static_cast<int>(steps.size()) < count)
+    {
+        now += pass(rand);
+        for (auto b = 0; b < buttons && static_cast<int>(steps.size()) < count; ++b)
+        {
+            while (nextMs[b] <= now)
+            {
+                down[b] = !down[b];
+                changedMs[b] = nextMs[b];
+                if (down[b])
+                    nextMs[b] += (rand() % 4) == 0 ? hold(rand) : click(rand);
+                else
+                    nextMs[b] += (rand() % 3) == 0 ? idle(rand) : gap(rand);
+            }
+            steps.push_back(Step{ b + 1, down[b], static_cast<uint32_t>(now - changedMs[b]), now });
+        }
+    }
+    return steps;
+}
+
+// differential check, returns mismatching updates
+template<typename Generated>
+int Compare(const FSMDef& def, const vector<Step>& steps)
+{
+    ButtonFSM interpreter(&def);
+    Generated generated;
+    int mismatches = 0;
+    for (auto& s : steps)
+    {
+        const bool a = interpreter.Update(s.buttonId, s.down, s.timeInStateMs, s.nowMs);
+        const bool b = generated.Update(s.buttonId, s.down, s.timeInStateMs, s.nowMs);
+        bool same = a == b && interpreter.StateIndex() == generated.StateIndex();
+        for (auto j = 0; j < def.counters_; ++j)
+            same &= interpreter.Read0(j) == generated.Read0(j);
+        mismatches += same ? 0 : 1;
+    }
+    return mismatches;
+}
+
+// cycles per update, taken arrows to sink
+template<typename Fsm>
+double Time(Fsm& fsm, const vector<Step>& steps, int& sink)
+{
+    const auto start = Cycles();
+    int taken = 0;
+    for (auto& s : steps)
+        taken += fsm.Update(s.buttonId, s.down, s.timeInStateMs, s.nowMs) ? 1 : 0;
+    const auto cycles = Cycles() - start;
+    sink += taken + fsm.Read0(0);
+    return static_cast<double>(cycles) / steps.size();
+}
+
+template<typename Generated>
+bool Run(const char* name, const FSMDef& def, int buttons, int& sink)
+{
+    const auto steps = MakeSteps(buttons, 4000000, 77);
+    const int mismatches = Compare<Generated>(def, steps);
+
+    FSMTableStorage storage;
+    if (!CompileFSM(def, storage))
+        return false;
+    const auto table = storage.Table();
+    ButtonFSM onDef(&def), onTable(&table);
+    Generated generated;
+    const double defCycles = Time(onDef, steps, sink);
+    const double tableCycles = Time(onTable, steps, sink);
+    const double switchCycles = Time(generated, steps, sink);
+    printf("%-12s %10d %10.1f %10.1f %10.1f %8.1fx\n", name, mismatches, defCycles, tableCycles, switchCycles,
+        defCycles / switchCycles);
+    return mismatches == 0;
+}
+
+}
+
+int main()
+{
+    const auto& defs = Button::DefaultPatterns();
+    ButtonMultiPattern multi;
+    multi.AddABABPattern(500, 1000); // as fsm_switch made ABABSwitch
+
+    printf("%-12s %10s %10s %10s %10s %9s\n", "pattern", "mismatches", "FSMDef", "table", "switch", "speedup");
+    int sink = 0;
+    bool ok = true;
+    ok &= Run<ClickNSwitch>("ClickN", defs[0], 1, sink);
+    ok &= Run<MediumHoldSwitch>("Medium hold", defs[1], 1, sink);
+    ok &= Run<LongHoldSwitch>("Long hold", defs[2], 1, sink);
+    ok &= Run<RepeatSwitch>("Repeat", defs[3], 1, sink);
+    ok &= Run<ABABSwitch>("ABAB", multi.defs[0], 3, sink); // button 3 is noise
+    printf("cycles per update over 4M updates each, checksum %d\n", sink);
+    if (!ok)
+        printf("ERROR - generated FSM differs from ButtonFSM\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// thousands of virtual buttons: poll every pattern vs run only on edges and
+// timing wheel deadlines (PatternEvents + PatternScheduler)
+// runs on a virtual timeline, no sampler needed
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "PatternEvents.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+uint64_t fsmUpdates = 0;
+
+// ButtonFSM that counts updates
+struct CountedFSM : ButtonFSM
+{
+    using ButtonFSM::ButtonFSM;
+    bool Update(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+    {
+        ++fsmUpdates;
+        return ButtonFSM::Update(buttonId, buttonDown, timeInStateMs, nowMs);
+    }
+};
+
+// debounced edge times for one virtual button, human like
+vector<uint64_t> MakeEdges(mt19937& rand, uint64_t endMs)
+{
+    normal_distribution<double> downMs(150, 120);
+    exponential_distribution<double> upMs(1.0 / 1500);
+    vector<uint64_t> edges;
+    uint64_t t = 0;
+    bool down = false;
+    while (true)
+    {
+        const double d = down ? max(20.0, downMs(rand)) : 20.0 + upMs(rand);
+        // now and then a hold
+        t += static_cast<uint64_t>(down && (rand() % 20) == 0 ? d + 2000 : d);
+        if (t >= endMs) break;
+        edges.push_back(t);
+        down = !down;
+    }
+    return edges;
+}
+
+struct VirtualButton
+{
+    int id{ 0 };
+    vector<CountedFSM> patterns;
+    vector<uint64_t> edges;
+    size_t nextEdge{ 0 };
+    bool down{ false };
+    uint64_t changedMs{ 0 };
+    PatternEvents events;
+};
+
+vector<VirtualButton> MakeButtons(int count, uint64_t endMs)
+{
+    mt19937 rand(42);
+    vector<VirtualButton> buttons(count);
+    for (auto i = 0; i < count; ++i)
+    {
+        buttons[i].id = i + 1;
+        for (auto& def : Button::DefaultPatterns())
+            buttons[i].patterns.emplace_back(&def);
+        buttons[i].edges = MakeEdges(rand, endMs);
+    }
+    return buttons;
+}
+
+// step button inputs to time t, returns true on an edge
+bool StepInput(VirtualButton& b, uint64_t t)
+{
+    if (b.nextEdge < b.edges.size() && b.edges[b.nextEdge] == t)
+    {
+        b.down = !b.down;
+        b.changedMs = t;
+        ++b.nextEdge;
+        return true;
+    }
+    return false;
+}
+
+long Matches(vector<VirtualButton>& buttons)
+{
+    long total = 0;
+    for (auto& b : buttons)
+        for (auto& p : b.patterns)
+            for (auto c = 0; c < 2; ++c)
+                total += p.Read0(c);
+    return total;
+}
+
+void Report(const char* name, int count, uint64_t endMs, double seconds, long matches)
+{
+    printf("%-22s %6d buttons %12.0f ns per simulated ms %12llu FSM updates %8ld matches\n",
+        name, count, seconds * 1e9 / endMs,
+        static_cast<unsigned long long>(fsmUpdates), matches);
+}
+
+long Poll(int count, uint64_t endMs, uint64_t pollMs)
+{
+    auto buttons = MakeButtons(count, endMs);
+    fsmUpdates = 0;
+    const auto start = chrono::steady_clock::now();
+    for (uint64_t t = 1; t < endMs; ++t)
+    {
+        for (auto& b : buttons)
+            StepInput(b, t);
+        if (t % pollMs != 0) continue;
+        for (auto& b : buttons)
+            for (auto& p : b.patterns)
+                p.Update(b.id, b.down, t - b.changedMs, t);
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    char name[32];
+    snprintf(name, sizeof(name), "poll every %d ms", static_cast<int>(pollMs));
+    const long matches = Matches(buttons);
+    Report(name, count, endMs, elapsed.count(), matches);
+    return matches;
+}
+
+long Events(int count, uint64_t endMs)
+{
+    auto buttons = MakeButtons(count, endMs);
+    PatternScheduler scheduler;
+    fsmUpdates = 0;
+    const auto start = chrono::steady_clock::now();
+    for (auto& b : buttons)
+        scheduler.Schedule(b.events, &b);
+    for (uint64_t t = 1; t < endMs; ++t)
+    {
+        // edges come from the sampler in a real system, here from the timeline
+        for (auto& b : buttons)
+        {
+            if (StepInput(b, t))
+            {
+                b.events.Update(b.id, b.patterns, b.down, b.changedMs, t);
+                scheduler.Schedule(b.events, &b);
+            }
+        }
+        for (auto timer : scheduler.Expire(t))
+        {
+            auto& b = *static_cast<VirtualButton*>(timer->owner);
+            b.events.Update(b.id, b.patterns, b.down, b.changedMs, t);
+            scheduler.Schedule(b.events, &b);
+        }
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    const long matches = Matches(buttons);
+    Report("edges + timing wheel", count, endMs, elapsed.count(), matches);
+    return matches;
+}
+
+}
+
+int main()
+{
+    const uint64_t endMs = 20'000; // simulated 20 seconds
+    bool same = true;
+    for (int count : {100, 1000, 5000})
+    {
+        const long polled = Poll(count, endMs, 1);
+        Poll(count, endMs, 10);
+        same &= Events(count, endMs) == polled;
+    }
+    // one arrow per pattern per ms, as 1 ms polling takes
+    printf("timing wheel matches equal 1 ms polling: %s\n", same ? "yes" : "NO");
+    return same ? 0 : 1;
+}
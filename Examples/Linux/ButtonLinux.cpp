@@ -0,0 +1,404 @@
+// button support for Linux, timerfd + epoll
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <linux/gpio.h>
+#include <linux/input.h>
+
+#include "Button.h"
+#include "ButtonLinux.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+using namespace Lomont::ButtonLinux;
+
+namespace {
+
+    constexpr int Ports = MaxGpio / 32;
+
+    // pin levels from the sources
+    atomic<uint32_t> ports[Ports];
+    atomic<uint32_t> known[Ports]; // pins some source has reported
+
+    atomic<uint64_t> passes{ 0 };
+    atomic<uint64_t> wakeups{ 0 };
+    atomic<bool> edgeArmed{ false };
+    bool adaptiveSampling{ true };
+
+    // backend descriptors, made on first use, live for the process
+    int epollFd{ -1 };
+    int timerFd{ -1 };
+    int stopFd{ -1 };
+    once_flag descriptorsMade;
+
+    // sources, owned here, touched by the backend thread
+    mutex sourceLock;
+    vector<unique_ptr<InputSource>> sources;
+
+    shared_ptr<thread> th{ nullptr };
+
+    void MakeDescriptors()
+    {
+        call_once(descriptorsMade, []
+            {
+                epollFd = epoll_create1(EPOLL_CLOEXEC);
+                timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+                stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                if (epollFd < 0 || timerFd < 0 || stopFd < 0)
+                {
+                    printf("ERROR - cannot create epoll, timerfd or eventfd: %s\n", strerror(errno));
+                    return;
+                }
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.ptr = &timerFd;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev);
+                ev.data.ptr = &stopFd;
+                epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev);
+            });
+    }
+
+    uint32_t ReadPinsLinux(int port, uint32_t portMask)
+    {
+        if (port < 0 || Ports <= port) return 0;
+        return ports[port].load(memory_order_relaxed) & portMask;
+    }
+
+#if BUTTON_STATS
+    // for the BUTTON_STATS pass timings
+    uint32_t NowNsLinux()
+    {
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint32_t>(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    }
+#endif
+
+    // program the timer, 0 stops it
+    void SetSamplePeriodLinux(uint32_t periodMs)
+    {
+        itimerspec spec{};
+        spec.it_interval.tv_sec = periodMs / 1000;
+        spec.it_interval.tv_nsec = static_cast<long>(periodMs % 1000) * 1000000;
+        spec.it_value = spec.it_interval; // first expiry one period out
+        timerfd_settime(timerFd, 0, &spec, nullptr);
+    }
+
+    // sources already wake the thread on every event, so arming is a flag
+    bool ArmEdgeWakeupLinux(bool arm)
+    {
+        edgeArmed = arm;
+        return true;
+    }
+
+    void DropSource(InputSource* source)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, source->Fd(), nullptr);
+        lock_guard<mutex> lock(sourceLock);
+        for (auto i = 0U; i < sources.size(); ++i)
+        {
+            if (sources[i].get() != source) continue;
+            sources[i] = std::move(sources.back());
+            sources.pop_back();
+            break;
+        }
+    }
+
+    // the interrupt stand in: timer expiries run a sampling pass,
+    // source events update pin levels
+    void ThreadLoop()
+    {
+        epoll_event events[16];
+        while (true)
+        {
+            const int n = epoll_wait(epollFd, events, 16, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR) continue;
+                printf("ERROR - epoll_wait: %s\n", strerror(errno));
+                return;
+            }
+            wakeups.fetch_add(1, memory_order_relaxed);
+            for (auto i = 0; i < n; ++i)
+            {
+                void* tag = events[i].data.ptr;
+                if (tag == &stopFd)
+                {
+                    uint64_t v;
+                    if (read(stopFd, &v, sizeof(v)) < 0) {} // drain
+                    return;
+                }
+                if (tag == &timerFd)
+                {
+                    uint64_t expirations;
+                    if (read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+                        continue; // stopped or restarted since
+                    passes.fetch_add(1, memory_order_relaxed);
+                    Button::SamplePorts(ButtonHW::NowMs());
+                    continue;
+                }
+                auto source = static_cast<InputSource*>(tag);
+                if (!source->OnReadable())
+                    DropSource(source);
+            }
+        }
+    }
+
+    /********************** sources *****************************************/
+
+    class EvdevSource final : public InputSource
+    {
+    public:
+        EvdevSource(int fd, int baseGpio) : fd_(fd), baseGpio_(baseGpio)
+        {
+            // keys already down
+            uint8_t keys[KEY_MAX / 8 + 1]{};
+            if (ioctl(fd_, EVIOCGKEY(sizeof(keys)), keys) >= 0)
+                for (auto k = 0; k <= KEY_MAX; ++k)
+                    if (baseGpio_ + k < MaxGpio)
+                        SetPin(baseGpio_ + k, (keys[k / 8] >> (k % 8)) & 1);
+        }
+        ~EvdevSource() override { close(fd_); }
+        int Fd() const override { return fd_; }
+
+        bool OnReadable() override
+        {
+            input_event ev[32];
+            const auto n = read(fd_, ev, sizeof(ev));
+            if (n < 0) return errno == EAGAIN || errno == EINTR;
+            if (n == 0) return false;
+            for (auto i = 0U; i < n / sizeof(input_event); ++i)
+                if (ev[i].type == EV_KEY)
+                    SetPin(baseGpio_ + ev[i].code, ev[i].value != 0); // 1 down, 2 autorepeat
+            return true;
+        }
+
+    private:
+        int fd_;
+        int baseGpio_;
+    };
+
+    class GpioChipSource final : public InputSource
+    {
+    public:
+        GpioChipSource(int fd, int baseGpio) : fd_(fd), baseGpio_(baseGpio) {}
+        ~GpioChipSource() override { close(fd_); }
+        int Fd() const override { return fd_; }
+
+        bool OnReadable() override
+        {
+            gpio_v2_line_event ev[16];
+            const auto n = read(fd_, ev, sizeof(ev));
+            if (n < 0) return errno == EAGAIN || errno == EINTR;
+            if (n == 0) return false;
+            for (auto i = 0U; i < n / sizeof(gpio_v2_line_event); ++i)
+                SetPin(baseGpio_ + static_cast<int>(ev[i].offset), ev[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE);
+            return true;
+        }
+
+    private:
+        int fd_;
+        int baseGpio_;
+    };
+
+    // records are 32 bits: gpio in the low 31, level in the top bit
+    class PipeSource final : public InputSource
+    {
+    public:
+        explicit PipeSource(int fd) : fd_(fd) {}
+        ~PipeSource() override { close(fd_); }
+        int Fd() const override { return fd_; }
+
+        bool OnReadable() override
+        {
+            uint8_t buffer[256];
+            const auto n = read(fd_, buffer, sizeof(buffer));
+            if (n < 0) return errno == EAGAIN || errno == EINTR;
+            if (n == 0) return false; // writer closed
+            for (auto i = 0; i < n; ++i)
+            {
+                partial_[have_++] = buffer[i];
+                if (have_ < sizeof(partial_)) continue;
+                have_ = 0;
+                uint32_t record;
+                memcpy(&record, partial_, sizeof(record));
+                SetPin(static_cast<int>(record & 0x7FFFFFFF), (record >> 31) != 0);
+            }
+            return true;
+        }
+
+    private:
+        int fd_;
+        uint8_t partial_[4]{};
+        size_t have_{ 0 };
+    };
+
+}
+
+namespace Lomont { namespace ButtonLinux {
+
+unique_ptr<InputSource> OpenEvdev(const char* path, int baseGpio)
+{
+    const int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        printf("ERROR - cannot open %s: %s\n", path, strerror(errno));
+        return nullptr;
+    }
+    return make_unique<EvdevSource>(fd, baseGpio);
+}
+
+unique_ptr<InputSource> OpenGpioChip(const char* path, const vector<int>& lineOffsets, int baseGpio)
+{
+    if (lineOffsets.empty() || GPIO_V2_LINES_MAX < lineOffsets.size())
+    {
+        printf("ERROR - need 1 to %d gpio lines\n", GPIO_V2_LINES_MAX);
+        return nullptr;
+    }
+    const int chip = open(path, O_RDONLY | O_CLOEXEC);
+    if (chip < 0)
+    {
+        printf("ERROR - cannot open %s: %s\n", path, strerror(errno));
+        return nullptr;
+    }
+
+    gpio_v2_line_request request{};
+    for (auto i = 0U; i < lineOffsets.size(); ++i)
+        request.offsets[i] = static_cast<uint32_t>(lineOffsets[i]);
+    request.num_lines = static_cast<uint32_t>(lineOffsets.size());
+    strncpy(request.consumer, "Lomont buttons", sizeof(request.consumer) - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    const int result = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    close(chip);
+    if (result < 0 || request.fd <= 0)
+    {
+        printf("ERROR - cannot request lines on %s: %s\n", path, strerror(errno));
+        return nullptr;
+    }
+    fcntl(request.fd, F_SETFL, fcntl(request.fd, F_GETFL) | O_NONBLOCK);
+
+    // levels before the first edge
+    gpio_v2_line_values values{};
+    values.mask = (lineOffsets.size() == 64) ? ~0ULL : (1ULL << lineOffsets.size()) - 1;
+    if (ioctl(request.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) >= 0)
+        for (auto i = 0U; i < lineOffsets.size(); ++i)
+            SetPin(baseGpio + lineOffsets[i], (values.bits >> i) & 1);
+
+    return make_unique<GpioChipSource>(request.fd, baseGpio);
+}
+
+unique_ptr<InputSource> OpenPipe(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return make_unique<PipeSource>(fd);
+}
+
+bool WritePin(int fd, int gpio, bool high)
+{
+    const uint32_t record = (static_cast<uint32_t>(gpio) & 0x7FFFFFFF) | (high ? 0x80000000U : 0);
+    return write(fd, &record, sizeof(record)) == sizeof(record);
+}
+
+void AddSource(unique_ptr<InputSource> source)
+{
+    if (!source) return;
+    MakeDescriptors();
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = source.get();
+    const int fd = source->Fd();
+    {
+        lock_guard<mutex> lock(sourceLock);
+        sources.push_back(std::move(source));
+    }
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        printf("ERROR - cannot watch input source: %s\n", strerror(errno));
+}
+
+void SetPin(int gpio, bool high)
+{
+    if (gpio < 0 || MaxGpio <= gpio) return;
+    const uint32_t bit = 1U << (gpio % 32);
+    known[gpio / 32].fetch_or(bit, memory_order_relaxed);
+    const uint32_t old = high
+        ? ports[gpio / 32].fetch_or(bit, memory_order_relaxed)
+        : ports[gpio / 32].fetch_and(~bit, memory_order_relaxed);
+    if (((old & bit) != 0) != high && edgeArmed)
+        Button::SamplerWake(); // timer stopped while idle, restart it
+}
+
+void UseAdaptiveSampling(bool adaptive)
+{
+    adaptiveSampling = adaptive;
+}
+
+uint64_t Passes()
+{
+    return passes.load(memory_order_relaxed);
+}
+
+uint64_t Wakeups()
+{
+    return wakeups.load(memory_order_relaxed);
+}
+
+}}
+
+void ButtonHW::StartDebouncerInterrupt()
+{
+    if (th) return; // already running
+    MakeDescriptors();
+    ButtonHW::ReadPins = ReadPinsLinux;
+#if BUTTON_STATS
+    ButtonSystem::Default().Hooks().nowNs = NowNsLinux;
+#endif
+    ButtonHW::SetSamplePeriodMs = adaptiveSampling ? SetSamplePeriodLinux : nullptr;
+    ButtonHW::ArmEdgeWakeup = adaptiveSampling ? ArmEdgeWakeupLinux : nullptr;
+    edgeArmed = false;
+    SetSamplePeriodLinux(ButtonTimings::debouncerInterruptMs);
+    th = make_shared<thread>(ThreadLoop);
+}
+
+void ButtonHW::StopDebouncerInterrupt()
+{
+    if (!th) return;
+    const uint64_t one = 1;
+    if (write(stopFd, &one, sizeof(one)) < 0) {}
+    th->join();
+    th = nullptr;
+    SetSamplePeriodLinux(0);
+}
+
+// pins no source has reported yet rest at the up level
+void ButtonHW::SetPinHardware(int gpioPinNumber, bool downIsHigh)
+{
+    if (gpioPinNumber < 0 || MaxGpio <= gpioPinNumber) return;
+    const uint32_t bit = 1U << (gpioPinNumber % 32);
+    if ((known[gpioPinNumber / 32].load() & bit) != 0) return;
+    if (downIsHigh)
+        ports[gpioPinNumber / 32].fetch_and(~bit, memory_order_relaxed);
+    else
+        ports[gpioPinNumber / 32].fetch_or(bit, memory_order_relaxed);
+}
+
+// get elapsed time from the button system
+uint64_t ButtonHW::ElapsedMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    static const uint64_t startMs = static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000 - startMs;
+}
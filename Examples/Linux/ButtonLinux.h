@@ -0,0 +1,65 @@
+#pragma once
+
+// Linux button backend on timerfd + epoll
+// ButtonLinux.cpp implements the ButtonHW functions. One thread waits in
+// epoll for the sampling timer and for input sources, so an idle process
+// sleeps in the kernel: the timer stops once all buttons settle (see
+// ButtonHW::ArmEdgeWakeup) and the next input event restarts it.
+// Link instead of ButtonSim.cpp.
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Lomont { namespace ButtonLinux {
+
+    // gpio numbers available to sources and buttons
+    constexpr int MaxGpio = 1024;
+
+    // a file descriptor that reports pin level changes
+    class InputSource
+    {
+    public:
+        virtual ~InputSource() = default;
+
+        // descriptor to wait on, readable when input is ready
+        virtual int Fd() const = 0;
+
+        // called on the backend thread when Fd is readable,
+        // apply changes with SetPin. Return false to drop the source.
+        virtual bool OnReadable() = 0;
+    };
+
+    // evdev device such as /dev/input/event3, key code k is gpio baseGpio + k
+    // key down reads high, so make buttons with downIsHigh = true
+    // nullptr on error
+    std::unique_ptr<InputSource> OpenEvdev(const char* path, int baseGpio = 0);
+
+    // GPIO character device lines such as /dev/gpiochip0, watched for
+    // both edges, line offset o is gpio baseGpio + o
+    // nullptr on error
+    std::unique_ptr<InputSource> OpenGpioChip(const char* path, const std::vector<int>& lineOffsets, int baseGpio = 0);
+
+    // a pipe or socketpair end carrying WritePin records, for tests
+    // and for feeding pins from another process. Takes ownership of fd.
+    std::unique_ptr<InputSource> OpenPipe(int fd);
+
+    // write a pin change record for OpenPipe to fd, false on error
+    bool WritePin(int fd, int gpio, bool high);
+
+    // start watching a source, safe from any thread
+    void AddSource(std::unique_ptr<InputSource> source);
+
+    // set a pin level, as sources do, safe from any thread
+    void SetPin(int gpio, bool high);
+
+    // true (default) - the timer stops while every button is settled and an
+    // input event restarts it, false - sample at debouncerInterruptMs forever
+    // set before making buttons
+    void UseAdaptiveSampling(bool adaptive);
+
+    // sampling passes and backend thread wakeups so far
+    uint64_t Passes();
+    uint64_t Wakeups();
+
+}}
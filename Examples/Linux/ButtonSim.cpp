@@ -0,0 +1,313 @@
+// button support for a simulated Linux GPIO
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <memory>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+    // simulated port registers
+    atomic<uint32_t> ports[ButtonSim::Ports];
+
+    atomic<uint64_t> registerReads{ 0 };
+    atomic<uint64_t> clockReads{ 0 };
+    atomic<uint64_t> passes{ 0 };
+    bool batchedReads{ true };
+    bool interruptThread{ true };
+    ButtonSim::Sampling sampling{ ButtonSim::Sampling::Fixed };
+
+    uint32_t ReadPinsSim(int port, uint32_t portMask)
+    {
+        if (port < 0 || ButtonSim::Ports <= port) return 0;
+        registerReads.fetch_add(1, memory_order_relaxed);
+        return ports[port].load(memory_order_relaxed) & portMask;
+    }
+
+#if BUTTON_STATS
+    // wall clock for the BUTTON_STATS pass timings
+    uint32_t NowNsSim()
+    {
+        return static_cast<uint32_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+#endif
+
+    // virtual clock, see ButtonSim::UseVirtualClock
+    constexpr uint64_t Never = ~0ULL;
+    bool virtualClock{ false };
+    atomic<uint64_t> virtualNowMs{ 0 };
+    uint64_t virtualPassMs{ Never };  // next interrupt pass
+    bool virtualPassMoved{ false };   // set when a pass changes the period
+    multimap<uint64_t, pair<int, bool>> pinSchedule; // time to gpio, level
+
+    uint64_t VirtualClockMs()
+    {
+        clockReads.fetch_add(1, memory_order_relaxed);
+        return virtualNowMs.load(memory_order_relaxed);
+    }
+
+    shared_ptr<thread> th{ nullptr };
+
+    // timer state, guarded by timerLock
+    mutex timerLock;
+    condition_variable timerSignal;
+    bool stopThread{ false };
+    uint32_t periodMs{ 1 };   // 0 = timer stopped
+    bool periodChanged{ false };
+    atomic<bool> edgeArmed{ false };
+
+    void SetSamplePeriodSim(uint32_t ms)
+    {
+        if (virtualClock)
+        { // restart the timer at the new period, from stopped it fires now
+            const uint64_t now = virtualNowMs.load(memory_order_relaxed);
+            virtualPassMs = ms == 0 ? Never : now + (periodMs == 0 ? 0 : ms);
+            periodMs = ms;
+            virtualPassMoved = true;
+            return;
+        }
+        {
+            lock_guard<mutex> lock(timerLock);
+            periodMs = ms;
+            periodChanged = true;
+        }
+        timerSignal.notify_one();
+    }
+
+    bool ArmEdgeWakeupSim(bool arm)
+    {
+        edgeArmed = arm;
+        return true;
+    }
+
+    // a simulated pin changed, as a pin change interrupt would see it
+    void PinChanged()
+    {
+        if (edgeArmed)
+            Button::SamplerWake();
+    }
+
+    // timer interrupt stand in, sleeps between passes
+    // the period may change from inside a pass or from SamplerWake
+    void ThreadLoop()
+    {
+        auto next = chrono::steady_clock::now();
+        unique_lock<mutex> lock(timerLock);
+        while (!stopThread)
+        {
+            if (periodMs == 0)
+            { // stopped, wait for a wakeup
+                timerSignal.wait(lock, [] { return stopThread || periodMs != 0; });
+                next = chrono::steady_clock::now();
+                continue;
+            }
+            lock.unlock();
+            ButtonSim::Tick(ButtonHW::NowMs());
+            lock.lock();
+            if (periodChanged)
+            { // restart the timer at the new period, as a hardware timer would
+                periodChanged = false;
+                next = chrono::steady_clock::now();
+            }
+            next += chrono::milliseconds(periodMs);
+            timerSignal.wait_until(lock, next, [] { return stopThread || periodChanged; });
+        }
+    }
+
+}
+
+namespace Lomont { namespace ButtonSim {
+
+void SetPin(int gpio, bool high)
+{
+    if (gpio < 0 || Ports * 32 <= gpio) return;
+    const uint32_t bit = 1U << (gpio % 32);
+    const uint32_t old = high
+        ? ports[gpio / 32].fetch_or(bit, memory_order_relaxed)
+        : ports[gpio / 32].fetch_and(~bit, memory_order_relaxed);
+    if (((old & bit) != 0) != high)
+        PinChanged();
+}
+
+void SetPort(int port, uint32_t levels)
+{
+    if (port < 0 || Ports <= port) return;
+    if (ports[port].exchange(levels, memory_order_relaxed) != levels)
+        PinChanged();
+}
+
+bool ReadPin(int gpio)
+{
+    if (gpio < 0 || Ports * 32 <= gpio) return false;
+    registerReads.fetch_add(1, memory_order_relaxed);
+    return (ports[gpio / 32].load(memory_order_relaxed) >> (gpio % 32)) & 1;
+}
+
+void UseBatchedReads(bool batched)
+{
+    batchedReads = batched;
+}
+
+void UseInterruptThread(bool useThread)
+{
+    interruptThread = useThread;
+}
+
+void UseSampling(Sampling mode)
+{
+    sampling = mode;
+}
+
+void Tick(uint64_t elapsedMs)
+{
+    passes.fetch_add(1, memory_order_relaxed);
+    if (batchedReads)
+    {
+        Button::SamplePorts(elapsedMs);
+        return;
+    }
+    // per pin path, as the ESP32 and Win32 examples used to do
+    bool changed = false;
+    bool settled = true;
+    for (const auto& b : Button::buttonPtrs.Read())
+    {
+        auto isDown = ReadPin(b->GpioNum());
+        if (!b->DownIsHigh())
+            isDown = !isDown;
+        changed |= b->DebounceInput(isDown, elapsedMs);
+        settled &= b->Settled();
+    }
+    if (changed && Button::edgeWake)
+        Button::edgeWake();
+    Button::EndSamplePass(settled, elapsedMs);
+}
+
+void UseVirtualClock()
+{
+    virtualClock = true;
+    ButtonHW::ClockMs = VirtualClockMs;
+}
+
+uint64_t NowMs()
+{
+    return virtualClock ? virtualNowMs.load(memory_order_relaxed) : ButtonHW::ElapsedMs();
+}
+
+void SetPinAt(uint64_t atMs, int gpio, bool high)
+{
+    pinSchedule.emplace(atMs, make_pair(gpio, high));
+}
+
+void RunUntil(uint64_t endMs)
+{
+    if (!virtualClock)
+    {
+        printf("ERROR - RunUntil needs UseVirtualClock\n");
+        return;
+    }
+    while (true)
+    {
+        const uint64_t pinAt = pinSchedule.empty() ? Never : pinSchedule.begin()->first;
+        const uint64_t t = min(pinAt, virtualPassMs);
+        if (t == Never || endMs < t) break;
+        if (virtualNowMs < t) virtualNowMs = t; // changes set in the past apply now
+        if (pinAt == t)
+        { // pins first, a wakeup they cause passes at this time
+            const auto change = pinSchedule.begin()->second;
+            pinSchedule.erase(pinSchedule.begin());
+            SetPin(change.first, change.second);
+            continue;
+        }
+        const uint64_t now = virtualNowMs;
+        virtualPassMoved = false;
+        Tick(now);
+        if (!virtualPassMoved)
+            virtualPassMs = periodMs == 0 ? Never : now + periodMs;
+    }
+    if (virtualNowMs < endMs) virtualNowMs = endMs;
+}
+
+uint64_t Passes()
+{
+    return passes.load(memory_order_relaxed);
+}
+
+uint64_t RegisterReads()
+{
+    return registerReads.load(memory_order_relaxed);
+}
+
+uint64_t ClockReads()
+{
+    return clockReads.load(memory_order_relaxed);
+}
+
+}}
+
+void ButtonHW::StartDebouncerInterrupt()
+{
+    ButtonHW::ReadPins = ReadPinsSim;
+#if BUTTON_STATS
+    ButtonSystem::Default().Hooks().nowNs = NowNsSim;
+#endif
+    if (th || (!interruptThread && !virtualClock)) return; // already running or manual ticks
+
+    const bool adaptive = sampling != ButtonSim::Sampling::Fixed;
+    ButtonHW::SetSamplePeriodMs = adaptive ? SetSamplePeriodSim : nullptr;
+    ButtonHW::ArmEdgeWakeup = sampling == ButtonSim::Sampling::EdgeWakeup ? ArmEdgeWakeupSim : nullptr;
+    edgeArmed = false;
+
+    if (virtualClock)
+    { // passes run from RunUntil
+        periodMs = ButtonTimings::debouncerInterruptMs;
+        virtualPassMs = virtualNowMs;
+        return;
+    }
+
+    stopThread = false;
+    periodMs = ButtonTimings::debouncerInterruptMs;
+    periodChanged = false;
+    th = make_shared<thread>(ThreadLoop);
+}
+
+void ButtonHW::StopDebouncerInterrupt()
+{
+    if (virtualClock)
+        virtualPassMs = Never;
+    if (!th) return;
+    {
+        lock_guard<mutex> lock(timerLock);
+        stopThread = true;
+    }
+    timerSignal.notify_one();
+    th->join();
+    th = nullptr;
+}
+
+// set pin
+void ButtonHW::SetPinHardware(int gpioPinNumber, bool downIsHigh)
+{
+    // simulated pins rest at the up level
+    ButtonSim::SetPin(gpioPinNumber, !downIsHigh);
+}
+
+// get elapsed time from the button system
+uint64_t ButtonHW::ElapsedMs()
+{
+    static const auto start = chrono::steady_clock::now();
+    clockReads.fetch_add(1, memory_order_relaxed);
+    return static_cast<uint64_t>(
+        chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// simulated GPIO ports for Linux
+// ButtonSim.cpp implements the ButtonHW functions on top of these, so the
+// button system can be run, tested and benchmarked without hardware
+
+#include <cstdint>
+
+namespace Lomont { namespace ButtonSim {
+
+    // number of simulated ports, 32 pins each, gpio = 32 * port + pin
+    constexpr int Ports = 8;
+
+    // set simulated pin levels, safe from any thread
+    void SetPin(int gpio, bool high);
+    void SetPort(int port, uint32_t levels);
+
+    // read one pin, like gpio_get_level
+    bool ReadPin(int gpio);
+
+    // choose interrupt sampling path
+    // true (default) - one ButtonHW::ReadPins per port feeding DebouncerBank
+    // false - one ReadPin and Debouncer::DebounceInput per button
+    void UseBatchedReads(bool batched);
+
+    // true (default) - StartDebouncerInterrupt runs a thread calling Tick every debouncerInterruptMs
+    // false - no thread, caller runs passes with Tick
+    // set before making buttons
+    void UseInterruptThread(bool useThread);
+
+    // interrupt thread sampling rate
+    // Fixed (default) - every debouncerInterruptMs
+    // Slow - drops to ButtonTimings::idleSampleMs while all inputs are settled
+    // EdgeWakeup - stops while settled, a pin change restarts it
+    // set before making buttons
+    enum class Sampling { Fixed, Slow, EdgeWakeup };
+    void UseSampling(Sampling mode);
+
+    // run one interrupt pass
+    void Tick(uint64_t elapsedMs);
+
+    // virtual time: ButtonHW::ClockMs reads a simulated clock that only
+    // RunUntil moves, interrupt passes run on it at the sampling period
+    // (Slow and EdgeWakeup periods included), no thread. Runs are
+    // deterministic and as fast as the CPU allows. Call before making
+    // buttons, the clock starts at 0 and keeps running across buttons.
+    void UseVirtualClock();
+
+    // virtual time now
+    uint64_t NowMs();
+
+    // set a pin at atMs on the virtual clock, changes at one time apply
+    // in the order given, before the interrupt pass at that time
+    void SetPinAt(uint64_t atMs, int gpio, bool high);
+
+    // run pin changes and interrupt passes due up to endMs in time order,
+    // then leave the clock at endMs. Run pattern updates between calls.
+    void RunUntil(uint64_t endMs);
+
+    // interrupt passes run so far, the wakeup count of a real timer
+    uint64_t Passes();
+
+    // pin or port reads done so far, to compare sampling paths
+    uint64_t RegisterReads();
+
+    // ButtonHW::ElapsedMs calls so far, to count clock reads
+    uint64_t ClockReads();
+
+}}
@@ -0,0 +1,90 @@
+#pragma once
+
+// synthetic human button presses for benchmarks and simulations
+// press and release lengths are gaussian with the median 150 ms and
+// std dev 120 ms noted in ButtonHelp.h, cut off below at minMs. Presses come
+// in bursts of 1-3 clicks, some held, bursts apart by idle gaps, and each
+// edge may bounce for a few ms.
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace Lomont { namespace ButtonSim {
+
+    // a raw pin edge
+    struct Edge
+    {
+        uint64_t atMs;
+        bool down;
+    };
+
+    class ClickModel
+    {
+    public:
+        explicit ClickModel(uint32_t seed) : rand_(seed) {}
+
+        double medianMs{ 150 };
+        double sigmaMs{ 120 };
+        int minMs{ 20 };             // shortest press or release
+        int holdPercent{ 15 };       // presses held medium or long
+        int minHoldMs{ 700 };
+        int maxHoldMs{ 3000 };
+        int minIdleMs{ 1000 };       // gap between bursts
+        int maxIdleMs{ 10000 };
+        int bouncePercent{ 50 };     // edges that bounce
+        int maxBounces{ 3 };         // extra toggles, 1 ms apart
+
+        // raw edges from startMs until endMs, bounces included, in time
+        // order, the pin up at both ends
+        std::vector<Edge> Edges(uint64_t startMs, uint64_t endMs)
+        {
+            std::vector<Edge> edges;
+            uint64_t t = startMs + Uniform(0, maxIdleMs);
+            while (t < endMs)
+            {
+                const int clicks = Uniform(1, 3);
+                for (auto c = 0; c < clicks && t < endMs; ++c)
+                {
+                    Add(edges, t, true);
+                    t += Uniform(0, 99) < holdPercent ? Uniform(minHoldMs, maxHoldMs) : Length();
+                    Add(edges, t, false);
+                    t += Length();
+                }
+                t += Uniform(minIdleMs, maxIdleMs);
+            }
+            return edges;
+        }
+
+    private:
+        std::mt19937 rand_;
+
+        int Uniform(int lo, int hi)
+        {
+            return std::uniform_int_distribution<int>(lo, hi)(rand_);
+        }
+
+        int Length()
+        {
+            std::normal_distribution<double> gauss(medianMs, sigmaMs);
+            return std::max(minMs, static_cast<int>(gauss(rand_)));
+        }
+
+        // edge at t, maybe bouncing first, then held for the caller's length
+        void Add(std::vector<Edge>& edges, uint64_t t, bool down)
+        {
+            if (Uniform(0, 99) < bouncePercent)
+            {
+                const int bounces = Uniform(1, maxBounces);
+                for (auto b = 0; b < bounces; ++b)
+                {
+                    edges.push_back(Edge{ t++, down });
+                    edges.push_back(Edge{ t++, !down });
+                }
+            }
+            edges.push_back(Edge{ t, down });
+        }
+    };
+
+}}
@@ -0,0 +1,97 @@
+// event driven pattern matching on the simulated Linux GPIO
+// the consumer thread sleeps until a debounced edge or the next pattern
+// deadline, instead of polling every 20-30 ms
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+mutex wakeLock;
+condition_variable wakeSignal;
+bool edgeSeen{ false };
+bool done{ false };
+
+// called from the sampling interrupt
+void EdgeWake()
+{
+    {
+        lock_guard<mutex> lock(wakeLock);
+        edgeSeen = true;
+    }
+    wakeSignal.notify_one();
+}
+
+void Press(int gpio, int downMs, int upMs)
+{
+    ButtonSim::SetPin(gpio, true);
+    this_thread::sleep_for(chrono::milliseconds(downMs));
+    ButtonSim::SetPin(gpio, false);
+    this_thread::sleep_for(chrono::milliseconds(upMs));
+}
+
+// a user pressing the button
+void Presser(int gpio)
+{
+    this_thread::sleep_for(chrono::milliseconds(300));
+    Press(gpio, 100, 600);                      // single click
+    Press(gpio, 100, 100); Press(gpio, 100, 600); // double click
+    Press(gpio, 1000, 600);                     // medium hold
+    Press(gpio, 1200, 600);                     // repeat clicks while held
+    Press(gpio, 2700, 600);                     // long hold
+
+    lock_guard<mutex> lock(wakeLock);
+    done = true;
+    wakeSignal.notify_one();
+}
+
+}
+
+int main()
+{
+    const char* names[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+
+    Button::edgeWake = EdgeWake;
+    auto button = make_shared<Button>(5, true);
+    thread presser(Presser, 5);
+
+    int wakeups = 0;
+    const auto startMs = ButtonHW::ElapsedMs();
+    while (true)
+    {
+        const auto nowMs = ButtonHW::ElapsedMs();
+        const auto nextMs = Button::UpdateAllPatternEvents(nowMs);
+        ++wakeups;
+
+        for (auto i = 0U; i < button->patterns.size(); ++i)
+        {
+            const auto clicks = button->Clicks(i);
+            if (clicks > 0)
+                printf("%6llu ms: %s count %d\n", static_cast<unsigned long long>(nowMs - startMs), names[i], clicks);
+        }
+
+        unique_lock<mutex> lock(wakeLock);
+        if (done) break;
+        const auto ready = [] { return edgeSeen || done; };
+        if (nextMs == FSM::NoDeadlineMs)
+            wakeSignal.wait(lock, ready);
+        else if (nextMs > nowMs)
+            wakeSignal.wait_for(lock, chrono::milliseconds(nextMs - nowMs), ready);
+        edgeSeen = false;
+    }
+    presser.join();
+
+    const auto elapsedMs = ButtonHW::ElapsedMs() - startMs;
+    printf("%d wakeups in %llu ms, polling every 20 ms would take %llu\n",
+        wakeups, static_cast<unsigned long long>(elapsedMs), static_cast<unsigned long long>(elapsedMs / 20));
+    return 0;
+}
@@ -0,0 +1,60 @@
+// fast clicks: a consumer polling every 100 ms misses presses that land
+// between polls, the edge queue hands the patterns every debounced edge
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+const int pollMs = 100;
+
+// a quick triple click, then quiet long enough for ClickN to report
+void Clicks(int gpio)
+{
+    for (auto i = 0; i < 3; ++i)
+    {
+        ButtonSim::SetPin(gpio, true);
+        this_thread::sleep_for(chrono::milliseconds(60));
+        ButtonSim::SetPin(gpio, false);
+        this_thread::sleep_for(chrono::milliseconds(60));
+    }
+}
+
+// run the clicks, sampling patterns every pollMs, returns ClickN count
+template<typename Poll>
+int Run(int gpio, Poll poll)
+{
+    auto button = make_shared<Button>(gpio, true);
+    poll(*button); // the first UpdateAllPatternEvents starts the edge queue
+    thread presser(Clicks, gpio);
+    int clicks = 0;
+    for (auto t = 0; t < 1500; t += pollMs)
+    {
+        this_thread::sleep_for(chrono::milliseconds(pollMs));
+        poll(*button);
+        clicks += button->Clicks(0);
+    }
+    presser.join();
+    return clicks;
+}
+
+}
+
+int main()
+{
+    const int polled = Run(5, [](Button& b) { b.UpdatePatternMatches(); });
+    const int queued = Run(6, [](Button&) { Button::UpdateAllPatternEvents(ButtonHW::ElapsedMs()); });
+
+    printf("triple click, patterns run every %d ms\n", pollMs);
+    printf("  polling the debounced state : ClickN count %d\n", polled);
+    printf("  edge queue                  : ClickN count %d\n", queued);
+    return 0;
+}
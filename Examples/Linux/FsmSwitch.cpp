@@ -0,0 +1,29 @@
+// generate switch based C++ for the default button patterns and the ABAB
+// two button pattern, written to stdout, see EmitFSMSwitch
+#include <cstdio>
+
+#include "Button.h"
+#include "FSMSwitch.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+int main()
+{
+    const char* names[] = { "ClickNSwitch", "MediumHoldSwitch", "LongHoldSwitch", "RepeatSwitch" };
+
+    printf("// generated by fsm_switch from the default button patterns\n");
+    printf("#pragma once\n");
+    printf("#include \"FSMSwitch.h\"\n\n");
+
+    const auto& defs = Button::DefaultPatterns();
+    for (auto i = 0U; i < defs.size(); ++i)
+        if (!EmitFSMSwitch(defs[i], names[i], stdout))
+            return 1;
+
+    // button ids 1 and 2
+    ButtonMultiPattern multi;
+    multi.AddABABPattern(500, 1000);
+    return EmitFSMSwitch(multi.defs[0], "ABABSwitch", stdout) ? 0 : 1;
+}
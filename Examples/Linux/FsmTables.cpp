@@ -0,0 +1,53 @@
+// compile the default button patterns to flat tables
+// writes C++ source with constexpr tables to stdout, to be placed in ROM,
+// the four share one arrow array and one action pool
+// the four patterns merged into one product table follow
+// sizes go to stderr
+#include <cstdio>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonFSMTable.h"
+#include "ProductFSM.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+int main()
+{
+    const char* names[] = { "clickNTable", "mediumHoldTable", "longHoldTable", "repeatTable" };
+
+    printf("// generated by fsm_tables from the default button patterns\n");
+    printf("#pragma once\n");
+    printf("#include \"ButtonFSMTable.h\"\n");
+    printf("#include \"ProductFSM.h\"\n\n");
+
+    const auto& defs = Button::DefaultPatterns();
+    vector<const FSMDef*> defPtrs;
+    size_t total = 0;
+    for (auto i = 0U; i < defs.size(); ++i)
+    {
+        FSMTableStorage table;
+        if (!CompileFSM(defs[i], table))
+            return 1;
+        fprintf(stderr, "%-16s %4d bytes\n", names[i], static_cast<int>(table.Bytes()));
+        total += table.Bytes();
+        defPtrs.push_back(&defs[i]);
+    }
+    fprintf(stderr, "%-16s %4d bytes\n", "total", static_cast<int>(total));
+
+    // emitted with arrows and actions pooled
+    FSMTableSetStorage set;
+    if (!CompileFSMSet(defPtrs, set))
+        return 1;
+    EmitFSMTableSet(set, "defaultPatterns", vector<const char*>(begin(names), end(names)), stdout);
+    fprintf(stderr, "%-16s %4d bytes\n", "pooled", static_cast<int>(set.Bytes()));
+
+    ProductTableStorage product;
+    if (!CompileProduct(defPtrs, product))
+        return 1;
+    EmitProductTable(product, "defaultProductTable", stdout);
+    fprintf(stderr, "%-16s %4d bytes, %d states\n", "product", static_cast<int>(product.Bytes()), product.StateCount());
+    return 0;
+}
@@ -0,0 +1,121 @@
+// hot path instrumentation on the simulated Linux GPIO, built with BUTTON_STATS=1
+// the sampling thread runs at the real 1 ms period while a presser thread
+// plays click model input on 8 buttons. Every second the pattern thread
+// reads a snapshot, without stopping sampling, and prints what changed.
+// The two button test patterns run too, counted as multi transitions.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "ClickModel.h"
+
+#if !BUTTON_STATS
+#error build with -DBUTTON_STATS=1
+#endif
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+const int buttonCount = 8;
+const int seconds = 5;
+const int patternMs = 10;
+const char* patternNames[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+
+// click model presses on every button, in real time
+void Presser(Clock::time_point start)
+{
+    vector<pair<uint64_t, pair<int, bool>>> changes;
+    for (auto gpio = 0; gpio < buttonCount; ++gpio)
+    {
+        ButtonSim::ClickModel model(500 + gpio);
+        model.minIdleMs = 200; // keep the short run busy
+        model.maxIdleMs = 1000;
+        for (auto& e : model.Edges(0, seconds * 1000))
+            changes.push_back({ e.atMs, { gpio, e.down } });
+    }
+    stable_sort(changes.begin(), changes.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (auto& c : changes)
+    {
+        this_thread::sleep_until(start + chrono::milliseconds(c.first));
+        ButtonSim::SetPin(c.second.first, c.second.second);
+    }
+}
+
+void PrintHistogram(const char* name, const HistogramSnapshot& h)
+{
+    printf("  %-16s %8u %8u %8u %8u %8u\n", name, h.count, h.Percentile(0.5), h.Percentile(0.9),
+        h.Percentile(0.99), h.max);
+}
+
+void Print(int second, const StatsSnapshot& s)
+{
+    printf("second %d%17s %8s %8s %8s %8s\n", second, "count", "p50", "p90", "p99", "max");
+    PrintHistogram("pass ns", s.passNs);
+    PrintHistogram("jitter ns", s.passJitterNs);
+    PrintHistogram("fsm updates", s.fsmUpdates);
+    PrintHistogram("match latency ms", s.matchLatencyMs);
+    printf("  transitions");
+    for (auto p = 0; p < 4; ++p)
+        printf(" %s %u,", patternNames[p], s.transitions[p]);
+    printf(" multi %u, %u\n", s.multiTransitions[0], s.multiTransitions[1]);
+}
+
+}
+
+int main()
+{
+    printf("percentiles are bucket upper bounds, at most 2x the true value\n");
+    auto& system = ButtonSystem::Default();
+    vector<ButtonPtr> buttons;
+    for (auto gpio = 0; gpio < buttonCount; ++gpio)
+        buttons.push_back(make_shared<Button>(gpio));
+    ButtonMultiPattern multi(system);
+    multi.AddTestPatterns();
+
+    const auto start = Clock::now();
+    thread presser(Presser, start);
+
+    auto last = system.stats.Read();
+    auto next = start;
+    for (auto second = 1; second <= seconds; ++second)
+    {
+        for (auto tick = 0; tick < 1000 / patternMs; ++tick)
+        {
+            next += chrono::milliseconds(patternMs);
+            this_thread::sleep_until(next);
+            const TickContext now(system.NowMs());
+            Button::UpdateAllPatternMatches(now);
+            multi.UpdatePatternMatches(now);
+            for (auto& b : buttons)
+                for (auto p = 0; p < 4; ++p)
+                    b->Clicks(p);
+        }
+        // histograms count from the start, print this second only
+        const auto now = system.stats.Read();
+        auto delta = now;
+        delta.passNs = now.passNs.Since(last.passNs);
+        delta.passJitterNs = now.passJitterNs.Since(last.passJitterNs);
+        delta.fsmUpdates = now.fsmUpdates.Since(last.fsmUpdates);
+        delta.matchLatencyMs = now.matchLatencyMs.Since(last.matchLatencyMs);
+        for (auto p = 0; p < StatsSnapshot::MaxPatterns; ++p)
+        {
+            delta.transitions[p] -= last.transitions[p];
+            delta.multiTransitions[p] -= last.multiTransitions[p];
+        }
+        Print(second, delta);
+        last = now;
+    }
+    presser.join();
+    buttons.clear();
+    return 0;
+}
@@ -0,0 +1,144 @@
+// the epoll backend in ButtonLinux.cpp with real or stand in input
+//   linux_input                                pipe stand in, scripted clicks
+//   linux_input --evdev /dev/input/event3 30   key code 30 (A) as a button
+//   linux_input --gpio /dev/gpiochip0 17 27    lines 17 and 27 as buttons
+// reports CPU time and backend wakeups, idle should be near zero
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Button.h"
+#include "ButtonLinux.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+mutex wakeLock;
+condition_variable wakeSignal;
+bool edgeSeen{ false };
+
+void EdgeWake()
+{
+    {
+        lock_guard<mutex> lock(wakeLock);
+        edgeSeen = true;
+    }
+    wakeSignal.notify_one();
+}
+
+double CpuSeconds()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// scripted user on the other end of the socketpair
+void Clicker(int fd, int gpio)
+{
+    auto press = [&](int downMs, int upMs)
+    {
+        ButtonLinux::WritePin(fd, gpio, true);
+        this_thread::sleep_for(chrono::milliseconds(downMs));
+        ButtonLinux::WritePin(fd, gpio, false);
+        this_thread::sleep_for(chrono::milliseconds(upMs));
+    };
+    this_thread::sleep_for(chrono::milliseconds(500));
+    press(100, 600);                   // single click
+    press(100, 100); press(100, 600);  // double click
+    press(1000, 3000);                 // medium hold, then idle
+    close(fd);
+}
+
+// run patterns event driven until runMs passes
+void Watch(vector<ButtonPtr>& buttons, int runMs)
+{
+    const char* names[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+    const auto endMs = ButtonHW::ElapsedMs() + runMs;
+    while (true)
+    {
+        const auto nowMs = ButtonHW::ElapsedMs();
+        if (nowMs >= endMs) break;
+        const auto nextMs = min(Button::UpdateAllPatternEvents(nowMs), endMs);
+        for (auto& b : buttons)
+            for (auto i = 0U; i < b->patterns.size(); ++i)
+            {
+                const auto clicks = b->Clicks(i);
+                if (clicks > 0)
+                    printf("%6llu ms: gpio %d %s count %d\n",
+                        static_cast<unsigned long long>(nowMs), b->GpioNum(), names[i], clicks);
+            }
+
+        unique_lock<mutex> lock(wakeLock);
+        wakeSignal.wait_for(lock, chrono::milliseconds(nextMs - nowMs), [] { return edgeSeen; });
+        edgeSeen = false;
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Button::edgeWake = EdgeWake;
+    vector<ButtonPtr> buttons;
+    thread clicker;
+    int runMs = 8000;
+
+    if (argc >= 4 && strcmp(argv[1], "--evdev") == 0)
+    {
+        ButtonLinux::AddSource(ButtonLinux::OpenEvdev(argv[2]));
+        for (auto i = 3; i < argc; ++i)
+            buttons.push_back(make_shared<Button>(atoi(argv[i]), true));
+        runMs = 30000;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "--gpio") == 0)
+    {
+        vector<int> lines;
+        for (auto i = 3; i < argc; ++i)
+            lines.push_back(atoi(argv[i]));
+        ButtonLinux::AddSource(ButtonLinux::OpenGpioChip(argv[2], lines));
+        for (auto line : lines)
+            buttons.push_back(make_shared<Button>(line, false)); // pulled up, pressed shorts to ground
+        runMs = 30000;
+    }
+    else
+    {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+        {
+            printf("ERROR - socketpair failed\n");
+            return 1;
+        }
+        ButtonLinux::AddSource(ButtonLinux::OpenPipe(fds[0]));
+        buttons.push_back(make_shared<Button>(5, true));
+        clicker = thread(Clicker, fds[1], 5);
+    }
+
+    const double cpu0 = CpuSeconds();
+    const auto wakeups0 = ButtonLinux::Wakeups();
+    const auto passes0 = ButtonLinux::Passes();
+    Watch(buttons, runMs);
+    if (clicker.joinable())
+        clicker.join();
+
+    const double seconds = runMs / 1000.0;
+    printf("%.1f s: %.1f ms CPU, %.1f backend wakeups/s, %.1f sampling passes/s\n",
+        seconds, (CpuSeconds() - cpu0) * 1000,
+        (ButtonLinux::Wakeups() - wakeups0) / seconds,
+        (ButtonLinux::Passes() - passes0) / seconds);
+    return 0;
+}
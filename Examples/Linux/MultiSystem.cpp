@@ -0,0 +1,188 @@
+// several independent button systems, each on its own thread
+// every system has its own timings, registry, patterns, edge queue and
+// hooks. The hooks read thread local pins and clock, so a system sees only
+// the thread that runs it. Each system runs a click model session, first
+// one after another, then all at once, and every result must match.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Button.h"
+#include "ClickModel.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+const int gpios[] = { 0, 1, 2, 3, 32, 33, 34, 35 };
+const uint64_t runMs = 30 * 60 * 1000; // 30 minutes per system
+const int patternMs = 10;
+
+// pins and clock of the system on this thread
+thread_local uint32_t pins[2];
+thread_local uint64_t nowMs;
+
+uint32_t ReadPinsThread(int port, uint32_t portMask)
+{
+    return port < 2 ? pins[port] & portMask : 0;
+}
+
+uint64_t ClockThread()
+{
+    return nowMs;
+}
+
+void SetPin(int gpio, bool high)
+{
+    const uint32_t bit = 1U << (gpio % 32);
+    if (high)
+        pins[gpio / 32] |= bit;
+    else
+        pins[gpio / 32] &= ~bit;
+}
+
+// pin level for a button state, gpio 32 and up pull low
+bool High(int gpio, bool down)
+{
+    return gpio < 32 ? down : !down;
+}
+
+struct Result
+{
+    uint64_t reports{ 0 };
+    uint64_t counts{ 0 };
+    uint64_t hash{ 14695981039346656037ULL }; // FNV-1a over every report
+    bool clockOk{ false }; // reads without a tick used this system's clock
+    bool traceOk{ false }; // a recorder on the system took its timings
+
+    void Add(uint64_t value)
+    {
+        for (auto i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    bool operator==(const Result& r) const
+    {
+        return reports == r.reports && counts == r.counts && hash == r.hash && clockOk && r.clockOk && traceOk && r.traceOk;
+    }
+};
+
+// timings for system index, so each system reports differently
+SystemTimings Timings(int index)
+{
+    SystemTimings t;
+    t.debounceMs = static_cast<uint8_t>(4 + index % 4);
+    t.clickUpHighMs = t.clickDownHighMs = 170 + 20 * (index % 5);
+    t.mediumPressMs = 500 + 50 * (index % 3);
+    return t;
+}
+
+// one session on system, sampled and updated by this thread only
+Result Run(int index)
+{
+    pins[0] = pins[1] = 0;
+    nowMs = 0;
+
+    ButtonSystem system(Timings(index));
+    system.Hooks().readPins = ReadPinsThread;
+    system.Hooks().clockMs = ClockThread;
+    uint8_t traceBuffer[256]; // the start of the session is enough
+    TraceRecorder recorder(traceBuffer, sizeof(traceBuffer));
+    system.Hooks().trace = &recorder;
+
+    vector<unique_ptr<Button>> buttons;
+    vector<vector<ButtonSim::Edge>> edges;
+    for (auto gpio : gpios)
+    {
+        SetPin(gpio, High(gpio, false));
+        buttons.push_back(make_unique<Button>(system, gpio, gpio < 32));
+        ButtonSim::ClickModel model(index * 100 + gpio);
+        edges.push_back(model.Edges(0, runMs));
+    }
+    vector<size_t> next(edges.size(), 0);
+
+    Result result;
+    for (nowMs = 1; nowMs <= runMs; ++nowMs)
+    {
+        for (auto i = 0U; i < edges.size(); ++i)
+            for (auto& e = edges[i]; next[i] < e.size() && e[next[i]].atMs <= nowMs; ++next[i])
+                SetPin(gpios[i], High(gpios[i], e[next[i]].down));
+        system.SamplePorts(nowMs);
+        if (nowMs % patternMs != 0) continue;
+        system.UpdateAllPatternMatches(TickContext(nowMs));
+        for (auto& b : buttons)
+            for (auto p = 0; p < 4; ++p)
+                if (const int count = b->Clicks(p))
+                {
+                    ++result.reports;
+                    result.counts += count;
+                    result.Add(nowMs);
+                    result.Add((static_cast<uint64_t>(b->buttonId) << 32) | (p << 16) | count);
+                }
+    }
+
+    // an edge just published, read at the system clock a few ms later
+    nowMs = runMs + 5;
+    uint64_t changedMs = 0;
+    buttons[0]->SetDebounced(true, runMs + 2);
+    result.clockOk = buttons[0]->IsDown(&changedMs) && changedMs == runMs + 2;
+
+    system.Hooks().trace = nullptr;
+    recorder.Finish();
+    TraceReader reader(recorder.Data(), recorder.Size());
+    result.traceOk = reader.Valid() && reader.DebounceMs() == system.Timings().debounceMs &&
+        reader.DebouncerInterruptMs() == system.Timings().debouncerInterruptMs;
+    return result;
+}
+
+}
+
+int main()
+{
+    const int cores = max(1U, thread::hardware_concurrency());
+    const int systems = max(cores, 4);
+    printf("%d systems, %zu buttons each, %.0f simulated minutes each, %d cores\n", systems,
+        size(gpios), runMs / 60000.0, cores);
+
+    // one after another on this thread
+    vector<Result> serial;
+    const auto serialStart = chrono::steady_clock::now();
+    for (auto s = 0; s < systems; ++s)
+        serial.push_back(Run(s));
+    const double serialSeconds = chrono::duration<double>(chrono::steady_clock::now() - serialStart).count();
+
+    // all at once, one thread each
+    vector<Result> parallel(systems);
+    const auto parallelStart = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (auto s = 0; s < systems; ++s)
+        threads.emplace_back([&parallel, s] { parallel[s] = Run(s); });
+    for (auto& t : threads)
+        t.join();
+    const double parallelSeconds = chrono::duration<double>(chrono::steady_clock::now() - parallelStart).count();
+
+    printf("%8s %8s %10s %10s %18s %6s\n", "system", "debounce", "reports", "counts", "hash", "same");
+    bool allSame = true;
+    for (auto s = 0; s < systems; ++s)
+    {
+        const bool same = serial[s] == parallel[s];
+        allSame &= same;
+        printf("%8d %8d %10llu %10llu %18llx %6s\n", s, Timings(s).debounceMs,
+            static_cast<unsigned long long>(serial[s].reports), static_cast<unsigned long long>(serial[s].counts),
+            static_cast<unsigned long long>(serial[s].hash), same ? "yes" : "NO");
+    }
+    printf("serial %.2f s, parallel %.2f s, speedup %.2fx on %d cores\n", serialSeconds, parallelSeconds,
+        serialSeconds / parallelSeconds, min(cores, systems));
+    if (!allSame)
+        printf("ERROR - systems differ when run at once\n");
+    return allSame ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// run the FSM optimizer on the default patterns and on a hand built
+// double click pattern with leftovers from editing, checked and ordered
+// on a random human like trace
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "FSMOptimize.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// one step per ms, presses and gaps of human lengths
+FSMTrace MakeTrace(int ms, uint32_t seed)
+{
+    mt19937 rand(seed);
+    uniform_int_distribution<int> click(50, 250), hold(600, 3500), gap(60, 400), idle(500, 4000);
+    FSMTrace trace;
+    trace.reserve(ms);
+    bool down = false;
+    uint32_t changedMs = 0;
+    int nextChangeMs = idle(rand);
+    for (auto t = 0; t < ms; ++t)
+    {
+        if (t == nextChangeMs)
+        {
+            down = !down;
+            changedMs = t;
+            if (down)
+                nextChangeMs += (rand() % 5) == 0 ? hold(rand) : click(rand);
+            else
+                nextChangeMs += (rand() % 3) == 0 ? idle(rand) : gap(rand);
+        }
+        trace.push_back(FSMTraceStep{ 1, down, t - changedMs, static_cast<uint64_t>(t) });
+    }
+    return trace;
+}
+
+// double click counter as written by hand, with a shadowed arrow,
+// an unused state, and a state copied instead of reused
+FSMDef HandDoubleClick()
+{
+    FSMDef f(1);
+    f.Build({
+        // 0 - up a while
+        State({
+            Arrow(1,false,50),
+            Arrow(1,false,500)}), // never first, 50 always matches before
+
+        // 1 - first press
+        State({
+            Arrow(2,true,20)}),
+
+        // 2 - first press held, too long is not a click
+        State({
+            Arrow(0,true,700),
+            Arrow(3,0,1,0,0)}),
+
+        // 3 - between clicks
+        State({
+            Arrow(4,true,20),
+            Arrow(0,false,300)}),
+
+        // 4 - second press
+        State({
+            Arrow(0,true,700),
+            Arrow(6,0,1,0,0,{
+                IncrementCounter(0)})}),
+
+        // 5 - left over from an older version
+        State({
+            Arrow(0,false,0)}),
+
+        // 6 - same as 0
+        State({
+            Arrow(1,false,50)})
+        });
+    return f;
+}
+
+}
+
+int main()
+{
+    const auto trace = MakeTrace(2000000, 11);
+    const char* names[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+
+    vector<FSMDef> defs(Button::DefaultPatterns());
+    defs.push_back(HandDoubleClick());
+
+    for (auto i = 0U; i < defs.size(); ++i)
+    {
+        FSMDef optimized(0);
+        OptimizeReport report;
+        if (!OptimizeFSM(defs[i], optimized, report, &trace))
+            return 1;
+        PrintOptimizeReport(report, i < 4 ? names[i] : "Hand double click", stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+// patterns written as text and compiled to tables at build time: the
+// Konami code and a hold combo, played right, wrong and too slow on
+// simulated buttons
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "PatternDSL.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+// button ids 1-6 are the buttons made first, gpio 0-5
+constexpr auto konami = BUTTON_PATTERN("U=1 D=2 L=3 R=4 B=5 A=6 : U U D D L R L R B A within 800");
+
+// hold B a second, click A, let go of B
+constexpr auto holdCombo = BUTTON_PATTERN("B=5 A=6 : Bd>=1000 A Bu within 2000");
+
+static_assert(konami.StateCount == 26, "6 buttons up, then 20 steps");
+
+#ifdef SHOW_PATTERN_ERROR
+// fails the build: button 1 is pressed twice without a release
+constexpr auto broken = BUTTON_PATTERN("1d 2 1d");
+#endif
+
+ButtonMultiPattern multi;
+uint64_t nowMs = 0;
+
+// run time forward, patterns every 10 ms
+void Wait(int ms)
+{
+    for (auto i = 0; i < ms; ++i)
+    {
+        ButtonSim::Tick(++nowMs);
+        if (nowMs % 10 == 0)
+            multi.UpdatePatternMatches(TickContext(nowMs));
+    }
+}
+
+// press gpio, hold, release, then pause
+void Click(int gpio, int holdMs = 80, int gapMs = 80)
+{
+    ButtonSim::SetPin(gpio, true);
+    Wait(holdMs);
+    ButtonSim::SetPin(gpio, false);
+    Wait(gapMs);
+}
+
+// gpio of each Konami step, U U D D L R L R B A
+const int konamiGpios[] = { 0, 0, 1, 1, 2, 3, 2, 3, 4, 5 };
+
+void Konami(int wrongAt = -1, int pauseAt = -1)
+{
+    for (auto i = 0; i < 10; ++i)
+    {
+        if (i == pauseAt) Wait(1500);
+        Click(i == wrongAt ? 0 : konamiGpios[i]);
+    }
+}
+
+void HoldCombo(int holdMs)
+{
+    ButtonSim::SetPin(4, true);
+    Wait(holdMs);
+    Click(5);
+    ButtonSim::SetPin(4, false);
+    Wait(100);
+}
+
+void Report(const char* what)
+{
+    Wait(500);
+    const int k = multi.Clicks(0), h = multi.Clicks(1);
+    printf("  %-30s konami %d, hold combo %d\n", what, k, h);
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseInterruptThread(false); // drive passes directly
+    vector<ButtonPtr> buttons;
+    for (auto gpio = 0; gpio < 6; ++gpio)
+        buttons.push_back(make_shared<Button>(gpio, true));
+    multi.patterns.emplace_back(&konami.table);
+    multi.patterns.emplace_back(&holdCombo.table);
+
+    printf("konami: %d states, %d arrows, %zu bytes of table\n", konami.StateCount, konami.ArrowCount, konami.Bytes());
+    printf("hold combo: %d states, %d arrows, %zu bytes of table\n\n", holdCombo.StateCount, holdCombo.ArrowCount, holdCombo.Bytes());
+
+    Wait(200);
+    Konami();
+    Report("Konami");
+    Konami(5);
+    Report("Konami, one wrong button");
+    Konami(-1, 6);
+    Report("Konami, 1.5 s pause");
+    HoldCombo(1200);
+    Report("hold B 1.2 s, click A");
+    HoldCombo(400);
+    Report("hold B 0.4 s, click A");
+    return 0;
+}
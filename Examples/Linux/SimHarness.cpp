@@ -0,0 +1,122 @@
+// the whole button stack on a virtual clock: 8 buttons pressed at human
+// rates for hours of simulated time, debounced by the interrupt passes,
+// per button and two button patterns run every 10 ms, in a fraction of
+// the time. Runs are repeated to show they are deterministic, and with
+// edge wakeup sampling, which skips the idle passes
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+const int buttonCount = 8;
+const uint64_t runMs = 2 * 3600 * 1000; // 2 hours
+
+// a pattern count seen by the pattern loop
+struct Report
+{
+    uint64_t atMs; // from run start
+    int button;    // buttonCount for the two button pattern
+    int pattern;
+    int count;
+
+    bool operator==(const Report& r) const
+    {
+        return atMs == r.atMs && button == r.button && pattern == r.pattern && count == r.count;
+    }
+};
+
+struct Result
+{
+    vector<Report> reports;
+    uint64_t passes;
+    double wallSeconds;
+};
+
+// press schedule for every button, clicks, multi clicks and holds
+void Script(uint64_t startMs, uint32_t seed)
+{
+    mt19937 rand(seed);
+    uniform_int_distribution<int> click(40, 200), hold(700, 2500), gap(80, 300), idle(2000, 60000);
+    for (auto gpio = 0; gpio < buttonCount; ++gpio)
+    {
+        uint64_t t = startMs + idle(rand);
+        while (t < startMs + runMs)
+        {
+            const int presses = 1 + rand() % 3;
+            for (auto p = 0; p < presses; ++p)
+            {
+                ButtonSim::SetPinAt(t, gpio, true);
+                t += (rand() % 4) == 0 ? hold(rand) : click(rand);
+                ButtonSim::SetPinAt(t, gpio, false);
+                t += gap(rand);
+            }
+            t += idle(rand);
+        }
+    }
+}
+
+Result Run(ButtonSim::Sampling sampling, uint32_t seed)
+{
+    ButtonSim::UseSampling(sampling);
+    Result result{};
+    const auto wallStart = chrono::steady_clock::now();
+    const auto passes0 = ButtonSim::Passes();
+    {
+        vector<ButtonPtr> buttons;
+        for (auto gpio = 0; gpio < buttonCount; ++gpio)
+            buttons.push_back(make_shared<Button>(gpio, true));
+        ButtonMultiPattern multi;
+        multi.AddABABPattern(300, 1500, buttons[0]->buttonId, buttons[1]->buttonId);
+        multi.patterns.emplace_back(&multi.defs[0]);
+
+        const uint64_t startMs = ButtonSim::NowMs();
+        Script(startMs, seed);
+        for (auto t = startMs + 10; t <= startMs + runMs; t += 10)
+        {
+            ButtonSim::RunUntil(t);
+            const TickContext tick(t);
+            Button::UpdateAllPatternMatches(tick);
+            multi.UpdatePatternMatches(tick);
+            for (auto b = 0; b < buttonCount; ++b)
+                for (auto p = 0; p < 4; ++p)
+                    if (const int count = buttons[b]->Clicks(p))
+                        result.reports.push_back(Report{ t - startMs, b, p, count });
+            if (const int count = multi.Clicks(0))
+                result.reports.push_back(Report{ t - startMs, buttonCount, 0, count });
+        }
+    }
+    result.passes = ButtonSim::Passes() - passes0;
+    result.wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    return result;
+}
+
+void Print(const char* name, const Result& r, const Result& reference)
+{
+    printf("%-22s %8.2f %9.0fx %10llu %8zu %6s\n", name, r.wallSeconds, runMs / 1000.0 / r.wallSeconds,
+        static_cast<unsigned long long>(r.passes), r.reports.size(), r.reports == reference.reports ? "yes" : "NO");
+}
+
+}
+
+int main()
+{
+    ButtonSim::UseVirtualClock();
+    printf("%d buttons, %.0f simulated hours\n", buttonCount, runMs / 3600000.0);
+    printf("%-22s %8s %10s %10s %8s %6s\n", "run", "wall s", "real time", "passes", "reports", "same");
+
+    const auto first = Run(ButtonSim::Sampling::Fixed, 42);
+    Print("fixed sampling", first, first);
+    Print("fixed sampling again", Run(ButtonSim::Sampling::Fixed, 42), first);
+    Print("edge wakeup sampling", Run(ButtonSim::Sampling::EdgeWakeup, 42), first);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// RAM and flash bytes of the default patterns as FSMDefs and as packed
+// tables, and RAM per live Button running either
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonFSMTable.h"
+#include "StaticButtons.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// ButtonFSM as it was, a pointer each for the FSMDef and table and the
+// counters in a vector, to show what the tagged pointer and inline
+// counters save
+struct OldButtonFSM
+{
+    Lomont::ButtonHelpers::StateTraceRing* trace;
+    uint8_t traceId;
+    int stateIndex;
+    const FSMDef* fsm;
+    const FSMTable* table;
+    vector<int> counters;
+    uint64_t stateTimeChangedMs;
+};
+
+// heap and object bytes of a live button and its patterns
+size_t ButtonBytes(const Button& b)
+{
+    size_t bytes = sizeof(Button) + b.patterns.capacity() * sizeof(ButtonFSM);
+    for (auto& p : b.patterns)
+        bytes += p.HeapBytes();
+    return bytes;
+}
+
+// the same with the old ButtonFSM
+size_t OldButtonBytes(const Button& b)
+{
+    size_t bytes = sizeof(Button) + b.patterns.capacity() * sizeof(OldButtonFSM);
+    for (auto& p : b.patterns)
+    {
+        const int counters = p.Def() ? p.Def()->counters_ : p.Table()->counterCount;
+        bytes += counters * sizeof(int);
+    }
+    return bytes;
+}
+
+}
+
+int main()
+{
+    const char* names[] = { "ClickN", "Medium hold", "Long hold", "Repeat" };
+    printf("element sizes: Arrow %zu, Action %zu, State %zu -> PackedArrow %zu, PackedAction %zu\n\n",
+        sizeof(Arrow), sizeof(Action), sizeof(State), sizeof(PackedArrow), sizeof(PackedAction));
+
+    const auto& defs = Button::DefaultPatterns();
+    printf("%-12s %7s %7s %7s\n", "pattern", "FSMDef", "table", "ratio");
+    size_t defTotal = 0, tableTotal = 0;
+    vector<const FSMDef*> defPtrs;
+    for (auto i = 0U; i < defs.size(); ++i)
+    {
+        FSMTableStorage table;
+        if (!CompileFSM(defs[i], table))
+            return 1;
+        const auto defBytes = DefBytes(defs[i]);
+        printf("%-12s %7zu %7zu %6.1fx\n", names[i], defBytes, table.Bytes(), static_cast<double>(defBytes) / table.Bytes());
+        defTotal += defBytes;
+        tableTotal += table.Bytes();
+        defPtrs.push_back(&defs[i]);
+    }
+    FSMTableSetStorage pooled;
+    if (!CompileFSMSet(defPtrs, pooled))
+        return 1;
+    printf("%-12s %7zu %7zu %6.1fx\n", "total", defTotal, tableTotal, static_cast<double>(defTotal) / tableTotal);
+    printf("%-12s %7s %7zu %6.1fx   (RAM for FSMDefs, flash for tables)\n\n", "pooled", "", pooled.Bytes(),
+        static_cast<double>(defTotal) / pooled.Bytes());
+
+    // a live button with the defaults as FSMDefs, then as tables
+    auto b = make_shared<Button>(3, true);
+    const auto withDefs = ButtonBytes(*b);
+    const auto oldWithDefs = OldButtonBytes(*b);
+    b->patterns.clear();
+    for (auto& t : Button::DefaultPatternTables())
+        b->patterns.emplace_back(&t);
+    const auto withTables = ButtonBytes(*b);
+    const auto oldWithTables = OldButtonBytes(*b);
+    printf("ButtonFSM %zu bytes, up to %d counters inline, was %zu bytes plus heap counters\n",
+        sizeof(ButtonFSM), ButtonFSM::InlineCounters, sizeof(OldButtonFSM));
+    printf("per live Button: %zu bytes with FSMDefs, %zu with tables, plus registry slot and shared_ptr block\n",
+        withDefs, withTables);
+    size_t oldBlocks = 0, blocks = 0;
+    for (auto& p : b->patterns)
+    {
+        oldBlocks += p.Table()->counterCount > 0 ? 1 : 0;
+        blocks += p.HeapBytes() > 0 ? 1 : 0;
+    }
+    printf("  was %zu with FSMDefs, %zu with tables, saving %zu and %zu bytes, heap blocks %zu -> %zu\n",
+        oldWithDefs, oldWithTables, oldWithDefs - withDefs, oldWithTables - withTables, oldBlocks, blocks);
+    printf("per StaticButtonSet button (4 patterns, 2 counters): %zu bytes, no heap\n",
+        StaticButtonSet<1, 4, 2>::Ram().buttonBytes);
+    return 0;
+}
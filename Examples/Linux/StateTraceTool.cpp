@@ -0,0 +1,156 @@
+// pattern state change tracing into a binary ring, formatted off the update path
+//   state_trace        - click model session on the virtual clock with every
+//                        pattern traced, drained to build/states.trace, then
+//                        the update cost with tracing off and on
+//   state_trace FILE   - format a drained trace file, as a host tool would
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "ClickModel.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+const int buttonCount = 8;
+const int patternMs = 10;
+const int drainMs = 100; // a low priority logger empties the ring this often
+
+StateTraceRing ring;
+
+// buttons with click model input from now for runMs, traced if on
+vector<ButtonPtr> Session(uint64_t runMs, bool on)
+{
+    vector<ButtonPtr> buttons;
+    const uint64_t startMs = ButtonSim::NowMs();
+    for (auto gpio = 0; gpio < buttonCount; ++gpio)
+    {
+        ButtonSim::SetPin(gpio, false);
+        auto& b = buttons.emplace_back(make_shared<Button>(gpio));
+        for (auto p = 0U; p < b->patterns.size(); ++p)
+        {
+            b->patterns[p].trace = on ? &ring : nullptr;
+            b->patterns[p].traceId = static_cast<uint8_t>(p);
+        }
+        ButtonSim::ClickModel model(700 + gpio);
+        for (auto& e : model.Edges(startMs, startMs + runMs))
+            ButtonSim::SetPinAt(e.atMs, gpio, e.down);
+    }
+    return buttons;
+}
+
+// run a traced session, drain the ring to path
+void Record(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("ERROR - cannot write %s\n", path);
+        return;
+    }
+    const uint64_t runMs = 30 * 60 * 1000;
+    const auto buttons = Session(runMs, true);
+    const uint64_t startMs = ButtonSim::NowMs();
+    uint32_t cursor = ring.Head();
+    uint32_t lost = 0;
+    uint64_t records = 0;
+    StateTraceRecord batch[64];
+    uint8_t bytes[StateTraceRecord::Bytes];
+    for (auto t = startMs + patternMs; t <= startMs + runMs; t += patternMs)
+    {
+        ButtonSim::RunUntil(t);
+        Button::UpdateAllPatternMatches(TickContext(t));
+        if ((t - startMs) % drainMs != 0) continue;
+        while (const size_t n = ring.Read(cursor, batch, size(batch), &lost))
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                batch[i].ToBytes(bytes);
+                fwrite(bytes, sizeof(bytes), 1, file);
+            }
+            records += n;
+        }
+    }
+    fclose(file);
+    printf("traced %.0f minutes, %llu state changes, %u lost, %llu bytes to %s\n", runMs / 60000.0,
+        static_cast<unsigned long long>(records), lost, static_cast<unsigned long long>(records * sizeof(bytes)), path);
+}
+
+// print a drained trace file
+bool Format(const char* path, size_t maxLines)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("ERROR - cannot read %s\n", path);
+        return false;
+    }
+    uint8_t bytes[StateTraceRecord::Bytes];
+    char text[160];
+    size_t lines = 0;
+    while (lines < maxLines && fread(bytes, sizeof(bytes), 1, file) == 1)
+    {
+        FormatStateTrace(StateTraceRecord::FromBytes(bytes), text, sizeof(text));
+        printf("%s\n", text);
+        ++lines;
+    }
+    fclose(file);
+    return true;
+}
+
+// pattern update cost with tracing off and on, 8 buttons, 10 minutes
+void UpdateCost()
+{
+    const uint64_t runMs = 10 * 60 * 1000;
+    double ns[2] = {};
+    uint64_t records = 0;
+    for (auto pass = 0; pass < 4; ++pass) // off, on, off, on, keep the best of each
+    {
+        const bool on = (pass & 1) != 0;
+        const auto buttons = Session(runMs, on);
+        const uint64_t startMs = ButtonSim::NowMs();
+        const uint32_t head = ring.Head();
+        Clock::duration spent{ 0 };
+        uint64_t updates = 0;
+        for (auto t = startMs + patternMs; t <= startMs + runMs; t += patternMs)
+        {
+            ButtonSim::RunUntil(t);
+            const auto begin = Clock::now();
+            Button::UpdateAllPatternMatches(TickContext(t));
+            spent += Clock::now() - begin;
+            ++updates;
+        }
+        const double updateNs = chrono::duration<double, nano>(spent).count() / updates;
+        ns[on] = pass < 2 ? updateNs : min(ns[on], updateNs);
+        if (on)
+            records = ring.Head() - head;
+    }
+    printf("UpdateAllPatternMatches, %d buttons: %.1f ns without trace, %.1f ns with, %llu records\n",
+        buttonCount, ns[0], ns[1], static_cast<unsigned long long>(records));
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2)
+        return Format(argv[1], ~size_t(0)) ? 0 : 1;
+
+    ButtonSim::UseVirtualClock();
+    const char* path = "build/states.trace";
+    Record(path);
+    printf("first records:\n");
+    Format(path, 12);
+    UpdateCost();
+    return 0;
+}
@@ -0,0 +1,80 @@
+// no heap configuration: 8 buttons running the default patterns from ROM
+// tables in a StaticButtonSet, with the RAM budget checked at build time
+// counts heap allocations after boot, there should be none
+#define BUTTON_RAM_BUDGET 4096 // larger sets fail to compile
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "StaticButtons.h"
+#include "DefaultFSMTables.h" // made by fsm_tables
+
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+std::atomic<bool> booted{ false };
+std::atomic<int> heapAfterBoot{ 0 };
+
+using Buttons = StaticButtonSet<8, 4, 2>;
+Buttons buttons; // static storage
+static_assert(FitsRamBudget<4096, Buttons>(), "buttons over RAM budget");
+
+bool pins[64];
+bool PinHigh(int gpio) { return pins[gpio]; }
+
+}
+
+void* operator new(size_t size)
+{
+    if (booted) ++heapAfterBoot;
+    if (void* p = malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main()
+{
+    const FSM::FSMTable* tables[] = { &clickNTable, &mediumHoldTable, &longHoldTable, &repeatTable };
+    for (auto i = 0; i < 8; ++i)
+        buttons.Add(10 + i, true, tables, 4);
+
+    const auto ram = Buttons::Ram();
+    printf("RAM: %zu bytes per pattern, %zu per button, %zu total for %d buttons\n",
+        ram.fsmBytes, ram.buttonBytes, ram.totalBytes, buttons.Count());
+
+    // button b clicks b + 1 times, then holds for 1.2 s
+    booted = true;
+    int counts[8][4] = {};
+    for (uint64_t t = 1; t <= 8000; ++t)
+    {
+        for (auto b = 0; b < 8; ++b)
+        {
+            const auto local = static_cast<int64_t>(t) - 500 - b * 100;
+            bool down = false;
+            if (0 <= local && local < (b + 1) * 200)
+                down = local % 200 < 100;
+            else if (3000 <= local && local < 4200)
+                down = true;
+            pins[10 + b] = down;
+        }
+        buttons.Sample(t, PinHigh);
+        if (t % 10 == 0)
+        {
+            buttons.UpdatePatternMatches(TickContext(t));
+            for (auto b = 0; b < 8; ++b)
+                for (auto p = 0; p < 4; ++p)
+                    counts[b][p] += buttons.Clicks(b, p);
+        }
+    }
+
+    for (auto b = 0; b < 8; ++b)
+        printf("button %d: clicks %d, medium %d, long %d\n", b, counts[b][0], counts[b][1], counts[b][2]);
+    printf("heap allocations after boot: %d\n", heapAfterBoot.load());
+    return heapAfterBoot == 0 ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Button.h"
+#include "TraceReplay.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace Lomont { namespace ButtonSim {
+
+MappedTrace::MappedTrace(const char* path)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("ERROR - cannot open %s\n", path);
+        return;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            data_ = static_cast<const uint8_t*>(p);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    close(fd);
+    if (!data_)
+        printf("ERROR - cannot map %s\n", path);
+}
+
+MappedTrace::~MappedTrace()
+{
+    if (data_)
+        munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+void FileSink(const uint8_t* bytes, size_t size, void* file)
+{
+    fwrite(bytes, 1, size, static_cast<FILE*>(file));
+}
+
+void PatternStats::Add(int count)
+{
+    ++reports;
+    counts += count;
+}
+
+void PatternStats::AddLatency(uint32_t latencyMs)
+{
+    ++latencies;
+    ++latency[latencyMs < LatencyBuckets ? latencyMs : LatencyBuckets - 1];
+}
+
+void PatternStats::Merge(const PatternStats& other)
+{
+    reports += other.reports;
+    counts += other.counts;
+    latencies += other.latencies;
+    for (auto i = 0; i < LatencyBuckets; ++i)
+        latency[i] += other.latency[i];
+}
+
+int PatternStats::Percentile(double p) const
+{
+    if (latencies == 0) return 0;
+    const auto rank = static_cast<uint64_t>(p * (latencies - 1) + 0.5);
+    uint64_t seen = 0;
+    for (auto i = 0; i < LatencyBuckets; ++i)
+    {
+        seen += latency[i];
+        if (seen > rank)
+            return i;
+    }
+    return LatencyBuckets - 1;
+}
+
+namespace {
+
+// the trace a replay on this thread reads, for the system hooks
+thread_local const TraceReader* replaying = nullptr;
+
+uint32_t ReadTracePins(int port, uint32_t portMask)
+{
+    return port < Trace::MaxPorts ? replaying->Levels(port) & portMask : 0;
+}
+
+uint64_t TraceClockMs()
+{
+    return replaying->NowMs();
+}
+
+// one replayed button, with what the replay tracks for it
+struct Replayed
+{
+    int traceId;   // button id in the trace
+    unique_ptr<Button> button;
+    bool down{ false };
+    uint64_t rawEdgeMs{ 0 };    // last raw level change
+    vector<uint64_t> reported;  // by pattern, raw edge already reported
+};
+
+bool ById(const TraceReader::Edge& a, const TraceReader::Edge& b)
+{
+    return a.buttonId < b.buttonId;
+}
+
+}
+
+ReplayResult Replay(const uint8_t* bytes, size_t size, const ReplayConfig& config)
+{
+    ReplayResult result;
+    TraceReader reader(bytes, size);
+    if (!reader.Valid()) return result;
+    const int patternMs = config.patternMs > 0 ? config.patternMs : 10;
+
+    // a system of its own with the recorded timings, sampled from the trace
+    SystemTimings timings = ButtonSystem::Default().Timings();
+    timings.debounceMs = reader.DebounceMs();
+    timings.debouncerInterruptMs = reader.DebouncerInterruptMs();
+    if (config.debounceSamples > 0)
+    {
+        timings.debounceMs = static_cast<uint8_t>(config.debounceSamples);
+        timings.debouncerInterruptMs = 1;
+    }
+    ButtonSystem system(timings);
+    system.Hooks().readPins = ReadTracePins;
+    system.Hooks().clockMs = TraceClockMs;
+    replaying = &reader;
+
+    const auto& defs = config.patterns ? *config.patterns : system.DefaultPatterns();
+    result.stats.resize(defs.size());
+    ButtonMultiPattern multi(system);
+    if (config.multiPatterns)
+        for (auto& def : *config.multiPatterns)
+            multi.patterns.emplace_back(&def);
+    result.multiStats.resize(multi.patterns.size());
+    vector<uint64_t> multiReported(multi.patterns.size(), ~0ULL);
+    uint64_t anyRawEdgeMs = 0;
+
+    vector<Replayed> buttons;
+    vector<TraceReader::Edge> edges, recorded;
+    uint32_t previous[Trace::MaxPorts]{};
+    uint64_t firstMs = 0, nextPatternMs = 0, nextEventMs = 0;
+    bool first = true;
+    bool stopped = false;
+
+    // counts each pattern reached, latency from the first report after a raw edge
+    const auto report = [&](PatternStats& stats, uint64_t& reported, uint64_t rawEdgeMs,
+        uint64_t nowMs, int buttonId, int pattern, int count)
+    {
+        stats.Add(count);
+        if (reported != rawEdgeMs)
+        {
+            stats.AddLatency(static_cast<uint32_t>(nowMs - rawEdgeMs));
+            reported = rawEdgeMs;
+        }
+        if (config.keepReports)
+            result.reports.push_back(Report{ nowMs, buttonId, pattern, count });
+    };
+
+    const auto patterns = [&](uint64_t nowMs)
+    {
+        const TickContext tick(nowMs);
+        if (!config.eventDriven)
+            system.UpdateAllPatternMatches(tick);
+        for (auto& b : buttons)
+            for (auto p = 0U; p < b.button->patterns.size(); ++p)
+                if (const int count = b.button->Clicks(static_cast<int>(p)))
+                    report(result.stats[p], b.reported[p], b.rawEdgeMs, nowMs, b.traceId, static_cast<int>(p), count);
+        if (multi.patterns.empty()) return;
+        multi.UpdatePatternMatches(tick);
+        for (auto p = 0U; p < multi.patterns.size(); ++p)
+            if (const int count = multi.patterns[p].Read0(0))
+                report(result.multiStats[p], multiReported[p], anyRawEdgeMs, nowMs, 0, static_cast<int>(p), count);
+    };
+
+    while (!stopped && reader.Next())
+    {
+        const uint64_t now = reader.NowMs();
+        if (first)
+        {
+            firstMs = now;
+            nextPatternMs = (now / patternMs + 1) * patternMs;
+            first = false;
+        }
+        for (; nextPatternMs < now; nextPatternMs += patternMs)
+            patterns(nextPatternMs);
+
+        if (reader.LayoutChanged())
+        { // keep buttons still present, make the new ones in id order with the recorded ids
+            vector<Replayed> next;
+            auto infos = reader.Buttons();
+            stable_sort(infos.begin(), infos.end(),
+                [](const TraceReader::ButtonInfo& a, const TraceReader::ButtonInfo& b) { return a.buttonId < b.buttonId; });
+            for (auto& info : infos)
+            {
+                if (!Trace::Traced(info.gpio))
+                { // no levels recorded, its edges are dropped below
+                    ++result.untraced;
+                    continue;
+                }
+                auto old = find_if(buttons.begin(), buttons.end(),
+                    [&](const Replayed& b) { return b.button && b.traceId == info.buttonId; });
+                if (old != buttons.end())
+                {
+                    next.push_back(move(*old));
+                    continue;
+                }
+                if (!system.SetNextButtonId(info.buttonId))
+                { // ids only count up in a live system, the trace is bad
+                    result.unmatchedId = info.buttonId;
+                    stopped = true;
+                    break;
+                }
+                next.push_back(Replayed{ info.buttonId, make_unique<Button>(system, info.gpio, info.downIsHigh),
+                    false, 0, vector<uint64_t>(defs.size(), ~0ULL) });
+                auto& b = next.back();
+                if (config.patterns)
+                {
+                    b.button->patterns.clear();
+                    for (auto& def : defs)
+                        b.button->patterns.emplace_back(&def);
+                }
+            }
+            if (stopped) break;
+            buttons = move(next); // dropped buttons leave the system here
+            // reports in the order the trace lists buttons
+            const auto& order = reader.Buttons();
+            stable_sort(buttons.begin(), buttons.end(), [&](const Replayed& a, const Replayed& b)
+            {
+                const auto at = [&](int id) { return find_if(order.begin(), order.end(),
+                    [&](const TraceReader::ButtonInfo& i) { return i.buttonId == id; }) - order.begin(); };
+                return at(a.traceId) < at(b.traceId);
+            });
+            nextEventMs = now;
+        }
+
+        // raw level changes, for latency
+        for (auto p = 0; p < Trace::MaxPorts; ++p)
+        {
+            const uint32_t rawChanged = reader.Levels(p) ^ previous[p];
+            if (!rawChanged) continue;
+            previous[p] = reader.Levels(p);
+            for (auto& b : buttons)
+            {
+                const int gpio = b.button->GpioNum();
+                if (gpio / 32 == p && ((rawChanged >> (gpio % 32)) & 1) != 0)
+                    anyRawEdgeMs = b.rawEdgeMs = now;
+            }
+        }
+
+        system.SamplePorts(now);
+
+        // debounced edges this pass, as the sampler left them
+        edges.clear();
+        const TickContext tick(now);
+        for (auto& b : buttons)
+        {
+            const bool down = b.button->IsDown(tick);
+            if (down == b.down) continue;
+            b.down = down;
+            edges.push_back(TraceReader::Edge{ b.traceId, down });
+        }
+        result.edges += edges.size();
+        if (!edges.empty() || !reader.Edges().empty())
+        {
+            recorded = reader.Edges();
+            recorded.erase(remove_if(recorded.begin(), recorded.end(), [&](const TraceReader::Edge& e)
+                { return none_of(buttons.begin(), buttons.end(), [&](const Replayed& b) { return b.traceId == e.buttonId; }); }),
+                recorded.end());
+            sort(edges.begin(), edges.end(), ById);
+            sort(recorded.begin(), recorded.end(), ById);
+            const bool same = equal(edges.begin(), edges.end(), recorded.begin(), recorded.end(),
+                [](const TraceReader::Edge& a, const TraceReader::Edge& b)
+                { return a.buttonId == b.buttonId && a.down == b.down; });
+            result.mismatches += same ? 0 : 1;
+        }
+
+        if (config.eventDriven && (!edges.empty() || nextEventMs <= now))
+            nextEventMs = system.UpdateAllPatternEvents(now);
+
+        if (nextPatternMs == now)
+        {
+            patterns(now);
+            nextPatternMs += patternMs;
+        }
+        result.spanMs = now - firstMs;
+    }
+    buttons.clear();
+    replaying = nullptr;
+    result.passes = reader.Passes();
+    result.ok = !reader.Error() && !stopped;
+    return result;
+}
+
+}}
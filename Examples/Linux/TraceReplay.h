@@ -0,0 +1,114 @@
+#pragma once
+
+// button sample traces on Linux: record to a file, map a file and replay it
+// through the debouncer and patterns, see SampleTrace.h
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ButtonHelp.h"
+
+namespace Lomont { namespace ButtonSim {
+
+    // a trace file mapped read only, pages come in as the reader touches them
+    class MappedTrace
+    {
+    public:
+        explicit MappedTrace(const char* path);
+        ~MappedTrace();
+        MappedTrace(const MappedTrace&) = delete;
+        MappedTrace& operator=(const MappedTrace&) = delete;
+
+        bool Valid() const { return data_ != nullptr; }
+        const uint8_t* Data() const { return data_; }
+        size_t Size() const { return size_; }
+
+    private:
+        const uint8_t* data_{ nullptr };
+        size_t size_{ 0 };
+    };
+
+    // TraceRecorder sink, user is the FILE*
+    void FileSink(const uint8_t* bytes, size_t size, void* file);
+
+    // a pattern count seen by the pattern loop
+    struct Report
+    {
+        uint64_t atMs;
+        int buttonId;
+        int pattern;
+        int count;
+
+        bool operator==(const Report& r) const
+        {
+            return atMs == r.atMs && buttonId == r.buttonId && pattern == r.pattern && count == r.count;
+        }
+    };
+
+    // matches of one pattern, with latency from the last raw edge of the
+    // button to the first report after it, as bench_suite measures it,
+    // 1 ms buckets, the last holds longer ones
+    struct PatternStats
+    {
+        static constexpr int LatencyBuckets = 8192;
+
+        uint64_t reports{ 0 };
+        uint64_t counts{ 0 };
+        uint64_t latencies{ 0 }; // reports that were the first after a raw edge
+        std::vector<uint32_t> latency = std::vector<uint32_t>(LatencyBuckets, 0);
+
+        void Add(int count);
+        void AddLatency(uint32_t latencyMs);
+        void Merge(const PatternStats& other);
+        // latency at fraction p of first reports, ms
+        int Percentile(double p) const;
+    };
+
+    struct ReplayConfig
+    {
+        // debouncer samples to change state, 0 for the trace header
+        // debounceMs / debouncerInterruptMs, as DebouncerBank
+        int debounceSamples{ 0 };
+
+        // patterns run on every button, nullptr for the default patterns
+        // of the default system's timings
+        const std::vector<ButtonHelpers::FSM::FSMDef>* patterns{ nullptr };
+
+        // multi button patterns over the trace's button ids, reported with
+        // button id 0, nullptr for none
+        const std::vector<ButtonHelpers::FSM::FSMDef>* multiPatterns{ nullptr };
+
+        // UpdateAllPatternMatches every patternMs, on multiples of
+        // patternMs, after the pass at that time. Counts are read then.
+        int patternMs{ 10 };
+
+        // run button patterns with UpdateAllPatternEvents on each debounced
+        // edge and deadline instead, multi button patterns still poll
+        bool eventDriven{ false };
+
+        // keep every report in ReplayResult::reports, else only stats
+        bool keepReports{ true };
+    };
+
+    struct ReplayResult
+    {
+        bool ok{ false };          // trace read to its end
+        uint64_t passes{ 0 };
+        uint64_t spanMs{ 0 };      // first to last pass
+        uint64_t edges{ 0 };       // debounced edges in replay
+        uint64_t mismatches{ 0 };  // passes whose edges differ from the recorded ones
+        uint64_t untraced{ 0 };    // buttons skipped in layouts, on pins past Trace::MaxPorts
+        int unmatchedId{ 0 };      // recorded button id the replay could not give, replay stopped there
+        std::vector<Report> reports;
+        std::vector<PatternStats> stats; // by pattern index
+        std::vector<PatternStats> multiStats; // by multi pattern index
+    };
+
+    // Run a trace through a ButtonSystem of its own, its hooks reading
+    // levels and time from the trace, so the sampler, debouncer and
+    // patterns are the ones a device runs. Reads only the default system's
+    // timings, writes no globals, so traces and configs can be replayed on
+    // many threads at once.
+    ReplayResult Replay(const uint8_t* bytes, size_t size, const ReplayConfig& config = ReplayConfig());
+
+}}
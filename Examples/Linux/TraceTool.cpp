@@ -0,0 +1,213 @@
+// record raw button samples to a compact trace file, replay trace files
+// through the debouncer and the default patterns at full CPU speed
+// the demo also runs the two button test patterns, and an event driven replay
+//   trace_tool record FILE [hours] - click model session on the virtual clock
+//   trace_tool replay FILE         - map FILE and replay it
+//   trace_tool [hours]             - record build/demo.trace, replay it, compare
+// the session has 8 buttons: gpio 0-3 pull high when pressed, 32-35 pull low
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "Button.h"
+#include "ButtonSim.h"
+#include "ClickModel.h"
+#include "TraceReplay.h"
+
+using namespace std;
+using namespace Lomont;
+using namespace Lomont::ButtonHelpers;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+const int gpios[] = { 0, 1, 2, 3, 32, 33, 34, 35 };
+const int patternMs = 10;
+
+// two button patterns run live and in replay
+ButtonMultiPattern chords;
+
+double Seconds(Clock::duration d)
+{
+    return chrono::duration<double>(d).count();
+}
+
+// pin level for a button state
+bool High(int gpio, bool down)
+{
+    return gpio < 32 ? down : !down;
+}
+
+// make the session buttons, pins at rest
+vector<ButtonPtr> MakeButtons()
+{
+    vector<ButtonPtr> buttons;
+    for (auto gpio : gpios)
+    {
+        ButtonSim::SetPin(gpio, High(gpio, false));
+        buttons.push_back(make_shared<Button>(gpio, gpio < 32));
+    }
+    return buttons;
+}
+
+// click model presses on each button from startMs for runMs
+void Schedule(uint64_t startMs, uint64_t runMs)
+{
+    for (auto gpio : gpios)
+    {
+        ButtonSim::ClickModel model(1000 + gpio);
+        for (auto& e : model.Edges(startMs, startMs + runMs))
+            ButtonSim::SetPinAt(e.atMs, gpio, High(gpio, e.down));
+    }
+}
+
+// live session on the virtual clock, recorded to path
+vector<ButtonSim::Report> Record(const char* path, double hours)
+{
+    vector<ButtonSim::Report> reports;
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        printf("ERROR - cannot write %s\n", path);
+        return reports;
+    }
+    const auto runMs = static_cast<uint64_t>(hours * 3600 * 1000);
+    static uint8_t buffer[4096];
+    TraceRecorder recorder(buffer, sizeof(buffer), ButtonSim::FileSink, file);
+    const auto wallStart = Clock::now();
+    {
+        const auto buttons = MakeButtons();
+        Button::trace = &recorder;
+        const uint64_t startMs = ButtonSim::NowMs(); // a multiple of patternMs
+        Schedule(startMs, runMs);
+        const auto passes0 = ButtonSim::Passes();
+        for (auto t = startMs + patternMs; t <= startMs + runMs; t += patternMs)
+        {
+            ButtonSim::RunUntil(t);
+            Button::UpdateAllPatternMatches(TickContext(t));
+            for (auto& b : buttons)
+                for (auto p = 0; p < 4; ++p)
+                    if (const int count = b->Clicks(p))
+                        reports.push_back(ButtonSim::Report{ t, b->buttonId, p, count });
+            chords.UpdatePatternMatches(TickContext(t));
+            for (auto p = 0U; p < chords.patterns.size(); ++p)
+                if (const int count = chords.patterns[p].Read0(0))
+                    reports.push_back(ButtonSim::Report{ t, 0, static_cast<int>(p), count });
+        }
+        Button::trace = nullptr;
+        recorder.Finish();
+        if (recorder.Untraced())
+            printf("ERROR - buttons on pins past port %d have no levels in the trace\n", Trace::MaxPorts - 1);
+        const auto passes = ButtonSim::Passes() - passes0;
+        printf("recorded %.1f hours, %llu passes, %zu pattern reports in %.2f s\n", hours,
+            static_cast<unsigned long long>(passes), reports.size(), Seconds(Clock::now() - wallStart));
+        printf("  %llu bytes, %.0f bytes per hour, %.4f bytes per pass\n",
+            static_cast<unsigned long long>(recorder.Bytes()), recorder.Bytes() / hours,
+            static_cast<double>(recorder.Bytes()) / passes);
+    }
+    fclose(file);
+    return reports;
+}
+
+// interrupt pass cost with and without the recorder, 8 buttons, 10 minutes
+void RecordCost()
+{
+    const uint64_t runMs = 10 * 60 * 1000;
+    vector<pair<uint64_t, pair<int, bool>>> changes;
+    for (auto gpio : gpios)
+    {
+        ButtonSim::ClickModel model(2000 + gpio);
+        for (auto& e : model.Edges(0, runMs))
+            changes.push_back({ e.atMs, { gpio, High(gpio, e.down) } });
+    }
+    stable_sort(changes.begin(), changes.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    static uint8_t buffer[1 << 20];
+    double ns[2] = {};
+    uint64_t bytes = 0;
+    for (auto pass = 0; pass < 4; ++pass) // off, on, off, on, keep the best of each
+    {
+        const bool on = (pass & 1) != 0;
+        TraceRecorder recorder(buffer, sizeof(buffer));
+        const auto buttons = MakeButtons();
+        Button::trace = on ? &recorder : nullptr;
+        const uint64_t startMs = ButtonSim::NowMs();
+        auto next = changes.begin();
+        Clock::duration spent{ 0 };
+        for (uint64_t t = 0; t < runMs; ++t)
+        {
+            while (next != changes.end() && next->first <= t)
+            {
+                ButtonSim::SetPin(next->second.first, next->second.second);
+                ++next;
+            }
+            const auto begin = Clock::now();
+            ButtonSim::Tick(startMs + t);
+            spent += Clock::now() - begin;
+        }
+        Button::trace = nullptr;
+        const double passNs = chrono::duration<double, nano>(spent).count() / runMs;
+        ns[on] = pass < 2 ? passNs : min(ns[on], passNs);
+        if (on)
+            bytes = recorder.Bytes();
+    }
+    printf("interrupt pass, 8 buttons: %.1f ns without recorder, %.1f ns with, %.1f ns per pass for %llu bytes\n",
+        ns[0], ns[1], ns[1] - ns[0], static_cast<unsigned long long>(bytes));
+}
+
+// replay a trace, timed
+ButtonSim::ReplayResult ReplayFile(const char* path, bool eventDriven = false)
+{
+    ButtonSim::MappedTrace trace(path);
+    if (!trace.Valid()) return {};
+    const auto start = Clock::now();
+    ButtonSim::ReplayConfig config;
+    config.patternMs = patternMs;
+    config.multiPatterns = chords.defs.empty() ? nullptr : &chords.defs;
+    config.eventDriven = eventDriven;
+    auto result = ButtonSim::Replay(trace.Data(), trace.Size(), config);
+    const double seconds = Seconds(Clock::now() - start);
+    printf("%sreplayed %zu bytes, %llu passes, %.1f hours in %.3f s, %.0fx real time, %.0f ns per pass\n",
+        eventDriven ? "event driven " : "", trace.Size(), static_cast<unsigned long long>(result.passes), result.spanMs / 3600000.0, seconds,
+        result.spanMs / 1000.0 / seconds, seconds * 1e9 / max<uint64_t>(result.passes, 1));
+    printf("  %llu debounced edges, %llu passes differ from the recorded edges, %zu pattern reports%s\n",
+        static_cast<unsigned long long>(result.edges), static_cast<unsigned long long>(result.mismatches),
+        result.reports.size(), result.ok ? "" : ", trace damaged");
+    if (result.unmatchedId)
+        printf("ERROR - replay stopped, cannot give button id %d, ids only count up\n", result.unmatchedId);
+    return result;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    ButtonSim::UseVirtualClock();
+    if (argc >= 3 && strcmp(argv[1], "record") == 0)
+    {
+        Record(argv[2], argc >= 4 ? atof(argv[3]) : 1.0);
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "replay") == 0)
+    {
+        const auto result = ReplayFile(argv[2]);
+        return result.ok && result.mismatches == 0 ? 0 : 1;
+    }
+
+    const char* path = "build/demo.trace";
+    chords.AddTestPatterns();
+    const auto live = Record(path, argc >= 2 ? atof(argv[1]) : 1.0);
+    const auto replayed = ReplayFile(path);
+    const bool same = replayed.ok && replayed.mismatches == 0 && replayed.reports == live;
+    printf("replayed pattern reports match the live run: %s\n", same ? "yes" : "NO");
+    // patterns at the exact edge and deadline times, so reports may move
+    ReplayFile(path, true);
+    RecordCost();
+    return same ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// small work stealing pool for independent tasks
+// tasks 0 to count - 1 are dealt round robin to per worker deques. A worker
+// takes from the back of its own deque and, when that is empty, steals from
+// the front of the others. Tasks here are coarse (a whole trace replay), so
+// one mutex per deque costs nothing next to the work and keeps it simple.
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lomont { namespace ButtonSim {
+
+    class WorkStealingPool
+    {
+    public:
+        // run task(worker, index) for every index on workers threads,
+        // returns when all are done. Returns tasks stolen.
+        size_t Run(size_t count, int workers, const std::function<void(int worker, size_t index)>& task)
+        {
+            if (workers < 1) workers = 1;
+            queues_.clear();
+            for (auto w = 0; w < workers; ++w)
+                queues_.push_back(std::make_unique<Queue>());
+            for (size_t i = 0; i < count; ++i)
+                queues_[i % workers]->tasks.push_back(i);
+
+            std::vector<size_t> stolen(workers, 0);
+            std::vector<std::thread> threads;
+            for (auto w = 1; w < workers; ++w)
+                threads.emplace_back([&, w] { Work(w, task, stolen[w]); });
+            Work(0, task, stolen[0]);
+            for (auto& t : threads)
+                t.join();
+
+            size_t total = 0;
+            for (auto s : stolen)
+                total += s;
+            return total;
+        }
+
+    private:
+        struct Queue
+        {
+            std::mutex lock;
+            std::deque<size_t> tasks;
+        };
+        std::vector<std::unique_ptr<Queue>> queues_;
+
+        // no task makes more tasks, so all queues empty means done
+        void Work(int self, const std::function<void(int, size_t)>& task, size_t& stolen)
+        {
+            const int workers = static_cast<int>(queues_.size());
+            size_t index;
+            for (;;)
+            {
+                if (Pop(*queues_[self], false, index))
+                {
+                    task(self, index);
+                    continue;
+                }
+                bool found = false;
+                for (auto k = 1; k < workers && !found; ++k)
+                    found = Pop(*queues_[(self + k) % workers], true, index);
+                if (!found)
+                    return;
+                ++stolen;
+                task(self, index);
+            }
+        }
+
+        static bool Pop(Queue& q, bool front, size_t& index)
+        {
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (q.tasks.empty()) return false;
+            if (front)
+            {
+                index = q.tasks.front();
+                q.tasks.pop_front();
+            }
+            else
+            {
+                index = q.tasks.back();
+                q.tasks.pop_back();
+            }
+            return true;
+        }
+    };
+
+}}
@@ -2,6 +2,7 @@
 #ifdef _MSC_VER // __WIN32__ || _CONSOLE // Win32 types
 
 #include <windows.h>
+#include <chrono>
 #include <thread>
 #include <memory>
 using namespace std;
@@ -13,28 +14,43 @@ using namespace Lomont::ButtonHelpers;
 
 namespace {
 
-    // timer interrupt for buttons
-    void ButtonISR(void*)
+    // keys as 32 pin ports, port p pin i is virtual key code 32 * p + i
+    // Windows has no port read, so loop the keys in use
+    uint32_t ReadPinsWin32(int port, uint32_t portMask)
     {
-	    const uint64_t elapsedMs = ButtonHW::ElapsedMs();
-        // process each button
-        for (const auto& b : Button::buttonPtrs)
+        uint32_t levels = 0;
+        for (auto i = 0; i < 32; ++i)
         {
-	        const SHORT k = GetAsyncKeyState(b->GpioNum());
-	        const auto isDown = (k & 0x8000) != 0; // high bit down
-            // ignore pull direction in windows, since keyboard handled it
-            //if (!b->DownIsHigh()) 
-            //    isDown = !isDown;
-            b->DebounceInput(isDown, elapsedMs); // call debouncer code
+            if ((portMask & (1U << i)) == 0) continue;
+	        const SHORT k = GetAsyncKeyState(32 * port + i);
+            if ((k & 0x8000) != 0) // high bit down
+                levels |= 1U << i;
         }
+        return levels;
+    }
+
+    // timer interrupt for buttons
+    void ButtonISR(void*)
+    {
+	    const uint64_t elapsedMs = ButtonHW::NowMs();
+        // process each button, keys read per port
+        // keyboard keys read high on down, so make buttons with downIsHigh = true
+        Button::SamplePorts(elapsedMs);
     }
 
 	shared_ptr<thread> th{nullptr};
     atomic<bool> stopThread;
 void ThreadLoop()
 {
+    // timer interrupt stand in, sleep between passes instead of spinning
+    const auto period = chrono::milliseconds(ButtonTimings::debouncerInterruptMs);
+    auto next = chrono::steady_clock::now();
     while (!stopThread)
+    {
         ButtonISR(nullptr);
+        next += period;
+        this_thread::sleep_until(next);
+    }
 }
 
 }
@@ -42,6 +58,7 @@ void ThreadLoop()
 void ButtonHW::StartDebouncerInterrupt()
 {
     if (th) return; // already running
+    ButtonHW::ReadPins = ReadPinsWin32;
     stopThread = false;
     th = make_shared<thread>(ThreadLoop);
 }
@@ -17,16 +17,11 @@ int main()
 	// set pin pull directions to match your hardware!
 	StartButtons('Z', true, 'X', true);
 
-	auto t = ButtonHelpers::ButtonHW::ElapsedMs();
 	bool done = false;
 	while (!done)
 	{
-		// wait till change
-		while (t == ButtonHelpers::ButtonHW::ElapsedMs())
-		{
-
-		}
-		t = ButtonHelpers::ButtonHW::ElapsedMs();
+		// sleep, do not spin, patterns only need a few ms resolution
+		Sleep(5);
 
 		ProcessButtons();
 
@@ -24,7 +24,7 @@ ButtonMultiPatternPtr multiPattern{ nullptr };
 	// Start/Stop the button interrupt
 	// interrupt should
 	// 1 - get elapsed time in ms from Button::ElapsedMs
-	// 2 - for each button in system (via buttonPtrs),
+	// 2 - for each button in system (via Button::buttonPtrs.Read()),
 	//     1 - read pin, process whether pins high or low means button down
 	//     2 - call base class Debouncer DebounceInput with isDown and elapsedMs
 	void StartDebouncerInterrupt();
@@ -32,6 +32,10 @@ ButtonMultiPatternPtr multiPattern{ nullptr };
 
 	// prepare hardware as needed for a new pin to watch
 	void SetPinHardware(int gpioPinNumber, bool downIsHigh);
+
+	// optional: set ReadPins to read a whole port at once, then the
+	// interrupt just calls Button::SamplePorts(elapsedMs)
+	extern uint32_t (*ReadPins)(int port, uint32_t portMask);
 */
 
 
@@ -59,6 +63,9 @@ void ProcessButtons()
 	// default single click patterns
 	const string singleClickNames[] = {"ClickN","Medium hold","Long hold","Repeat"};
 
+	// one clock read for the whole pass, all patterns see the same time
+	const ButtonHelpers::TickContext tick;
+
 	// update button patterns, see which patterns have occurred
 	for (const auto& b : Button::buttonPtrs)
 	{
@@ -66,7 +73,7 @@ void ProcessButtons()
 		// bool isDown = b->IsDown();
 
 		// update any patterns being watched
-		b->UpdatePatternMatches();
+		b->UpdatePatternMatches(tick);
 
 		// walk patterns to look for matches
 		for (auto patternIndex = 0U; patternIndex < b->patterns.size(); ++patternIndex)
@@ -92,7 +99,7 @@ void ProcessButtons()
 	if (multiPattern)
 	{
 		// update patterns
-		multiPattern->UpdatePatternMatches();
+		multiPattern->UpdatePatternMatches(tick);
 		for (auto patternIndex = 0U; patternIndex < multiPattern->patterns.size(); ++patternIndex)
 		{
 			const auto clicks = multiPattern->Clicks(patternIndex);
@@ -35,6 +35,12 @@ SOFTWARE.
 #include <vector>
 #include <atomic>
 #include "ButtonHelp.h"
+#include "ButtonRegistry.h"
+#include "ButtonSystem.h"
+#include "PatternEvents.h"
+#include "EdgeQueue.h"
+#include "SampleTrace.h"
+#include "FSMBank.h"
 
 namespace Lomont {
 
@@ -50,7 +56,8 @@ namespace Lomont {
      * Creating new patterns: 
      * 1. Patterns are state machines. 
      * 2. Look at existing patterns until you understand how they work
-     * 3. setting dumpStateChangesToConsole to true helps in debugging patterns
+     * 3. setting a pattern's trace to a StateTraceRing records its state
+     *    changes for FormatStateTrace, which helps in debugging patterns
      *
      */
 
@@ -62,12 +69,20 @@ namespace Lomont {
         // return counter from matches, clear counter
         int Clicks(unsigned int patternIndex = 0, int counterIndex = 0)
         {
-            if (patterns.size() <= patternIndex)
-                return 0;
-            return patterns[patternIndex].Read0(counterIndex);
+            if (patternIndex < patterns.size())
+                return patterns[patternIndex].Read0(counterIndex);
+            patternIndex -= static_cast<unsigned int>(patterns.size());
+            if (bankSet && patternIndex < banked.size())
+                return bankSet->Read0(banked[patternIndex], counterIndex);
+            return 0;
         }
         // list of patterns as finite state machines
         std::vector<ButtonHelpers::FSM::ButtonFSM> patterns;
+
+        // optional backing store, patterns kept in an FSMBankSet shared with
+        // other buttons, indexed after patterns by Clicks, see Button::UseBank
+        ButtonHelpers::FSM::FSMBankSet* bankSet{ nullptr };
+        std::vector<ButtonHelpers::FSM::BankRef> banked;
     };
 
 
@@ -81,37 +96,138 @@ namespace Lomont {
         // starts button timer interrupts, attaches to system
         Button(int gpioNum, bool downIsHigh = true);
 
+        // as above, in the given system instead of ButtonSystem::Default()
+        // system must outlive the button
+        Button(ButtonSystem& system, int gpioNum, bool downIsHigh = true);
+
         // remove button from system, close out 
         // interrupt stopped on last button gone
         ~Button();
 
-        // NOTE: can check with base Debouncer class 
+        // registered by address, so no copies
+        Button(const Button&) = delete;
+        Button& operator=(const Button&) = delete;
+
+        // as Debouncer versions, also post any change to edgeEvents once
+        // UpdateAllPatternEvents is in use
+        bool DebounceInput(bool buttonDown, uint64_t elapsedMs);
+        void SetDebounced(bool buttonDown, uint64_t elapsedMs);
+
+        // as Debouncer version, with the timings of this button's system
+        bool Settled() const;
+
         // is debounced button down?
         // optionally gets time this state was changed
-        // bool Debouncer::IsDown(uint64_t * timeInState = nullptr) const;
+        // reads the clock of this button's system, the TickContext
+        // version from Debouncer reads none
+        using Debouncer::IsDown;
+        bool IsDown(uint64_t* stateChangeTimeMs = nullptr) const;
 
         // call often to look for button clicks, long presses, etc.
         // often = every 5-20ms or so
         void UpdatePatternMatches();
 
+        // as above, at the pass time in tick, no clock reads
+        void UpdatePatternMatches(const ButtonHelpers::TickContext& tick);
+
+        // UpdatePatternMatches on every button with one clock read
+        static void UpdateAllPatternMatches(const ButtonHelpers::TickContext& tick = ButtonHelpers::TickContext());
+
+        // event driven alternative to UpdatePatternMatches
+        // runs the patterns only on a debounced edge or when a pattern's time
+        // bound comes due, each evaluated at the exact ms it happened
+        // returns the ms this next needs calling if no edge comes first,
+        // or FSM::NoDeadlineMs if only an edge can change a pattern
+        uint64_t UpdatePatternEvents(uint64_t nowMs);
+
+        // runs patterns for every edge in edgeEvents, in order, then every
+        // deadline due by nowMs. Deadlines are kept in a timing wheel so idle
+        // buttons are not visited. A fast down/up pair between calls is seen
+        // as two edges at their sampled times, not missed.
+        // returns the earliest next deadline
+        // call from the thread that makes and destroys buttons
+        static uint64_t UpdateAllPatternEvents(uint64_t nowMs);
+
+        // debounced edges from the interrupt, consumed by UpdateAllPatternEvents
+        // and posted only after its first call, polling never fills it
+        // if it fills, newest edges are dropped and patterns resync to IsDown
+        static ButtonHelpers::EdgeQueue& edgeEvents;
+
+        // optional, called from the interrupt after a pass in which any button
+        // changed debounced state. Use it to wake a thread that sleeps until
+        // the UpdateAllPatternEvents deadline.
+        static void (*&edgeWake)();
+
+        // optional recorder of raw levels and debounced edges, fed by
+        // SamplePorts, see SampleTrace.h. Set and clear while sampling is
+        // stopped. The per pin sampling path is not recorded.
+        static ButtonHelpers::TraceRecorder*& trace;
+
+        // run these tables in set instead of patterns, which are cleared.
+        // set.Update advances all buttons in the set in one pass, and event
+        // driven updates skip banked patterns. set must outlive this button.
+        void UseBank(ButtonHelpers::FSM::FSMBankSet& set, const std::vector<ButtonHelpers::FSM::FSMTable>& tables);
+
         // get button GPIO
         int GpioNum() const { return gpioNum_; }
 
         // check if button is down = high or low voltage
         bool DownIsHigh() const { return downIsHigh_; }
 
+        // the system this button belongs to
+        ButtonSystem& System() const { return *system_; }
+
         // unique button id, 1+
         int buttonId;
 
-        // todo - list default patterns 
+        // default patterns every button gets, in pattern index order:
+        // click-N, medium hold, long hold, repeat
+        // built from ButtonTimings on first use
+        static const std::vector<ButtonHelpers::FSM::FSMDef>& DefaultPatterns();
+
+        // the default patterns built from the given timings, touches no
+        // globals, so safe from any thread
+        static std::vector<ButtonHelpers::FSM::FSMDef> MakeDefaultPatterns(const ButtonHelpers::PatternTimings& timings);
+
+        // the default patterns as packed tables sharing one action pool,
+        // same order, for patterns.emplace_back(&table) in place of the defs
+        static const std::vector<ButtonHelpers::FSM::FSMTable>& DefaultPatternTables();
 
         // track all active buttons
-        static std::vector<Button*> buttonPtrs;
+        // from the interrupt or other threads, iterate Button::buttonPtrs.Read()
+        static ButtonRegistry& buttonPtrs;
+
+        // called from interrupt when ButtonHW::ReadPins is set
+        // reads each GPIO port in use once, debounces all its buttons as one word
+        static void SamplePorts(uint64_t elapsedMs);
+
+        // adaptive sampling, active when ButtonHW::SetSamplePeriodMs is set
+        // call at the end of each interrupt pass, settled is true if every
+        // Debouncer::Settled. After ButtonTimings::idleAfterMs settled the
+        // interrupt stops (with ButtonHW::ArmEdgeWakeup) or slows to
+        // ButtonTimings::idleSampleMs. SamplePorts calls this itself.
+        static void EndSamplePass(bool settled, uint64_t elapsedMs);
+
+        // back to full rate sampling, call from the pin change wakeup
+        // armed by ButtonHW::ArmEdgeWakeup. Safe from any context.
+        static void SamplerWake();
+
+        // the static functions above act on ButtonSystem::Default(), whose
+        // members the static data above refer to
 
     private:
+        friend class ButtonSystem; // runs pattern events
 
+        ButtonSystem* system_;
         int gpioNum_{ -1 };
         bool downIsHigh_{ true }; // button pulls high or pulls low when pressed
+        ButtonHelpers::RegistryHandle registryHandle_; // slot in buttonPtrs
+
+        // event driven pattern state, see UpdatePatternEvents
+        ButtonHelpers::PatternEvents events_;
+        uint64_t ApplyPatternEvents(bool isDown, uint64_t changedMs, uint64_t nowMs);
+
+        void ReleaseBank();
     };
 
     using ButtonPtr = std::shared_ptr<Button>;
@@ -119,29 +235,26 @@ namespace Lomont {
     class ButtonMultiPattern : public HasPatterns
     {
     public:
+        // patterns over the buttons of the given system
+        explicit ButtonMultiPattern(ButtonSystem& system = ButtonSystem::Default()) : system_(&system) {}
+
         // call often to look for multi button patterns
         // often = every 5-20ms or so
-        void UpdatePatternMatches()
-        {
-            for (const auto& b : Button::buttonPtrs)
-            {
-                // each button state and info
-                uint64_t timeStateChangedMs;
-                const bool isDown = b->IsDown(&timeStateChangedMs);
-
-                const uint64_t stateTime = ButtonHelpers::ButtonHW::ElapsedMs() - timeStateChangedMs; // for Up/Down
+        // each button only visits the patterns whose current state has an
+        // arrow for it, and only those arrows, see FSM::ArrowIndex
+        // reads the clock of this system
+        void UpdatePatternMatches();
 
-                for (auto& p : patterns)
-                    p.Update(b->buttonId, isDown, stateTime);
-            }
-        }
-        // todo - make helper for combos like Konami code
-        // Konami: UUDDLRLRBA  on controller:
+        // as above, at the pass time in tick, no clock reads
+        void UpdatePatternMatches(const ButtonHelpers::TickContext& tick);
 
+        // combos like the Konami code: write them with BUTTON_PATTERN in
+        // PatternDSL.h, add with patterns.emplace_back(&pattern.table)
 
         // Add pattern for button 1 down, then 2 down, then 1 up, then 2 up
         // with given min and max times for transitions
-        void AddABABPattern(int T0, int T1)
+        // buttonA and buttonB are button ids for 1 and 2
+        void AddABABPattern(int T0, int T1, int buttonA = 1, int buttonB = 2)
         {
             using namespace ButtonHelpers::FSM;    // make construction easier
 
@@ -150,40 +263,40 @@ namespace Lomont {
             abab.Build({
                 // state 0 - 1?,2? : wait for 2 up
                 State({
-                    Arrow(1,2, false,0),
+                    Arrow(1,buttonB, false,0),
                 }),
 
                 // state 1 - 1?,2u : wait for 1 up
                 State({
-                    Arrow(2,1, false,0),
-                    Arrow(0,2, true,0)  // 2 down resets
+                    Arrow(2,buttonA, false,0),
+                    Arrow(0,buttonB, true,0)  // 2 down resets
                 }),
 
                 // state 2 - 1u,2u : wait for 1 down at least T0
                 State({
-                    Arrow(3,1, true,T0),
-                    Arrow(0,2, true,0)  // 2 down resets
+                    Arrow(3,buttonA, true,T0),
+                    Arrow(0,buttonB, true,0)  // 2 down resets
                 }),
 
                 // state 3 - 1d,2u : wait for 2 down
                 State({
-                    Arrow(4,2, true,T0),
-                    Arrow(0,1, false,0), // 1 up resets 
-                    Arrow(0,1, 2, 3, T1)// 1 down in this state too long resets
+                    Arrow(4,buttonB, true,T0),
+                    Arrow(0,buttonA, false,0), // 1 up resets 
+                    Arrow(0,buttonA, 2, 3, T1)// 1 down in this state too long resets
                 }),
 
                 // state 4 - 1d,2d : wait for 1 up
                 State({
-                    Arrow(5,1, false,T0),
-                    Arrow(0,2, false,0), // 2 up resets 
-                    Arrow(0,2, 2, 3, T1)// 2 down in this state too long resets
+                    Arrow(5,buttonA, false,T0),
+                    Arrow(0,buttonB, false,0), // 2 up resets 
+                    Arrow(0,buttonB, 2, 3, T1)// 2 down in this state too long resets
                 }),
 
                 // state 5 - 1u,2d : wait for 2 up
                 State({
-                    Arrow(0,2, false,0,{IncrementCounter(0)}),
-                    Arrow(0,1, true,0), // 1 down resets 
-                    Arrow(0,2, 2, 3, T1)// 2 down in this state too long resets
+                    Arrow(0,buttonB, false,0,{IncrementCounter(0)}),
+                    Arrow(0,buttonA, true,0), // 1 down resets 
+                    Arrow(0,buttonB, 2, 3, T1)// 2 down in this state too long resets
                 }),
 
                 });
@@ -201,12 +314,29 @@ namespace Lomont {
             for (const auto& f : defs)
             {
                 patterns.emplace_back(&f);
-                // patterns.back().dumpStateChangesToConsole = true; // set to true to see state transitions on console
+                // patterns.back().trace = &ring; // set to record state transitions, see StateTrace.h
             }
         }
 
         // need these to live as long as needed
         std::vector<ButtonHelpers::FSM::FSMDef> defs;
+
+    private:
+        ButtonSystem* system_;
+
+        // pattern dispatch, rebuilt when patterns change
+        void BuildDispatch();
+        void Watch(int pattern);   // list pattern under the buttons its state names
+        void Unwatch(int pattern);
+
+        std::vector<ButtonHelpers::FSM::ArrowIndex> indexes_; // one per distinct FSMDef
+        std::vector<const ButtonHelpers::FSM::FSMDef*> indexedDefs_; // def of each pattern when built
+        std::vector<const ButtonHelpers::FSM::FSMTable*> indexedTables_; // or its table, always visited
+        std::vector<int> indexOf_;    // index of each pattern
+        std::vector<int> watchState_; // state each pattern is listed under
+        std::vector<std::vector<int>> watchers_; // by buttonId, patterns to visit
+        std::vector<int> anyWatchers_; // patterns whose state has an arrow for any button
+        std::vector<int> visit_;       // scratch
     };
 
     using ButtonMultiPatternPtr = std::shared_ptr<ButtonMultiPattern>;
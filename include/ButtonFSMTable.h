@@ -0,0 +1,160 @@
+#pragma once
+#ifndef BUTTON_FSM_TABLE_H
+#define BUTTON_FSM_TABLE_H
+
+// Lomont Button system
+// finite state machines compiled to flat tables, const in ROM, no heap
+// Requires C++ 17
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ButtonHelp.h"
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM {
+
+    // heap backed table, output of CompileFSM
+    struct FSMTableStorage
+    {
+        int counters{ 0 };
+        std::vector<uint16_t> stateArrows;
+        std::vector<PackedArrow> arrows;
+        std::vector<PackedAction> actions;
+
+        // view for TableFSM, valid while this lives
+        FSMTable Table() const
+        {
+            return FSMTable{
+                static_cast<uint8_t>(stateArrows.size() - 1),
+                static_cast<uint8_t>(counters),
+                stateArrows.data(), arrows.data(), actions.data() };
+        }
+
+        // bytes used by the table arrays
+        size_t Bytes() const
+        {
+            return sizeof(FSMTable) +
+                stateArrows.size() * sizeof(uint16_t) +
+                arrows.size() * sizeof(PackedArrow) +
+                actions.size() * sizeof(PackedAction);
+        }
+    };
+
+    // several tables sharing one arrow array and one action pool, output
+    // of CompileFSMSet. Table i has stateArrows [firstState[i], firstState[i+1])
+    struct FSMTableSetStorage
+    {
+        std::vector<int> counters;   // per table
+        std::vector<int> firstState; // count + 1 offsets into stateArrows
+        std::vector<uint16_t> stateArrows;
+        std::vector<PackedArrow> arrows;
+        std::vector<PackedAction> actions;
+
+        int Count() const { return static_cast<int>(counters.size()); }
+
+        // view of table i for ButtonFSM or TableFSM, valid while this lives
+        FSMTable Table(int i) const
+        {
+            return FSMTable{
+                static_cast<uint8_t>(firstState[i + 1] - firstState[i] - 1),
+                static_cast<uint8_t>(counters[i]),
+                stateArrows.data() + firstState[i], arrows.data(), actions.data() };
+        }
+
+        // bytes used by the table arrays and Count() FSMTables
+        size_t Bytes() const
+        {
+            return Count() * sizeof(FSMTable) +
+                stateArrows.size() * sizeof(uint16_t) +
+                arrows.size() * sizeof(PackedArrow) +
+                actions.size() * sizeof(PackedAction);
+        }
+    };
+
+    // compile an FSMDef to a flat table
+    // arrows with the same action list share it
+    // prints error and returns false if it does not fit the packed sizes
+    bool CompileFSM(const FSMDef& def, FSMTableStorage& table);
+
+    // compile FSMDefs to tables sharing one action pool, each action list
+    // stored once across all of them
+    bool CompileFSMSet(const std::vector<const FSMDef*>& defs, FSMTableSetStorage& set);
+
+    // write C++ source for constexpr arrays and an FSMTable named name
+    // paste or #include the output into firmware to keep the FSM in ROM
+    void EmitFSMTable(const FSMTableStorage& table, const char* name, FILE* file);
+
+    // as above for a set, the shared arrays are named poolName_...
+    // and table i is names[i]
+    void EmitFSMTableSet(const FSMTableSetStorage& set, const char* poolName, const std::vector<const char*>& names, FILE* file);
+
+    // RAM bytes of an FSMDef with all its vectors, for size reports
+    size_t DefBytes(const FSMDef& def);
+
+    // runs a compiled FSM, same behavior as ButtonFSM
+    // no heap, counters live inline
+    template<int MaxCounters = 4>
+    class TableFSM
+    {
+    public:
+        TableFSM() = default;
+
+        explicit TableFSM(const FSMTable* table)
+        {
+            if (table && MaxCounters < table->counterCount)
+            {
+                printf("ERROR - FSM table needs %d counters, TableFSM holds %d\n", table->counterCount, MaxCounters);
+                return;
+            }
+            table_ = table;
+        }
+
+        // read counter j, set to 0
+        int Read0(int j = 0)
+        {
+            if (!table_ || j < 0 || table_->counterCount <= j) return 0;
+            const auto v = counters_[j];
+            counters_[j] = 0;
+            return v;
+        }
+
+        // call this often to monitor state
+        void Update(int buttonId, bool buttonDown, uint64_t timeInStateMs)
+        {
+            Update(buttonId, buttonDown, timeInStateMs, ButtonHW::NowMs());
+        }
+
+        // as above, with the current time
+        void Update(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+        {
+            if (!table_) return; // null, no items
+            const auto stateDt = nowMs - stateTimeChangedMs_;
+            const auto end = table_->stateArrows[stateIndex_ + 1];
+            for (auto a = table_->stateArrows[stateIndex_]; a < end; ++a)
+            {
+                const PackedArrow& arrow = table_->arrows[a];
+                if (!arrow.Matches(buttonId, buttonDown, timeInStateMs, stateDt))
+                    continue;
+                const PackedAction* action = table_->actions + arrow.firstAction;
+                for (auto i = 0; i < arrow.actionCount; ++i, ++action)
+                    action->DoAction(counters_);
+                stateIndex_ = arrow.destState;
+                stateTimeChangedMs_ = nowMs;
+                break; // done, we have a match
+            }
+        }
+
+        int StateIndex() const { return stateIndex_; }
+
+    private:
+        const FSMTable* table_{ nullptr };
+        int stateIndex_{ 0 };
+        // counters used in FSM
+        int counters_[MaxCounters]{};
+        // last time state changed
+        uint64_t stateTimeChangedMs_{ 0 };
+    };
+
+}}}
+
+#endif //  BUTTON_FSM_TABLE_H
@@ -3,6 +3,13 @@
 // Helper stuff for Button.h
 
 #include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "StateTrace.h"
+#include "ButtonStats.h"
 
 namespace Lomont {
 	namespace ButtonHelpers
@@ -10,28 +17,90 @@ namespace Lomont {
 
         // global timing of button items
         // Set before creating any buttons
+        // these are the timings of ButtonSystem::Default(), other systems
+        // have their own SystemTimings
         namespace ButtonTimings
         {
             // this can be set globally, preferably before any debouncers started
             // Should divide debouncerInterruptMs
             // default to 5 ms
-            extern uint8_t debounceMs;
+            extern uint8_t& debounceMs;
             // you can set the interrupt rate before creating any buttons
             // default 1ms rate
-            extern uint8_t debouncerInterruptMs;
+            extern uint8_t& debouncerInterruptMs;
 
             // global timing settings - change before making any buttons
-            extern int clickUpLowMs; // click up time ms, low range
-            extern int clickUpHighMs; // click up time ms, high range
+            extern int& clickUpLowMs; // click up time ms, low range
+            extern int& clickUpHighMs; // click up time ms, high range
 
-            extern int clickDownLowMs; // click down time ms, low range
-            extern int clickDownHighMs; // click down time ms, high range
+            extern int& clickDownLowMs; // click down time ms, low range
+            extern int& clickDownHighMs; // click down time ms, high range
 
-            extern int repeatClickDelayMs; // repeat click start time, low end
+            extern int& repeatClickDelayMs; // repeat click start time, low end
 
-            extern int mediumPressMs; // medium hold
-            extern int longPressMs; // long hold
+            extern int& mediumPressMs; // medium hold
+            extern int& longPressMs; // long hold
 
+            // adaptive sampling, used when ButtonHW::SetSamplePeriodMs is set
+            extern int& idleAfterMs; // all debouncers settled this long goes idle
+            extern int& idleSampleMs; // idle sample period if no edge wakeup
+
+        };
+
+        // the pattern timings above as values, to build patterns with other
+        // timings than the globals, see Button::MakeDefaultPatterns
+        struct PatternTimings
+        {
+            int clickUpLowMs;
+            int clickUpHighMs;
+            int clickDownLowMs;
+            int clickDownHighMs;
+            int repeatClickDelayMs;
+            int mediumPressMs;
+            int longPressMs;
+
+            // the globals now
+            static PatternTimings Current()
+            {
+                namespace T = ButtonTimings;
+                return PatternTimings{ T::clickUpLowMs, T::clickUpHighMs, T::clickDownLowMs, T::clickDownHighMs,
+                    T::repeatClickDelayMs, T::mediumPressMs, T::longPressMs };
+            }
+        };
+
+        // every ButtonTimings value, one set per ButtonSystem
+        // these based on some empirical work
+        // median up/down times 150ms, gaussian, std dev 120ms
+        // so 1.5 std dev gives range of [60,240]
+        // shorten a little for faster clickers
+        struct SystemTimings
+        {
+            uint8_t debounceMs{ 5 };
+            uint8_t debouncerInterruptMs{ 1 }; // 1 ms default
+
+            int clickUpLowMs{ 40 }; // wait to start looking for down
+            int clickUpHighMs{ 210 };
+            int clickDownLowMs{ 40 }; // length for min down click
+            int clickDownHighMs{ 210 }; // max down click
+
+            int repeatClickDelayMs{ 300 }; // repeat
+            int mediumPressMs{ 600 }; // medium hold
+            int longPressMs{ 2500 }; // long hold
+
+            int idleAfterMs{ 100 }; // settled time before sampling goes idle
+            int idleSampleMs{ 20 }; // idle sample period without edge wakeup
+
+            PatternTimings Patterns() const
+            {
+                return PatternTimings{ clickUpLowMs, clickUpHighMs, clickDownLowMs, clickDownHighMs,
+                    repeatClickDelayMs, mediumPressMs, longPressMs };
+            }
+
+            // integrator length of a DebouncerBank
+            int DebounceSamples() const
+            {
+                return debouncerInterruptMs ? debounceMs / debouncerInterruptMs : debounceMs;
+            }
         };
 
         // support stuff button system
@@ -44,7 +113,7 @@ namespace Lomont {
             // Start/Stop the button interrupt
             // interrupt should
             // 1 - get elapsed time in ms from Button::ElapsedMs
-            // 2 - for each button in system (via buttonPtrs),
+            // 2 - for each button in system (via Button::buttonPtrs.Read()),
             //     1 - read pin, process whether pins high or low means button down
             //     2 - call base class Debouncer DebounceInput with isDown and elapsedMs
             void StartDebouncerInterrupt();
@@ -52,6 +121,76 @@ namespace Lomont {
 
             // prepare hardware as needed for a new pin to watch
             void SetPinHardware(int gpioPinNumber, bool downIsHigh);
+
+            // optional batched pin read, for platforms that can read a whole GPIO port at once
+            // return raw levels (1 = high) of the pins in portMask on the given port,
+            // bit i is gpio 32 * port + i. Leave nullptr (default) if not supported.
+            // When set, the interrupt can call Button::SamplePorts to sample all buttons
+            // with one read per port.
+            extern uint32_t (*&ReadPins)(int port, uint32_t portMask);
+
+            // optional adaptive sampling, leave nullptr (default) to sample
+            // at debouncerInterruptMs forever.
+            // Change the sampling interrupt period, 0 stops it. Called from
+            // the interrupt, and from Button::SamplerWake.
+            extern void (*&SetSamplePeriodMs)(uint32_t periodMs);
+            // Arm (true) or disarm (false) a wakeup on any button pin change,
+            // which must call Button::SamplerWake. Return false if not possible.
+            // When set, the interrupt stops while idle instead of slowing.
+            extern bool (*&ArmEdgeWakeup)(bool arm);
+
+            // optional clock for simulation and tests, leave nullptr (default)
+            // to use ElapsedMs. When set the button system reads time only
+            // through NowMs, so a simulated timeline can drive it
+            extern uint64_t (*&ClockMs)();
+
+            // current time, ClockMs if set, else ElapsedMs
+            inline uint64_t NowMs() { return ClockMs ? ClockMs() : ElapsedMs(); }
+
+            // the optional hooks above are those of ButtonSystem::Default()
+        };
+
+        class TraceRecorder;
+
+        // optional hooks of one ButtonSystem, all nullptr by default
+        // the default system's are the ButtonHW and Button globals of the
+        // same names, see those for what each does
+        struct SystemHooks
+        {
+            uint32_t (*readPins)(int port, uint32_t portMask){ nullptr };
+            void (*setSamplePeriodMs)(uint32_t periodMs){ nullptr };
+            bool (*armEdgeWakeup)(bool arm){ nullptr };
+            uint64_t (*clockMs)(){ nullptr };
+            void (*edgeWake)(){ nullptr };
+            TraceRecorder* trace{ nullptr };
+
+            // systems other than the default, which uses the ButtonHW
+            // functions: set up a pin, start and stop calling SamplePorts
+            // while buttons exist. Leave nullptr to do these yourself.
+            void (*setPinHardware)(int gpio, bool downIsHigh){ nullptr };
+            void (*startSampling)(){ nullptr };
+            void (*stopSampling)(){ nullptr };
+
+#if BUTTON_STATS
+            // free running ns clock, may wrap, for the BUTTON_STATS pass
+            // timings. On a microcontroller scale a cycle counter.
+            uint32_t (*nowNs)(){ nullptr };
+#endif
+        };
+
+        // one time sample for an update pass
+        // take one, then hand it to every IsDown and pattern update in the
+        // pass, so the clock is read once and all FSMs see the same now
+        struct TickContext
+        {
+            TickContext() : nowMs(ButtonHW::NowMs()) {}
+            explicit TickContext(uint64_t timeMs) : nowMs(timeMs) {}
+
+            // ms from changedMs to this tick, 0 for a change the sampler
+            // published after the tick was taken
+            uint64_t AgeMs(uint64_t changedMs) const { return nowMs > changedMs ? nowMs - changedMs : 0; }
+
+            uint64_t nowMs;
         };
 
 
@@ -60,6 +199,9 @@ namespace Lomont {
         // all FSM stuff
         namespace FSM
         {
+            // no pending time based transition
+            constexpr uint64_t NoDeadlineMs = ~0ULL;
+
             // An action to perform on an arrow match       
             struct Action
             {
@@ -74,14 +216,17 @@ namespace Lomont {
                 // 4 = set counter q to value in p
                 int action{ 0 };
 
-                // apply action to counters and timer offset
-                void DoAction(std::vector<int>& counters) const
+                // apply action to counters, any int array or vector
+                // returns false, changing nothing, for an invalid action
+                template<typename Counters>
+                bool DoAction(Counters& counters) const
                 {
                     if (action == 1) counters[q] += p;
                     else if (action == 2) counters[q] -= p;
                     else if (action == 3) counters[q] = counters[p];
                     else if (action == 4) counters[q] = p;
-                    else { printf("ERROR - invalid button action"); }
+                    else return false;
+                    return true;
                 }
 
             };
@@ -244,96 +389,429 @@ namespace Lomont {
                     auto& s = states_.back();
                     auto& a = s.arrows_.back();
                     a.actions_.push_back(Action{ p,q,action });
+                    CheckAction(a.actions_.back());
                 }
 
                 // allows building states in nicer formatted hierarchies
                 void Build(std::initializer_list<State> states)
                 {
                     for (auto& s : states)
+                    {
                         states_.push_back(s);
+                        for (auto& a : s.arrows_)
+                            for (auto& action : a.actions_)
+                                CheckAction(action);
+                    }
+                }
+
+                // invalid actions are reported here, Update skips them
+                static void CheckAction(const Action& action)
+                {
+                    if (action.action < 1 || 4 < action.action)
+                        printf("ERROR - invalid button action %d\n", action.action);
                 }
             };
 
+            // arrows of each FSMDef state grouped by the button they can match
+            // Arrows(s, id) lists, in arrow order, the arrows of state s naming
+            // button id or any button, so an update for one button skips the rest
+            class ArrowIndex
+            {
+            public:
+                explicit ArrowIndex(const FSMDef& def)
+                {
+                    for (auto& state : def.states_)
+                    {
+                        auto& index = states_.emplace_back();
+                        const auto& arrows = state.arrows_;
+                        for (auto i = 0U; i < arrows.size(); ++i)
+                        {
+                            const int id = arrows[i].buttonId_;
+                            if (id == 0)
+                                index.wildcard.push_back(static_cast<uint16_t>(i));
+                            else if (std::find(index.ids.begin(), index.ids.end(), id) == index.ids.end())
+                                index.ids.push_back(id);
+                        }
+                        // each named button gets its own arrows merged with the wildcards
+                        for (auto id : index.ids)
+                        {
+                            auto& list = index.byId.emplace_back();
+                            for (auto i = 0U; i < arrows.size(); ++i)
+                                if (arrows[i].buttonId_ == id || arrows[i].buttonId_ == 0)
+                                    list.push_back(static_cast<uint16_t>(i));
+                        }
+                    }
+                }
+
+                // arrows in state that can match buttonId, in arrow order
+                const std::vector<uint16_t>& Arrows(int state, int buttonId) const
+                {
+                    const auto& index = states_[state];
+                    for (auto i = 0U; i < index.ids.size(); ++i)
+                        if (index.ids[i] == buttonId)
+                            return index.byId[i];
+                    return index.wildcard;
+                }
+
+                // buttons named by arrows in state
+                const std::vector<int>& ButtonIds(int state) const { return states_[state].ids; }
+
+                // true if state has an arrow for any button
+                bool HasWildcard(int state) const { return !states_[state].wildcard.empty(); }
+
+            private:
+                struct StateIndex
+                {
+                    std::vector<int> ids;                     // named buttons
+                    std::vector<std::vector<uint16_t>> byId;  // arrows for ids[i]
+                    std::vector<uint16_t> wildcard;           // arrows for any other button
+                };
+                std::vector<StateIndex> states_;
+            };
+
+            // Action packed into 4 bytes, same meaning as Action
+            struct PackedAction
+            {
+                uint8_t action; // 1 add, 2 sub, 3 copy, 4 set
+                uint8_t q;      // counter
+                int16_t p;      // value or source counter
+
+                // apply to counters, any int array or vector
+                template<typename Counters>
+                void DoAction(Counters& counters) const
+                {
+                    switch (action)
+                    {
+                    case 1: counters[q] += p; break;
+                    case 2: counters[q] -= p; break;
+                    case 3: counters[q] = counters[p]; break;
+                    case 4: counters[q] = p; break;
+                    default: break; // rejected by CompileFSM
+                    }
+                }
+            };
+
+            // Arrow packed into 8 bytes, same meaning as Arrow
+            struct PackedArrow
+            {
+                uint8_t destState;
+                uint8_t buttonId;     // 0 for any
+                uint8_t match;        // bits 0-1 buttonAction, bits 2-3 timeAction
+                uint8_t actionCount;
+                uint16_t timeBoundMs;
+                uint16_t firstAction; // index into actions
+
+                constexpr int ButtonAction() const { return match & 3; }
+                constexpr int TimeAction() const { return (match >> 2) & 3; }
+
+                // same test as Arrow::Matches
+                constexpr bool Matches(int id, bool buttonDown, uint64_t timeInButtonState, uint64_t stateTimeMs) const
+                {
+                    if (buttonId != 0 && buttonId != id)
+                        return false;
+                    const int ba = ButtonAction();
+                    if (ba != 0 && ba != (buttonDown ? 2 : 1))
+                        return false;
+                    switch (TimeAction())
+                    {
+                    case 1: return static_cast<int>(timeInButtonState) <= timeBoundMs;
+                    case 2: return static_cast<int>(timeInButtonState) >= timeBoundMs;
+                    case 3: return static_cast<int>(stateTimeMs) >= timeBoundMs;
+                    default: return true;
+                    }
+                }
+            };
+
+            // a compiled FSMDef
+            // state s has arrows [stateArrows[s], stateArrows[s+1])
+            // all arrays may be constexpr, see EmitFSMTable in ButtonFSMTable.h
+            struct FSMTable
+            {
+                uint8_t stateCount;
+                uint8_t counterCount;
+                const uint16_t* stateArrows;  // stateCount + 1 offsets into arrows
+                const PackedArrow* arrows;
+                const PackedAction* actions;
+            };
+
             // holds a finite state machine
+            // runs an FSMDef, or a packed FSMTable (from CompileFSM or ROM)
             class ButtonFSM
             {
 
             public:
 
+                // counters held in the FSM itself, more go on the heap
+                static constexpr int InlineCounters = 2;
+
                 ButtonFSM(const FSMDef* fsm)
                 {
-                    fsm_ = fsm;
-                    const auto c = fsm->counters_;
-                    counters_.resize(c);
-                    // zero values
-                    for (auto i = 0; i < c; ++i)
-                        counters_[i] = 0;
+                    def_ = reinterpret_cast<uintptr_t>(fsm);
+                    SetCounterCount(fsm->counters_);
+                }
+
+                // table must outlive this
+                ButtonFSM(const FSMTable* table)
+                {
+                    def_ = reinterpret_cast<uintptr_t>(table) | TableTag;
+                    SetCounterCount(table->counterCount);
+                }
+
+                ButtonFSM(const ButtonFSM& other) { *this = other; }
+                ButtonFSM(ButtonFSM&& other) noexcept { *this = std::move(other); }
+                ButtonFSM& operator=(ButtonFSM&& other) noexcept
+                {
+                    if (this == &other) return *this;
+                    stateIndex_ = other.stateIndex_;
+                    def_ = other.def_;
+                    stateTimeChangedMs_ = other.stateTimeChangedMs_;
+                    trace = other.trace;
+                    traceId = other.traceId;
+                    more_ = std::move(other.more_);
+                    std::copy_n(other.inline_, InlineCounters, inline_);
+                    counterCount_ = other.counterCount_;
+                    other.counterCount_ = 0; // left with no counters
+                    return *this;
+                }
+                ButtonFSM& operator=(const ButtonFSM& other)
+                {
+                    if (this == &other) return *this;
+                    stateIndex_ = other.stateIndex_;
+                    def_ = other.def_;
+                    stateTimeChangedMs_ = other.stateTimeChangedMs_;
+                    trace = other.trace;
+                    traceId = other.traceId;
+                    SetCounterCount(other.counterCount_);
+                    std::copy_n(other.Counters(), counterCount_, Counters());
+                    return *this;
                 }
 
                 // read counter j, set to 0
                 int Read0(int j = 0)
                 {
-                    if (j < 0 || static_cast<int>(counters_.size()) <= j) return 0;
-                    const auto v = counters_[j];
-                    counters_[j] = 0;
+                    if (j < 0 || counterCount_ <= j) return 0;
+                    auto& c = Counters()[j];
+                    const auto v = c;
+                    c = 0;
                     return v;
                 }
 
+                // read counter j, leave it
+                int Peek(int j = 0) const
+                {
+                    if (j < 0 || counterCount_ <= j) return 0;
+                    return Counters()[j];
+                }
+
+                // counters on the heap, 0 when they fit in the FSM
+                size_t HeapBytes() const
+                {
+                    return more_ ? counterCount_ * sizeof(int) : 0;
+                }
+
                 // call this often to monitor state
                 void Update(int buttonId, bool buttonDown, uint64_t timeInStateMs)
                 {
-                    if (!fsm_) return; // null, no items
-                    //printf("Check state %d %d %d\n",buttonId,buttonDown,(int)timeInStateMs);
-                    const auto& state = fsm_->states_[stateIndex_];
-                    const auto stateDt = ButtonHW::ElapsedMs() - stateTimeChangedMs_;
+                    Update(buttonId, buttonDown, timeInStateMs, ButtonHW::NowMs());
+                }
+
+                // as above, evaluated at time nowMs
+                // returns true if an arrow was taken
+                bool Update(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+                {
+                    if (def_ & TableTag) return UpdateTable(buttonId, buttonDown, timeInStateMs, nowMs);
+                    const FSMDef* fsm = Def();
+                    if (!fsm) return false; // null, no items
+                    const auto& state = fsm->states_[stateIndex_];
+                    const auto stateDt = nowMs - stateTimeChangedMs_;
                     for (auto arrowIndex = 0U; arrowIndex < state.arrows_.size(); ++arrowIndex)
                     {
                         const Arrow& arrow = state.arrows_[arrowIndex];
                         if (arrow.Matches(buttonId, buttonDown, timeInStateMs, stateDt))
+                            return Take(arrow, arrowIndex, buttonId, nowMs); // done, we have a match
+                    }
+                    return false;
+                }
+
+                // as above, checking only the arrows index gives for buttonId
+                // index must be built from this FSM's FSMDef
+                // tables are not indexed, they test all arrows
+                bool Update(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs, const ArrowIndex& index)
+                {
+                    if (def_ & TableTag) return UpdateTable(buttonId, buttonDown, timeInStateMs, nowMs);
+                    const FSMDef* fsm = Def();
+                    if (!fsm) return false; // null, no items
+                    const auto& state = fsm->states_[stateIndex_];
+                    const auto stateDt = nowMs - stateTimeChangedMs_;
+                    for (auto arrowIndex : index.Arrows(stateIndex_, buttonId))
+                    {
+                        const Arrow& arrow = state.arrows_[arrowIndex];
+                        if (arrow.Matches(buttonId, buttonDown, timeInStateMs, stateDt))
+                            return Take(arrow, arrowIndex, buttonId, nowMs);
+                    }
+                    return false;
+                }
+
+                int StateIndex() const { return stateIndex_; }
+                // nullptr when running a table
+                const FSMDef* Def() const
+                {
+                    return (def_ & TableTag) ? nullptr : reinterpret_cast<const FSMDef*>(def_);
+                }
+                const FSMTable* Table() const
+                {
+                    return (def_ & TableTag) ? reinterpret_cast<const FSMTable*>(def_ & ~TableTag) : nullptr;
+                }
+
+                // earliest time at or after fromMs that Update can take an arrow,
+                // assuming the button stays as it is (down, changed at buttonChangedMs)
+                // NoDeadlineMs if only a button change can move this FSM
+                uint64_t NextDeadlineMs(int buttonId, bool buttonDown, uint64_t buttonChangedMs, uint64_t fromMs) const
+                {
+                    uint64_t deadline = NoDeadlineMs;
+                    if (const FSMTable* table = Table())
+                    {
+                        const auto end = table->stateArrows[stateIndex_ + 1];
+                        for (auto a = table->stateArrows[stateIndex_]; a < end; ++a)
                         {
-                            for (auto& action : arrow.actions_)
-                            {
-                                action.DoAction(counters_);
-                            }
-
-                            // useful debugging statement
-                            if (dumpStateChangesToConsole)
-                            {
-                                static int cnt = 1;
-                                printf("State change #%d: button:%d, states %d->%d via arrow %d, time %llu, actions %zu\n",
-                                    cnt++,
-                                    buttonId,
-                                    stateIndex_, arrow.destState,
-                                    arrowIndex,
-                                    timeInStateMs,
-                                    arrow.actions_.size()
-                                );
-                            }
-                            // go to dest
-                            stateIndex_ = arrow.destState;
-                            if (stateIndex_ < 0 || static_cast<int>(fsm_->states_.size()) <= stateIndex_)
-                                stateIndex_ = 0; // reset, todo - log error?
-
-                            stateTimeChangedMs_ = ButtonHW::ElapsedMs();
-
-                            break; // done, we have a match
+                            const PackedArrow& arrow = table->arrows[a];
+                            if (arrow.buttonId != 0 && arrow.buttonId != buttonId)
+                                continue;
+                            NextDeadline(arrow.ButtonAction(), arrow.TimeAction(), arrow.timeBoundMs,
+                                buttonDown, buttonChangedMs, fromMs, deadline);
                         }
+                        return deadline;
                     }
+                    const FSMDef* fsm = Def();
+                    if (!fsm) return NoDeadlineMs;
+                    for (auto& arrow : fsm->states_[stateIndex_].arrows_)
+                    {
+                        if (arrow.buttonId_ != 0 && arrow.buttonId_ != buttonId)
+                            continue;
+                        NextDeadline(arrow.buttonAction, arrow.timeAction, arrow.timeBoundMs,
+                            buttonDown, buttonChangedMs, fromMs, deadline);
+                    }
+                    return deadline;
                 }
 
 
-                // set to true to get printf of state changes
-                // useful for debugging 
-                bool dumpStateChangesToConsole{ false };
+                // optional state change trace, one record per arrow taken,
+                // format it later with FormatStateTrace, see StateTrace.h.
+                // Cheap enough to leave on. Patterns updated from one thread
+                // can share a ring.
+                StateTraceRing* trace{ nullptr };
+                uint8_t traceId{ 0 }; // pattern number in the records
 
             private:
+                // lower deadline to the first time at or after fromMs an arrow can match
+                void NextDeadline(int buttonAction, int timeAction, int timeBoundMs,
+                    bool buttonDown, uint64_t buttonChangedMs, uint64_t fromMs, uint64_t& deadline) const
+                {
+                    if (buttonAction != 0 && buttonAction != (buttonDown ? 2 : 1))
+                        return;
+                    uint64_t t = fromMs; // untimed, matches now
+                    if (timeAction == 1)
+                    { // only true early in button state
+                        if (static_cast<int>(fromMs - buttonChangedMs) > timeBoundMs)
+                            return;
+                    }
+                    else if (timeAction == 2)
+                        t = buttonChangedMs + timeBoundMs;
+                    else if (timeAction == 3)
+                        t = stateTimeChangedMs_ + timeBoundMs;
+                    if (t < fromMs) t = fromMs;
+                    if (t < deadline) deadline = t;
+                }
+
+                // Update on a packed table
+                bool UpdateTable(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+                {
+                    const FSMTable* table = Table();
+                    const auto stateDt = nowMs - stateTimeChangedMs_;
+                    const auto end = table->stateArrows[stateIndex_ + 1];
+                    int* counters = Counters();
+                    for (auto a = table->stateArrows[stateIndex_]; a < end; ++a)
+                    {
+                        const PackedArrow& arrow = table->arrows[a];
+                        if (!arrow.Matches(buttonId, buttonDown, timeInStateMs, stateDt))
+                            continue;
+                        const PackedAction* action = table->actions + arrow.firstAction;
+                        for (auto i = 0; i < arrow.actionCount; ++i, ++action)
+                            action->DoAction(counters);
+                        if (trace)
+                            Record(nowMs, buttonId, arrow.destState, a - table->stateArrows[stateIndex_],
+                                arrow.actionCount, StateTraceRecord::Table);
+                        stateIndex_ = arrow.destState;
+                        stateTimeChangedMs_ = nowMs;
+                        return true;
+                    }
+                    return false;
+                }
+
+                // do arrow actions and move to its state
+                bool Take(const Arrow& arrow, int arrowIndex, int buttonId, uint64_t nowMs)
+                {
+                    uint8_t flags = 0;
+                    int* counters = Counters();
+                    for (auto& action : arrow.actions_)
+                    {
+                        if (!action.DoAction(counters))
+                            flags |= StateTraceRecord::InvalidAction;
+                    }
+
+                    // go to dest
+                    int dest = arrow.destState;
+                    if (dest < 0 || static_cast<int>(Def()->states_.size()) <= dest)
+                    {
+                        dest = 0; // reset
+                        flags |= StateTraceRecord::StateReset;
+                    }
+                    if (trace)
+                        Record(nowMs, buttonId, dest, arrowIndex, static_cast<int>(arrow.actions_.size()), flags);
+                    stateIndex_ = dest;
+
+                    stateTimeChangedMs_ = nowMs;
+                    return true;
+                }
+
+                // one trace record, leaving stateIndex_
+                void Record(uint64_t nowMs, int buttonId, int dest, int arrowIndex, int actions, uint8_t flags)
+                {
+                    StateTraceRecord r;
+                    r.timeMs = static_cast<uint32_t>(nowMs);
+                    r.buttonId = static_cast<uint8_t>(buttonId);
+                    r.pattern = traceId;
+                    r.fromState = static_cast<uint8_t>(stateIndex_);
+                    r.toState = static_cast<uint8_t>(dest);
+                    r.arrow = static_cast<uint8_t>(arrowIndex);
+                    r.actions = static_cast<uint8_t>(actions);
+                    r.flags = flags;
+                    trace->Write(r);
+                }
+
+                // zeroed counters, inline when they fit
+                void SetCounterCount(int count)
+                {
+                    counterCount_ = static_cast<uint16_t>(count);
+                    more_.reset(count > InlineCounters ? new int[count] : nullptr);
+                    std::fill_n(Counters(), count, 0);
+                }
+                int* Counters() { return more_ ? more_.get() : inline_; }
+                const int* Counters() const { return more_ ? more_.get() : inline_; }
+
+                // these two fill the padding after traceId
+                uint16_t counterCount_{ 0 };
                 // current state
                 int stateIndex_{ 0 };
-                const FSMDef* fsm_{ nullptr };
-                // counters used in FSM
-                std::vector<int> counters_;
+                // FSMDef or FSMTable pointer, tagged in bit 0 for a table,
+                // both hold pointers so bit 0 is free
+                static constexpr uintptr_t TableTag = 1;
+                uintptr_t def_{ 0 };
                 // last time state changed
                 uint64_t stateTimeChangedMs_{ 0 };
+                // counters used in FSM
+                std::unique_ptr<int[]> more_;
+                int inline_[InlineCounters]{};
             };
 
 	        
@@ -341,53 +819,9 @@ namespace Lomont {
 		
 	}
 
-    // a button debouncer
-    // gives current debounced state IsDown
-    // gives elapsed US in current state
-    // gives time in last state
-    class Debouncer
+    namespace ButtonHelpers
     {
-
-    public:
-
-        // called from interrupt
-        // give button down state, and elapsed milliseconds in the system
-        void DebounceInput(bool buttonDown, uint64_t elapsedMs)
-        {
-            using namespace ButtonHelpers::ButtonTimings;
-
-            const bool localDown = IsDown(); // read once for routine
-            if (buttonDown && integrator_ + debouncerInterruptMs <= debounceMs)
-            {
-                integrator_ = static_cast<int8_t>(integrator_ + debouncerInterruptMs);
-                if (integrator_ >= debounceMs && buttonDown != localDown)
-                    state_.SetAtomically(buttonDown, elapsedMs);
-            }
-            else if (!buttonDown && integrator_ - debouncerInterruptMs >= 0)
-            {
-                integrator_ = static_cast<int8_t>(integrator_ - debouncerInterruptMs);
-                if (integrator_ <= 0 && buttonDown != localDown)
-                    state_.SetAtomically(buttonDown, elapsedMs);
-            }
-        }
-
-
-        // is debounced button down?
-        // optionally gets time this state was changed
-        bool IsDown(uint64_t* stateChangeTimeMs = nullptr) const
-        {
-
-            bool isDown;
-            uint64_t time;
-            state_.GetAtomically(&isDown,&time);
-            if (stateChangeTimeMs)
-                *stateChangeTimeMs = time;
-            return isDown;
-        }
-    private:
-
         // helper class - replace if needed on your platform
-
         // hold an atomic update state for the 
         // bool buttonDown flag and the 
         // uint64_t time button changed
@@ -405,27 +839,37 @@ namespace Lomont {
                 atomicState_ = PackState(buttonDown, elapsedMs); // atomic set
             }
 
+            // just the button state, no time
+            bool Down() const
+            {
+                return (atomicState_ & 1) == 1;
+            }
+
             // get state atomically
+            // reads the clock only when the state has changed since the last get
+            // ButtonHW::NowMs is the default system's clock, pass a tick otherwise
             void GetAtomically(bool* buttonDown, uint64_t* changedTimeMs) const
+            {
+                GetAtomicallyAt(buttonDown, changedTimeMs, [] { return ButtonHelpers::ButtonHW::NowMs(); });
+            }
+
+            // as above, nowMs() gives the current time, called only on a change
+            template<typename NowMs>
+            void GetAtomicallyAt(bool* buttonDown, uint64_t* changedTimeMs, NowMs&& nowMs) const
             {
                 uint32_t state = atomicState_; // read it
                 if (state != PackState(buttonDown_, changeTimeMs_))
-                { // update internals....
-                    const uint64_t bit32 = (1ULL << 32); // bit 32 set bits mask
-                    const uint64_t mask = bit32 - 1; // low 31 bits mask
-
-                    const uint64_t curTime = ButtonHelpers::ButtonHW::ElapsedMs();      // current time
-                    const uint64_t hiCurTime = curTime & (~mask);          // zero out low 31 bits
-                    const uint32_t loCurTime = (uint32_t)(curTime & mask); // low 31 bits
-                    const uint32_t stateTime = (state >> 1);
-
-                    // if there was wraparound (cur time < stored time), then subtract one from top 33 bits
-                    // This requires calling every at most 2^31 ms = ~24 days.
-                    const uint64_t hiCorrectTime = hiCurTime - (loCurTime < stateTime ? bit32 : 0);
+                    Unpack(state, nowMs());
+                *buttonDown = buttonDown_;
+                *changedTimeMs = changeTimeMs_;
+            }
 
-                    buttonDown_ = (state & 1) == 1;
-                    changeTimeMs_ = hiCorrectTime | stateTime; // high bits and low bits 
-                }
+            // as above, tick gives the current time, no clock read
+            void GetAtomically(bool* buttonDown, uint64_t* changedTimeMs, const TickContext& tick) const
+            {
+                uint32_t state = atomicState_; // read it
+                if (state != PackState(buttonDown_, changeTimeMs_))
+                    Unpack(state, tick.nowMs);
                 *buttonDown = buttonDown_;
                 *changedTimeMs = changeTimeMs_;
             }
@@ -441,7 +885,31 @@ namespace Lomont {
             //  - put up/down bit in low bit, top 31 bits are low part of time
             //  - fill in rest of time carefully when outer level code requests
 
-            std::atomic<uint32_t> atomicState_;
+            std::atomic<uint32_t> atomicState_{ 0 };
+
+            // update internals from a packed state and the current time
+            void Unpack(uint32_t state, uint64_t curTime) const
+            {
+                const uint64_t span = 1ULL << 31;  // packed time wraps here
+                const uint32_t mask = static_cast<uint32_t>(span - 1); // low 31 bits mask
+                const uint32_t stateTime = state >> 1;
+
+                // age of the state in 31 bit arithmetic. A pass tick can be
+                // taken before the sampler publishes an edge, so a state a
+                // little ahead of curTime is newer, not 2^31 ms old.
+                // This requires calling at most every 2^31 - AheadMs ms = ~24 days.
+                const uint32_t age = (static_cast<uint32_t>(curTime) - stateTime) & mask;
+                const uint32_t ahead = (stateTime - static_cast<uint32_t>(curTime)) & mask;
+
+                buttonDown_ = (state & 1) == 1;
+                if (ahead != 0 && ahead <= AheadMs)
+                    changeTimeMs_ = curTime + ahead;
+                else
+                    changeTimeMs_ = curTime - age;
+            }
+
+            // most a state may be ahead of the time it is read at
+            static constexpr uint32_t AheadMs = 1U << 16;
 
             uint32_t PackState(bool buttonDown, uint64_t elapsedMs) const
             {
@@ -455,14 +923,119 @@ namespace Lomont {
             mutable bool buttonDown_{ false };
             mutable uint64_t changeTimeMs_{ 0 };
         };
+    }
 
+    // a button debouncer
+    // gives current debounced state IsDown
+    // gives elapsed US in current state
+    // gives time in last state
+    class Debouncer
+    {
+
+    public:
+
+        // called from interrupt
+        // give button down state, and elapsed milliseconds in the system
+        // returns true if the debounced state changed
+        bool DebounceInput(bool buttonDown, uint64_t elapsedMs)
+        {
+            using namespace ButtonHelpers::ButtonTimings;
+            return DebounceInput(buttonDown, elapsedMs, debounceMs, debouncerInterruptMs);
+        }
+
+        // as above with given timings, for buttons of other ButtonSystems
+        bool DebounceInput(bool buttonDown, uint64_t elapsedMs, int debounceMs, int debouncerInterruptMs)
+        {
+            const bool localDown = state_.Down(); // read once for routine, no clock
+            if (buttonDown && integrator_ + debouncerInterruptMs <= debounceMs)
+            {
+                integrator_ = static_cast<int8_t>(integrator_ + debouncerInterruptMs);
+                if (integrator_ >= debounceMs && buttonDown != localDown)
+                {
+                    state_.SetAtomically(buttonDown, elapsedMs);
+                    return true;
+                }
+            }
+            else if (!buttonDown && integrator_ - debouncerInterruptMs >= 0)
+            {
+                integrator_ = static_cast<int8_t>(integrator_ - debouncerInterruptMs);
+                if (integrator_ <= 0 && buttonDown != localDown)
+                {
+                    state_.SetAtomically(buttonDown, elapsedMs);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+        // called from interrupt when an external debouncer, such as
+        // DebouncerBank, owns the integrator for this button
+        // publishes the debounced state and the time it changed
+        void SetDebounced(bool buttonDown, uint64_t elapsedMs)
+        {
+            state_.SetAtomically(buttonDown, elapsedMs);
+        }
+
+        // true if the integrator is pinned at the debounced state,
+        // so the input has not moved since it last settled
+        bool Settled() const
+        {
+            using namespace ButtonHelpers::ButtonTimings;
+            return Settled(debounceMs, debouncerInterruptMs);
+        }
+
+        bool Settled(int debounceMs, int debouncerInterruptMs) const
+        {
+            if (state_.Down())
+                return integrator_ + debouncerInterruptMs > debounceMs;
+            return integrator_ - debouncerInterruptMs < 0;
+        }
+
+        // is debounced button down?
+        // optionally gets time this state was changed
+        bool IsDown(uint64_t* stateChangeTimeMs = nullptr) const
+        {
+
+            bool isDown;
+            uint64_t time;
+            state_.GetAtomically(&isDown,&time);
+            if (stateChangeTimeMs)
+                *stateChangeTimeMs = time;
+            return isDown;
+        }
+
+        // as above, reading the clock with nowMs() only if the state changed
+        template<typename NowMs>
+        bool IsDownAt(NowMs&& nowMs, uint64_t* stateChangeTimeMs = nullptr) const
+        {
+            bool isDown;
+            uint64_t time;
+            state_.GetAtomicallyAt(&isDown, &time, nowMs);
+            if (stateChangeTimeMs)
+                *stateChangeTimeMs = time;
+            return isDown;
+        }
+
+        // as above, using the pass time instead of reading the clock
+        bool IsDown(const ButtonHelpers::TickContext& tick, uint64_t* stateChangeTimeMs = nullptr) const
+        {
+
+            bool isDown;
+            uint64_t time;
+            state_.GetAtomically(&isDown,&time,tick);
+            if (stateChangeTimeMs)
+                *stateChangeTimeMs = time;
+            return isDown;
+        }
+    private:
 
         // 0          = button up
         // debounceMs = button down
         // tallies milliseconds in a state
         int8_t integrator_{ 0 };
 
-        AtomicState state_;
+        ButtonHelpers::AtomicState state_;
 
 
     }; // Debouncer 
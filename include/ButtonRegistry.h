@@ -0,0 +1,161 @@
+#pragma once
+#ifndef BUTTON_REGISTRY_H
+#define BUTTON_REGISTRY_H
+
+// Lomont Button system
+// registry of live buttons, read wait-free by the sampling interrupt
+// Requires C++ 17
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "DebouncerBank.h"
+
+namespace Lomont {
+
+    class Button;
+
+    namespace ButtonHelpers
+    {
+        // slot in the registry, generation catches stale handles
+        struct RegistryHandle
+        {
+            uint32_t slot{ 0 };
+            uint32_t generation{ 0 }; // 0 = not registered
+        };
+
+        // debouncer state for one 32 pin port
+        // owned by the sampler, lives as long as the registry
+        struct PortState
+        {
+            DebouncerBank<uint32_t> bank;
+            int owners[32]{};            // buttonId debounced on each lane, 0 for none
+            uint64_t layoutGeneration{ 0 }; // snapshot the owners match
+        };
+
+        // a later button on a pin that already has one, given its edges
+        struct SharedLane
+        {
+            int lane{ 0 };
+            Button* button{ nullptr };
+            bool flip{ false }; // polarity differs from the lane's button
+        };
+
+        // buttons on one 32 pin port, sampled with one ReadPins call
+        struct PortLayout
+        {
+            int port{ 0 };
+            uint32_t mask{ 0 };      // pins in use
+            uint32_t downIsLow{ 0 }; // pins where low voltage is down
+            Button* lanes[32]{};     // button on each pin
+            uint32_t sharedMask{ 0 }; // lanes with more buttons in shared
+            std::vector<SharedLane> shared;
+            PortState* state{ nullptr };
+        };
+
+        // immutable list of buttons, replaced whole on add/remove
+        struct RegistrySnapshot
+        {
+            std::vector<Button*> buttons;
+            std::vector<uint32_t> slots; // slot of each button
+            std::vector<Button*> byId;   // buttons sorted by buttonId
+            std::vector<PortLayout> ports;
+            uint64_t generation{ 0 };
+        };
+    }
+
+    // track all active buttons
+    //
+    // Readers (the sampling interrupt) never wait: they take a Read guard,
+    // which bumps a reader count for the current epoch and loads the current
+    // snapshot. Writers copy the snapshot, change the copy, publish it with
+    // one atomic store, then wait for readers of the old one to leave before
+    // freeing it. So adding or removing buttons never pauses sampling, and
+    // once Remove returns the interrupt no longer sees that button.
+    class ButtonRegistry
+    {
+    public:
+        using Snapshot = ButtonHelpers::RegistrySnapshot;
+
+        // keeps a snapshot alive while in scope
+        class ReadGuard
+        {
+        public:
+            ReadGuard(const Snapshot* snapshot, std::atomic<uint32_t>* readers)
+                : snapshot_(snapshot), readers_(readers) {}
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator=(const ReadGuard&) = delete;
+            ~ReadGuard() { readers_->fetch_sub(1, std::memory_order_release); }
+
+            auto begin() const { return snapshot_->buttons.begin(); }
+            auto end() const { return snapshot_->buttons.end(); }
+            size_t size() const { return snapshot_->buttons.size(); }
+            bool empty() const { return snapshot_->buttons.empty(); }
+            Button* operator[](size_t i) const { return snapshot_->buttons[i]; }
+
+            // button with the given id, nullptr if gone, O(log n)
+            Button* Find(int buttonId) const;
+
+            const std::vector<ButtonHelpers::PortLayout>& Ports() const { return snapshot_->ports; }
+            uint64_t Generation() const { return snapshot_->generation; }
+
+        private:
+            const Snapshot* snapshot_;
+            std::atomic<uint32_t>* readers_;
+        };
+
+        ButtonRegistry();
+        ~ButtonRegistry();
+        ButtonRegistry(const ButtonRegistry&) = delete;
+        ButtonRegistry& operator=(const ButtonRegistry&) = delete;
+
+        // wait-free, safe from the interrupt
+        ReadGuard Read() const
+        {
+            const auto epoch = epoch_.load(std::memory_order_acquire);
+            auto& readers = readers_[epoch & 1];
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            return ReadGuard(current_.load(std::memory_order_seq_cst), &readers);
+        }
+
+        // add/remove a button, publishes a new snapshot
+        // Remove waits until no reader can still see the button
+        ButtonHelpers::RegistryHandle Add(Button* button);
+        void Remove(ButtonHelpers::RegistryHandle handle);
+
+        // integrator length of port debouncers made from now on,
+        // 0 (default) takes it from ButtonTimings
+        void SetBankSamples(int samples);
+
+        // unguarded access to current snapshot
+        // only safe on the thread that adds and removes buttons
+        auto begin() const { return current_.load(std::memory_order_acquire)->buttons.begin(); }
+        auto end() const { return current_.load(std::memory_order_acquire)->buttons.end(); }
+        size_t size() const { return current_.load(std::memory_order_acquire)->buttons.size(); }
+        bool empty() const { return size() == 0; }
+
+    private:
+        // wait until every reader that may hold an older snapshot is done
+        void Synchronize();
+        // swap in new snapshot, free old one once readers leave
+        void Publish(std::unique_ptr<Snapshot> next);
+        void BuildPorts(Snapshot& snapshot);
+        static void BuildIndex(Snapshot& snapshot);
+
+        std::atomic<const Snapshot*> current_;
+        std::atomic<uint64_t> epoch_{ 0 };
+        mutable std::atomic<uint32_t> readers_[2];
+
+        // writer side, guarded by writeLock_
+        std::mutex writeLock_;
+        std::vector<uint32_t> generations_; // per slot, odd while in use
+        std::vector<uint32_t> freeSlots_;
+        std::vector<std::unique_ptr<ButtonHelpers::PortState>> portStates_;
+        int bankSamples_{ 0 };
+    };
+
+}
+
+#endif //  BUTTON_REGISTRY_H
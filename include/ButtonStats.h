@@ -0,0 +1,217 @@
+#pragma once
+#ifndef BUTTON_STATS_H
+#define BUTTON_STATS_H
+
+// Lomont Button system
+// optional hot path instrumentation in lock-free histograms
+// Requires C++ 17
+
+#include <cstdint>
+#include <atomic>
+
+// 1 to record sampler and pattern timings in ButtonSystem::stats
+// 0 (default) compiles all of it out, nothing is stored or run
+// set the same for every file, it changes the size of ButtonSystem
+#ifndef BUTTON_STATS
+#define BUTTON_STATS 0
+#endif
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // copy of a Histogram at one moment
+    struct HistogramSnapshot
+    {
+        // bucket 0 holds 0, bucket b holds [2^(b-1), 2^b - 1], the last
+        // bucket also holds everything larger
+        static constexpr int Buckets = 32;
+
+        uint32_t counts[Buckets]{};
+        uint32_t count{ 0 };
+        uint32_t max{ 0 };
+
+        // largest value of the bucket holding fraction q of the values,
+        // so at most 2x high, and at most max, 0 if empty
+        uint32_t Percentile(double q) const
+        {
+            if (count == 0) return 0;
+            const auto rank = static_cast<uint32_t>(q * (count - 1)) + 1;
+            uint32_t seen = 0;
+            for (auto b = 0; b < Buckets; ++b)
+            {
+                seen += counts[b];
+                if (seen >= rank)
+                    return b == 0 ? 0 : (b == Buckets - 1 || max < (1U << b) - 1 ? max : (1U << b) - 1);
+            }
+            return max;
+        }
+
+        // values added since earlier, a snapshot of the same histogram
+        // max stays the largest value ever added
+        HistogramSnapshot Since(const HistogramSnapshot& earlier) const
+        {
+            HistogramSnapshot d = *this;
+            for (auto b = 0; b < Buckets; ++b)
+                d.counts[b] -= earlier.counts[b];
+            d.count -= earlier.count;
+            return d;
+        }
+    };
+
+    // fixed power of two bucket histogram of uint32_t values
+    // Add from one context only (each histogram has one writer), Read from
+    // any thread at any time. Needs only 32 bit atomics, and Add is plain
+    // loads and stores, no read-modify-write. A Read during an Add may miss
+    // that one value, counts are never torn.
+    class Histogram
+    {
+    public:
+        static constexpr int Buckets = HistogramSnapshot::Buckets;
+
+        void Add(uint32_t value)
+        {
+            auto& bucket = counts_[Bucket(value)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (value > max_.load(std::memory_order_relaxed))
+                max_.store(value, std::memory_order_relaxed);
+        }
+
+        HistogramSnapshot Read() const
+        {
+            HistogramSnapshot s;
+            for (auto b = 0; b < Buckets; ++b)
+                s.counts[b] = counts_[b].load(std::memory_order_relaxed);
+            s.count = count_.load(std::memory_order_relaxed);
+            s.max = max_.load(std::memory_order_relaxed);
+            return s;
+        }
+
+        // bit width of value, capped to the last bucket
+        static int Bucket(uint32_t value)
+        {
+            if (value == 0) return 0;
+#if defined(__GNUC__) || defined(__clang__)
+            const int width = 32 - __builtin_clz(value);
+#else
+            int width = 0;
+            while (value != 0)
+            {
+                value >>= 1;
+                ++width;
+            }
+#endif
+            return width < Buckets ? width : Buckets - 1;
+        }
+
+    private:
+        std::atomic<uint32_t> counts_[Buckets]{};
+        std::atomic<uint32_t> count_{ 0 };
+        std::atomic<uint32_t> max_{ 0 };
+    };
+
+    // a ButtonStats at one moment, see ButtonStats for each field
+    struct StatsSnapshot
+    {
+        static constexpr int MaxPatterns = 16;
+
+        HistogramSnapshot passNs;
+        HistogramSnapshot passJitterNs;
+        HistogramSnapshot fsmUpdates;
+        HistogramSnapshot matchLatencyMs;
+        uint32_t transitions[MaxPatterns]{};
+        uint32_t multiTransitions[MaxPatterns]{};
+    };
+
+    // hot path measurements of one ButtonSystem, present when BUTTON_STATS
+    // The sampler writes the pass histograms, the pattern thread the rest.
+    // Pass timings need SystemHooks::nowNs. Pattern steps are counted from
+    // UpdatePatternMatches, UpdateAllPatternEvents and ButtonMultiPattern;
+    // an FSMBankSet has no system and records nothing here.
+    class ButtonStats
+    {
+    public:
+        static constexpr int MaxPatterns = StatsSnapshot::MaxPatterns;
+
+        // SamplePorts pass duration, ns
+        Histogram passNs;
+        // difference between the time from one pass start to the next and
+        // the sample period, ns. Skipped across idle stops.
+        Histogram passJitterNs;
+        // FSM updates run by each UpdateAllPatternMatches
+        Histogram fsmUpdates;
+        // from a button's last debounced edge to a pattern's counter 0
+        // going up, ms. Event driven patterns count at the exact ms, multi
+        // button patterns from the edge of the button that moved them.
+        Histogram matchLatencyMs;
+
+        // copy of everything, safe while sampling runs
+        StatsSnapshot Read() const
+        {
+            StatsSnapshot s;
+            s.passNs = passNs.Read();
+            s.passJitterNs = passJitterNs.Read();
+            s.fsmUpdates = fsmUpdates.Read();
+            s.matchLatencyMs = matchLatencyMs.Read();
+            for (auto p = 0; p < MaxPatterns; ++p)
+            {
+                s.transitions[p] = transitions_[p].load(std::memory_order_relaxed);
+                s.multiTransitions[p] = multiTransitions_[p].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+
+        // sampler: a pass ran from startNs to endNs, the next one is due
+        // periodMs after it started, 0 if sampling stopped
+        void Pass(uint32_t startNs, uint32_t endNs, uint32_t periodMs)
+        {
+            passNs.Add(endNs - startNs);
+            if (lastPeriodMs_ != 0)
+            {
+                const int32_t late = static_cast<int32_t>(startNs - lastStartNs_ - lastPeriodMs_ * 1000000U);
+                passJitterNs.Add(static_cast<uint32_t>(late < 0 ? -late : late));
+            }
+            lastStartNs_ = startNs;
+            lastPeriodMs_ = periodMs;
+        }
+
+        // sampling starts again after it stopped, so the first pass has no
+        // previous one to measure jitter from. Call while no pass runs.
+        void SamplingStarted()
+        {
+            lastStartNs_ = 0;
+            lastPeriodMs_ = 0;
+        }
+
+        // pattern thread: pattern index took an arrow, matched if its
+        // counter 0 went up, edgeAgeMs after the button's last edge
+        void Transition(int pattern, bool matched, uint64_t edgeAgeMs)
+        {
+            Count(transitions_, pattern, matched, edgeAgeMs);
+        }
+
+        // as above for a ButtonMultiPattern pattern index
+        void MultiTransition(int pattern, bool matched, uint64_t edgeAgeMs)
+        {
+            Count(multiTransitions_, pattern, matched, edgeAgeMs);
+        }
+
+    private:
+        // arrows taken by pattern index, later indexes counted in the last
+        std::atomic<uint32_t> transitions_[MaxPatterns]{};
+        std::atomic<uint32_t> multiTransitions_[MaxPatterns]{};
+
+        void Count(std::atomic<uint32_t>* counts, int pattern, bool matched, uint64_t edgeAgeMs)
+        {
+            auto& t = counts[pattern < MaxPatterns ? pattern : MaxPatterns - 1];
+            t.store(t.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (matched)
+                matchLatencyMs.Add(edgeAgeMs < UINT32_MAX ? static_cast<uint32_t>(edgeAgeMs) : UINT32_MAX);
+        }
+
+        uint32_t lastStartNs_{ 0 }; // sampler only
+        uint32_t lastPeriodMs_{ 0 };
+    };
+
+}}
+
+#endif // BUTTON_STATS_H
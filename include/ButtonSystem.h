@@ -0,0 +1,133 @@
+#pragma once
+#ifndef BUTTON_SYSTEM_H
+#define BUTTON_SYSTEM_H
+
+// Lomont Button system
+// one independent button system: registry, timings, patterns and hooks
+// Requires C++ 17
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "ButtonHelp.h"
+#include "ButtonRegistry.h"
+#include "ButtonStats.h"
+#include "ButtonFSMTable.h"
+#include "EdgeQueue.h"
+#include "PatternEvents.h"
+
+namespace Lomont {
+
+    // Everything a set of buttons shares: the registry the sampler reads,
+    // button ids, timings, default patterns, pattern deadlines, the edge
+    // queue, adaptive sampling state and the hardware hooks. Systems share
+    // nothing with each other, not even a cache line, so several can run on
+    // different threads, each sampled and updated by its own thread.
+    // Button::IsDown and the pattern updates without a TickContext read
+    // the system's clock hook. Debouncer::IsDown without one reads the
+    // default system's clock, so give it a tick from NowMs().
+    //
+    // The Button statics and the ButtonTimings and ButtonHW globals are
+    // the Default() system. Make buttons in another system with
+    // Button(system, gpio), then call its SamplePorts from your sampling
+    // interrupt or thread (with Hooks().readPins set) and its pattern
+    // updates from your pattern thread.
+    class alignas(64) ButtonSystem
+    {
+    public:
+        // timings and hooks at their defaults, no buttons
+        ButtonSystem();
+        explicit ButtonSystem(const ButtonHelpers::SystemTimings& timings);
+
+        // buttons keep a pointer to their system
+        ButtonSystem(const ButtonSystem&) = delete;
+        ButtonSystem& operator=(const ButtonSystem&) = delete;
+
+        // the system behind the global API, started by the platform
+        // interrupt functions in ButtonHW
+        static ButtonSystem& Default();
+
+        // set before making buttons in this system
+        ButtonHelpers::SystemTimings& Timings() { return *timings_; }
+        ButtonHelpers::SystemHooks& Hooks() { return *hooks_; }
+
+        // id the next Button made here gets, later ones count up from it
+        // ids given out are never reused, so an id below NextButtonId()
+        // returns false and changes nothing. For replaying a recorded run.
+        bool SetNextButtonId(int id);
+        int NextButtonId() const { return nextButtonId_; }
+
+        // Hooks().clockMs if set, else ButtonHW::ElapsedMs
+        uint64_t NowMs() const { return hooks_->clockMs ? hooks_->clockMs() : ButtonHelpers::ButtonHW::ElapsedMs(); }
+
+        // live buttons, read from the sampler with buttonPtrs.Read()
+        ButtonRegistry buttonPtrs;
+
+        // debounced edges for UpdateAllPatternEvents, filled only once
+        // that has been called, so polling alone never fills it
+        ButtonHelpers::EdgeQueue edgeEvents;
+
+        // as the Button statics of the same names, for this system
+        void SamplePorts(uint64_t elapsedMs);
+        void EndSamplePass(bool settled, uint64_t elapsedMs);
+        void SamplerWake();
+        void UpdateAllPatternMatches(const ButtonHelpers::TickContext& tick);
+        uint64_t UpdateAllPatternEvents(uint64_t nowMs);
+
+        // default patterns from Timings(), built on first use
+        const std::vector<ButtonHelpers::FSM::FSMDef>& DefaultPatterns();
+        const std::vector<ButtonHelpers::FSM::FSMTable>& DefaultPatternTables();
+
+#if BUTTON_STATS
+        // hot path histograms, read with stats.Read() while running
+        ButtonHelpers::ButtonStats stats;
+#endif
+
+    private:
+        friend class Button;
+
+        // the default system keeps timings and hooks in static storage
+        // that the globals refer to
+        ButtonSystem(ButtonHelpers::SystemTimings* timings, ButtonHelpers::SystemHooks* hooks);
+
+        ButtonHelpers::SystemTimings ownTimings_;
+        ButtonHelpers::SystemHooks ownHooks_;
+        ButtonHelpers::SystemTimings* timings_;
+        ButtonHelpers::SystemHooks* hooks_;
+        bool isDefault_{ false };
+
+        int nextButtonId_{ 1 };
+        std::vector<ButtonHelpers::FSM::FSMDef> defaultPatterns_;
+        ButtonHelpers::FSM::FSMTableSetStorage tablePool_;
+        std::vector<ButtonHelpers::FSM::FSMTable> defaultTables_;
+
+        // pending pattern deadlines for UpdateAllPatternEvents
+        ButtonHelpers::PatternScheduler patternScheduler_;
+        // set by the first UpdateAllPatternEvents, buttons post edges after
+        std::atomic<bool> eventsUsed_{ false };
+        void PostEdge(int buttonId, bool buttonDown, uint64_t elapsedMs)
+        {
+            // seq_cst pairs with the state store before it and the
+            // first UpdateAllPatternEvents, one of them sees the other
+            if (eventsUsed_.load())
+                edgeEvents.Push(ButtonHelpers::ButtonEdge{ buttonId, buttonDown, elapsedMs });
+        }
+
+        // sampling runs while any buttons exist
+        std::mutex samplingLock_;
+        bool samplingRunning_{ false };
+        void ButtonAdded();
+        void ButtonRemoved();
+
+        // adaptive sampling, see Button::EndSamplePass
+        enum class SampleRate : uint8_t { Full, Slow, Stopped };
+        std::atomic<SampleRate> sampleRate_{ SampleRate::Full };
+        std::atomic<bool> wakeRequested_{ false };
+        bool wasSettled_{ false };     // sampler only
+        uint64_t settledSinceMs_{ 0 }; // sampler only
+    };
+
+}
+
+#endif // BUTTON_SYSTEM_H
@@ -0,0 +1,173 @@
+#pragma once
+#ifndef DEBOUNCER_BANK_H
+#define DEBOUNCER_BANK_H
+
+// Lomont Button system
+// bit sliced debouncer, many buttons per machine word
+// Requires C++ 17
+
+#include <cstdint>
+#include <type_traits>
+#include "ButtonHelp.h"
+
+namespace Lomont {
+
+    namespace ButtonHelpers
+    {
+        // index of lowest set bit, v must be nonzero
+        template<typename Word>
+        inline int LowestBitIndex(Word v)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            if constexpr (sizeof(Word) <= sizeof(unsigned int))
+                return __builtin_ctz(static_cast<unsigned int>(v));
+            else
+                return __builtin_ctzll(static_cast<unsigned long long>(v));
+#else
+            int i = 0;
+            while ((v & 1) == 0)
+            {
+                v >>= 1;
+                ++i;
+            }
+            return i;
+#endif
+        }
+    }
+
+    // debounce a word of buttons at once
+    // each bit (lane) is one button, 1 = down
+    //
+    // Same integrator as Debouncer, but stored as vertical counters:
+    // bit i of plane j is bit j of the integrator for lane i. Each sample
+    // steps every lane's integrator up (raw down) or down (raw up) with
+    // a couple of logic ops per plane, saturating at 0 and at the
+    // number of samples in debounceMs. A lane goes down when its
+    // integrator reaches the top, and up when it reaches 0, exactly like
+    // Debouncer::DebounceInput.
+    template<typename Word = uint32_t>
+    class DebouncerBank
+    {
+        static_assert(std::is_same<Word, uint32_t>::value || std::is_same<Word, uint64_t>::value,
+            "DebouncerBank word must be uint32_t or uint64_t");
+    public:
+        // number of buttons in one bank
+        static constexpr int Lanes = static_cast<int>(sizeof(Word) * 8);
+
+        // create bank with integrator length from ButtonTimings
+        DebouncerBank()
+        {
+            using namespace ButtonHelpers::ButtonTimings;
+            SetSamples(debouncerInterruptMs ? debounceMs / debouncerInterruptMs : debounceMs);
+        }
+
+        // create bank needing the given number of agreeing samples to change state
+        explicit DebouncerBank(int samples)
+        {
+            SetSamples(samples);
+        }
+
+        // number of samples needed to change state, 1 to 127
+        // resets all lanes to up
+        void SetSamples(int samples)
+        {
+            if (samples < 1) samples = 1; // Debouncer never changes in this case, which is useless
+            if (samples > 127) samples = 127; // matches int8_t integrator
+            top_ = static_cast<Word>(samples);
+            planeCount_ = 0;
+            while ((samples >> planeCount_) != 0)
+                ++planeCount_;
+            Reset(~Word(0));
+        }
+
+        // set given lanes to up, integrators to 0
+        // call from the sampling context
+        void Reset(Word lanes)
+        {
+            for (auto& p : planes_)
+                p &= ~lanes;
+            state_ &= ~lanes;
+            atZero_ |= lanes;
+            atTop_ &= ~lanes;
+            unsettled_ &= ~lanes;
+        }
+
+        // called from interrupt
+        // give raw down bits for all lanes, and elapsed milliseconds in the system
+        // returns mask of lanes whose debounced state changed
+        Word DebounceInput(Word buttonDown, uint64_t elapsedMs)
+        {
+            // up on down lanes not at top, down on up lanes not at 0
+            // carry and borrow never share a lane, so one xor does both
+            Word carry = buttonDown & ~atTop_;
+            Word borrow = ~buttonDown & ~atZero_;
+            Word zero = ~Word(0), top = ~Word(0);
+            for (int j = 0; j < planeCount_; ++j)
+            {
+                const Word c = planes_[j];
+                const Word n = c ^ (carry | borrow);
+                carry &= c;
+                borrow &= ~c;
+                planes_[j] = n;
+
+                zero &= ~n;
+                top &= ((top_ >> j) & 1) ? n : ~n;
+            }
+            atZero_ = zero;
+            atTop_ = top;
+            // lanes that move on the next sample if the input holds
+            unsettled_ = ~((top & buttonDown) | (zero & ~buttonDown));
+
+            const Word newState = (state_ | top) & ~zero;
+            const Word changed = newState ^ state_;
+            state_ = newState;
+
+            // rare, publish change times
+            Word bits = changed;
+            while (bits)
+            {
+                const int lane = ButtonHelpers::LowestBitIndex(bits);
+                times_[lane].SetAtomically(((newState >> lane) & 1) != 0, elapsedMs);
+                bits &= bits - 1;
+            }
+            return changed;
+        }
+
+        // debounced state of all lanes, 1 = down
+        // read from the sampling context, else use IsDown
+        Word State() const { return state_; }
+
+        // true when every integrator is pinned at the end matching its last input,
+        // so nothing can change until a raw input changes
+        bool Settled() const { return unsettled_ == 0; }
+
+        // is debounced button in this lane down?
+        // optionally gets time this state was changed
+        // safe to call outside the interrupt, like Debouncer::IsDown
+        bool IsDown(int lane, uint64_t* stateChangeTimeMs = nullptr) const
+        {
+            bool isDown;
+            uint64_t time;
+            times_[lane].GetAtomically(&isDown, &time);
+            if (stateChangeTimeMs)
+                *stateChangeTimeMs = time;
+            return isDown;
+        }
+
+    private:
+        // vertical counter planes, plane j is bit j of every lane's integrator
+        Word planes_[7]{};
+        Word top_{ 0 };     // integrator top value
+        int planeCount_{ 0 }; // planes in use
+        Word state_{ 0 };   // debounced state, 1 = down
+        Word atZero_{ ~Word(0) }; // lanes with integrator 0
+        Word atTop_{ 0 };   // lanes with integrator at top
+        Word unsettled_{ 0 }; // lanes still counting
+
+        // per lane published state and change time
+        ButtonHelpers::AtomicState times_[Lanes];
+    };
+
+}
+
+#endif //  DEBOUNCER_BANK_H
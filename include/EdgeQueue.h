@@ -0,0 +1,82 @@
+#pragma once
+#ifndef EDGE_QUEUE_H
+#define EDGE_QUEUE_H
+
+// Lomont Button system
+// lock-free queue of debounced edges from the sampler to the pattern code
+// Requires C++ 17
+
+#include <cstdint>
+#include <atomic>
+
+// edges the sampler can get ahead of the consumer, power of 2
+#ifndef BUTTON_EDGE_QUEUE_SIZE
+#define BUTTON_EDGE_QUEUE_SIZE 64
+#endif
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // a debounced button change
+    struct ButtonEdge
+    {
+        int buttonId{ 0 };
+        bool down{ false };
+        uint64_t timeMs{ 0 };
+    };
+
+    // fixed size single producer, single consumer ring
+    // Push only from one context (the sampling interrupt), Pop only from one
+    // other (the pattern thread). Needs only 32 bit atomics.
+    template<typename T, uint32_t Capacity>
+    class SpscRing
+    {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of 2");
+    public:
+        // producer side, false (and counted) if full
+        bool Push(const T& item)
+        {
+            const uint32_t head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) == Capacity)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            items_[head & (Capacity - 1)] = item;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, false if empty
+        bool Pop(T& item)
+        {
+            const uint32_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+                return false;
+            item = items_[tail & (Capacity - 1)];
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, items lost to a full ring since the last call
+        uint32_t TakeDropped()
+        {
+            return dropped_.exchange(0, std::memory_order_relaxed);
+        }
+
+        bool Empty() const
+        {
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<uint32_t> head_{ 0 }; // written by producer
+        T items_[Capacity]{};
+        std::atomic<uint32_t> tail_{ 0 }; // written by consumer
+        std::atomic<uint32_t> dropped_{ 0 };
+    };
+
+    using EdgeQueue = SpscRing<ButtonEdge, BUTTON_EDGE_QUEUE_SIZE>;
+
+}}
+
+#endif //  EDGE_QUEUE_H
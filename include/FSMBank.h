@@ -0,0 +1,118 @@
+#pragma once
+#ifndef FSM_BANK_H
+#define FSM_BANK_H
+
+// Lomont Button system
+// many instances of a pattern advanced together, state in parallel arrays
+// Requires C++ 17
+
+#include <cstdint>
+#include <vector>
+#include "ButtonHelp.h"
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM {
+
+    // All instances of one FSMTable keep state, state time and counters in
+    // arrays indexed by slot. UpdateAll first runs a branch free pass over
+    // every slot asking if any arrow of its state could match (per state
+    // bounds on button time and state time), then steps only those slots
+    // exactly as ButtonFSM does. Most passes most buttons are idle, so the
+    // work is one streaming loop over small arrays.
+    class FSMBank
+    {
+    public:
+        // table must outlive this
+        explicit FSMBank(const FSMTable* table);
+
+        // new instance for a button, returns its slot, -1 without a table
+        int Add(int buttonId);
+
+        // free a slot for reuse by Add
+        void Remove(int slot);
+
+        // slots in use or free, arrays passed to UpdateAll have this many
+        int Size() const { return static_cast<int>(state_.size()); }
+
+        // advance every instance at nowMs, slot i sees down[i] (0 or 1)
+        // and timeInStateMs[i]
+        void UpdateAll(const uint8_t* down, const uint32_t* timeInStateMs, uint64_t nowMs);
+
+        // advance one instance, as ButtonFSM::Update
+        // returns true if an arrow was taken
+        bool Update(int slot, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs);
+
+        // read counter j of slot, set to 0
+        int Read0(int slot, int j = 0);
+
+        int StateIndex(int slot) const { return state_[slot]; }
+        const FSMTable* Table() const { return table_; }
+
+    private:
+        bool Step(int slot, bool buttonDown, uint32_t timeInStateMs, uint32_t nowMs);
+
+        const FSMTable* table_;
+        int counterCount_;
+
+        // by state * 2 + down: an arrow may match if button time <= hi1,
+        // button time >= lo2, or state time >= lo3
+        std::vector<int32_t> hi1_;
+        std::vector<int32_t> lo2_;
+        std::vector<int32_t> lo3_;
+
+        // by slot
+        std::vector<uint8_t> state_;
+        std::vector<uint32_t> stateChangedMs_; // low 32 bits, differences as ButtonFSM
+        std::vector<int> buttonId_;
+        std::vector<uint8_t> live_;
+        std::vector<int32_t> counters_; // slot * counterCount + j
+        std::vector<int> free_;
+        std::vector<uint32_t> due_; // scratch, slots to step
+    };
+
+    // one banked pattern instance
+    struct BankRef
+    {
+        int bank{ -1 };
+        int slot{ -1 };
+    };
+
+    // FSMBanks for many buttons, one bank per table, fed from the buttons'
+    // debouncers. Update reads each debouncer once per pass.
+    // see Button::UseBank
+    class FSMBankSet
+    {
+    public:
+        // add an instance of table reading input, table must outlive this
+        // returns a ref with bank -1 for a null table
+        BankRef Add(const FSMTable* table, const Debouncer* input, int buttonId);
+        void Remove(BankRef ref);
+
+        // advance every instance at the pass time
+        void Update(const TickContext& tick);
+
+        int Read0(BankRef ref, int j = 0) { return Valid(ref) ? banks_[ref.bank].Read0(ref.slot, j) : 0; }
+        int StateIndex(BankRef ref) const { return Valid(ref) ? banks_[ref.bank].StateIndex(ref.slot) : 0; }
+
+        int BankCount() const { return static_cast<int>(banks_.size()); }
+        const FSMBank& Bank(int bank) const { return banks_[bank]; }
+
+    private:
+        bool Valid(BankRef ref) const { return 0 <= ref.bank && ref.bank < BankCount(); }
+
+        std::vector<FSMBank> banks_;
+        std::vector<std::vector<int>> inputOf_; // by bank and slot, index into inputs_
+
+        // distinct debouncers, with instance counts, freed at 0
+        std::vector<const Debouncer*> inputs_;
+        std::vector<int> inputUses_;
+
+        // scratch for a pass
+        std::vector<uint8_t> inputDown_;
+        std::vector<uint32_t> inputTime_;
+        std::vector<uint8_t> down_;
+        std::vector<uint32_t> time_;
+    };
+
+}}}
+
+#endif //  FSM_BANK_H
@@ -0,0 +1,70 @@
+#pragma once
+#ifndef FSM_OPTIMIZE_H
+#define FSM_OPTIMIZE_H
+
+// Lomont Button system
+// optimizer for hand built FSMDefs: removes unreachable states and dead
+// arrows, merges equivalent states, orders arrows by how often they match
+// Requires C++ 17
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ButtonHelp.h"
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM {
+
+    // Within one FSMDef every arrow test is constant on a grid of cells:
+    // button id (each id named, plus any other), button up or down, button
+    // time interval between bounds, state time interval between bounds.
+    // Checking one point per cell is exact, so an arrow no cell picks first
+    // is dead, and states picking the same actions and equivalent next states
+    // in every cell are merged (partition refinement, as in DFA minimization).
+    // Reordering only swaps neighbor arrows that match in no common cell.
+
+    // one ButtonFSM::Update call, record these to replay a pattern
+    struct FSMTraceStep
+    {
+        int buttonId;
+        bool buttonDown;
+        uint32_t timeInStateMs;
+        uint64_t nowMs;
+    };
+    using FSMTrace = std::vector<FSMTraceStep>;
+
+    struct OptimizeReport
+    {
+        int statesBefore{ 0 };
+        int statesAfter{ 0 };
+        int arrowsBefore{ 0 };
+        int arrowsAfter{ 0 };
+        int unreachableStates{ 0 }; // removed
+        int mergedStates{ 0 };      // removed as equal to another state
+        int deadArrows{ 0 };        // removed, never first to match
+        int movedArrows{ 0 };       // moved ahead by match frequency
+
+        // with a trace: arrows tested per update, and its check
+        size_t traceSteps{ 0 };
+        double arrowsTestedBefore{ 0 };
+        double arrowsTestedAfter{ 0 };
+        bool verified{ false };
+    };
+
+    // optimize def into optimized, reordering arrows if a trace is given
+    // the result is checked to match def on the trace, on a mismatch
+    // prints error, copies def to optimized and returns false
+    bool OptimizeFSM(const FSMDef& def, FSMDef& optimized, OptimizeReport& report, const FSMTrace* trace = nullptr);
+
+    // replay trace into ButtonFSMs for a and b, true if every update moves
+    // both or neither and all counters agree after each step
+    // firstMismatch gets the failing step
+    bool SameOnTrace(const FSMDef& a, const FSMDef& b, const FSMTrace& trace, size_t* firstMismatch = nullptr);
+
+    // matches of each arrow on a trace, counts[state][arrow]
+    std::vector<std::vector<uint64_t>> CountArrowMatches(const FSMDef& def, const FSMTrace& trace);
+
+    void PrintOptimizeReport(const OptimizeReport& report, const char* name, FILE* file);
+
+}}}
+
+#endif //  FSM_OPTIMIZE_H
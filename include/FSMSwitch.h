@@ -0,0 +1,57 @@
+#pragma once
+#ifndef FSM_SWITCH_H
+#define FSM_SWITCH_H
+
+// Lomont Button system
+// finite state machines generated as C++ source, one switch case per state
+// Requires C++ 17
+
+#include <cstdint>
+#include <cstdio>
+#include "ButtonHelp.h"
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM {
+
+    // state and counters of a generated FSM, see EmitFSMSwitch
+    // the generated struct derives from this and adds
+    //   bool Update(int buttonId, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+    // with the same meaning as ButtonFSM::Update
+    template<int Counters>
+    class SwitchFSM
+    {
+    public:
+        // read counter j, set to 0
+        int Read0(int j = 0)
+        {
+            if (j < 0 || Counters <= j) return 0;
+            const int v = counters_[j];
+            counters_[j] = 0;
+            return v;
+        }
+
+        int StateIndex() const { return state_; }
+
+    protected:
+        // move to dest, returns true for Update
+        bool Go(int dest, uint64_t nowMs)
+        {
+            state_ = dest;
+            stateChangedMs_ = nowMs;
+            return true;
+        }
+
+        int state_{ 0 };
+        uint64_t stateChangedMs_{ 0 };
+        int counters_[Counters > 0 ? Counters : 1]{};
+    };
+
+    // write def as C++: a struct name deriving from SwitchFSM, whose Update
+    // switches on the state and tests each arrow inline, in arrow order,
+    // with its actions written out. Needs only this header to compile.
+    // prints error and returns false for actions or counters ButtonFSM
+    // would not run
+    bool EmitFSMSwitch(const FSMDef& def, const char* name, FILE* file);
+
+}}}
+
+#endif //  FSM_SWITCH_H
@@ -0,0 +1,342 @@
+#pragma once
+#ifndef PATTERN_DSL_H
+#define PATTERN_DSL_H
+
+// Lomont Button system
+// button sequence patterns written as text, compiled to FSMTables at compile time
+// Requires C++ 17
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include "ButtonHelp.h"
+
+/*
+ * Pattern text, tokens separated by spaces:
+ *
+ *   [names :] steps [within ms]
+ *
+ *   names   U=1 D=2 ...  single capital letter names for button ids 1-255
+ *   step    button then d (goes down) or u (goes up), or the bare button for
+ *           a click (down then up). button is an id or a declared name.
+ *           A step may end with >=ms (held at least ms before it counts) or
+ *           <=ms (seen within ms of its edge), on a click this bounds the down.
+ *   within  each step must come within ms of the one before, else start over
+ *
+ * Examples
+ *   "1d>=500 2d>=500 1u>=500 2u within 1000"       the ABAB pattern
+ *   "U=1 D=2 L=3 R=4 B=5 A=6 : U U D D L R L R B A" the Konami code
+ *
+ * Every button named starts up. Before the first step the pattern waits for
+ * all its buttons to be up, and any named button leaving the level the
+ * sequence expects starts it over. Other buttons are ignored. Counter 0
+ * counts completed sequences. Run the table with ButtonFSM in a
+ * ButtonMultiPattern, or in a Button for single button patterns.
+ *
+ * BUTTON_PATTERN parses the text twice at compile time, once for sizes and
+ * once for the table, so a bad pattern fails the build with a call to
+ * PatternError naming the problem:
+ *
+ *   static constexpr auto konami = BUTTON_PATTERN("U=1 D=2 ... : U U D D L R L R B A");
+ *   multi.patterns.emplace_back(&konami.table);
+ */
+#define BUTTON_PATTERN(text) \
+    ::Lomont::ButtonHelpers::FSM::PatternDSL::Compile< \
+        ::Lomont::ButtonHelpers::FSM::PatternDSL::Measure(text).states, \
+        ::Lomont::ButtonHelpers::FSM::PatternDSL::Measure(text).arrows>(text)
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM { namespace PatternDSL {
+
+    // not constexpr: reached during constant evaluation it stops the build,
+    // the compiler shows the message in the failed call
+    inline void PatternError(const char* why)
+    {
+        printf("ERROR - button pattern: %s\n", why);
+    }
+
+    // limits of one pattern
+    constexpr int MaxSteps = 128;  // after clicks split into down and up
+    constexpr int MaxButtons = 16; // distinct buttons
+
+    // states and arrows of a pattern's table
+    struct Size
+    {
+        int states{ 1 };
+        int arrows{ 0 };
+    };
+
+    // compiled pattern, constexpr
+    // table points into this, so keep it static: at namespace scope or static constexpr
+    template<int States, int Arrows>
+    struct Pattern
+    {
+        std::array<uint16_t, States + 1> stateArrows{};
+        std::array<PackedArrow, Arrows == 0 ? 1 : Arrows> arrows{};
+        std::array<PackedAction, 1> actions{ { { 1, 0, 1 } } }; // counter 0 += 1
+        FSMTable table{ States, 1, stateArrows.data(), arrows.data(), actions.data() };
+
+        constexpr Pattern() = default;
+
+        // a copy points its table at its own arrays
+        constexpr Pattern(const Pattern& other)
+            : stateArrows(other.stateArrows)
+            , arrows(other.arrows)
+            , actions(other.actions)
+        {
+        }
+        Pattern& operator=(const Pattern&) = delete;
+
+        // for static_assert, compilers will not read members of an object
+        // pointing into itself during constant evaluation
+        static constexpr int StateCount = States;
+        static constexpr int ArrowCount = Arrows;
+
+        static constexpr size_t Bytes()
+        {
+            return sizeof(uint16_t) * (States + 1) + sizeof(PackedArrow) * Arrows + sizeof(PackedAction);
+        }
+    };
+
+    namespace Detail {
+
+        struct Step
+        {
+            int button{ 0 };   // index into Parsed::ids
+            bool down{ false };
+            int timeAction{ 0 }; // 0 none, 1 <=, 2 >=
+            int timeMs{ 0 };
+        };
+
+        struct Parsed
+        {
+            bool ok{ false };
+            Step steps[MaxSteps]{};
+            int stepCount{ 0 };
+            int ids[MaxButtons]{};   // button ids in order of first use
+            int buttonCount{ 0 };
+            int withinMs{ 0 };       // 0 for none
+        };
+
+        constexpr bool Space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+        constexpr bool Digit(char c) { return '0' <= c && c <= '9'; }
+        constexpr bool Name(char c) { return 'A' <= c && c <= 'Z'; }
+
+        // reads a decimal number at text[i], -1 if none or over max
+        constexpr int Number(const char* text, int& i, int max)
+        {
+            if (!Digit(text[i])) return -1;
+            int v = 0;
+            while (Digit(text[i]))
+            {
+                v = v * 10 + (text[i++] - '0');
+                if (v > max) return -1;
+            }
+            return v;
+        }
+
+        // returns good, otherwise reports why and marks p failed
+        constexpr bool Check(Parsed& p, bool good, const char* why)
+        {
+            if (!good)
+            {
+                PatternError(why);
+                p.ok = false;
+            }
+            return good;
+        }
+
+        constexpr bool AddStep(Parsed& p, int id, bool down, int timeAction, int timeMs)
+        {
+            int b = 0;
+            while (b < p.buttonCount && p.ids[b] != id) ++b;
+            if (b == p.buttonCount)
+            {
+                if (!Check(p, p.buttonCount < MaxButtons, "too many buttons")) return false;
+                p.ids[p.buttonCount++] = id;
+            }
+            // the button must be at the other level
+            bool isDown = false;
+            for (auto s = 0; s < p.stepCount; ++s)
+                if (p.steps[s].button == b)
+                    isDown = p.steps[s].down;
+            if (!Check(p, !(down && isDown), "button pressed while already down") ||
+                !Check(p, down || isDown, "button released while already up") ||
+                !Check(p, p.stepCount < MaxSteps, "too many steps"))
+                return false;
+            p.steps[p.stepCount++] = Step{ b, down, timeAction, timeMs };
+            return true;
+        }
+
+        constexpr Parsed Parse(const char* text)
+        {
+            Parsed p;
+            p.ok = true;
+            int names[26]{}; // id of each capital letter, 0 undeclared
+            if (!Check(p, text != nullptr, "no text")) return p;
+
+            // names are only allowed before a ':'
+            bool hasNames = false;
+            for (auto i = 0; text[i]; ++i)
+                hasNames |= text[i] == ':';
+
+            int i = 0;
+            while (hasNames)
+            {
+                while (Space(text[i])) ++i;
+                if (text[i] == ':') { ++i; break; }
+                if (!Check(p, Name(text[i]) && text[i + 1] == '=', "expected name=id before ':'"))
+                    return p;
+                const int n = text[i] - 'A';
+                i += 2;
+                const int id = Number(text, i, 255);
+                if (!Check(p, id >= 1, "button id must be 1-255")) return p;
+                if (!Check(p, names[n] == 0, "button name declared twice")) return p;
+                names[n] = id;
+            }
+
+            while (true)
+            {
+                while (Space(text[i])) ++i;
+                if (!text[i]) break;
+
+                if (!Check(p, p.withinMs == 0, "within must be last")) return p;
+                if (text[i] == 'w')
+                {
+                    const char* within = "within";
+                    int k = 0;
+                    while (within[k] && text[i + k] == within[k]) ++k;
+                    if (!Check(p, !within[k] && Space(text[i + k]), "unknown word")) return p;
+                    i += k;
+                    while (Space(text[i])) ++i;
+                    p.withinMs = Number(text, i, 65535);
+                    if (!Check(p, p.withinMs >= 1, "within needs 1-65535 ms")) return p;
+                    continue;
+                }
+
+                // button
+                int id = 0;
+                if (Name(text[i]))
+                {
+                    id = names[text[i] - 'A'];
+                    if (!Check(p, id != 0, "undeclared button name")) return p;
+                    ++i;
+                }
+                else
+                {
+                    id = Number(text, i, 255);
+                    if (!Check(p, id >= 1, "button id must be 1-255")) return p;
+                }
+
+                // direction, none for a click
+                int direction = 0; // 1 up, 2 down
+                if (text[i] == 'u' || text[i] == 'd')
+                    direction = text[i++] == 'd' ? 2 : 1;
+
+                // time bound
+                int timeAction = 0, timeMs = 0;
+                if ((text[i] == '>' || text[i] == '<') && text[i + 1] == '=')
+                {
+                    timeAction = text[i] == '<' ? 1 : 2;
+                    i += 2;
+                    timeMs = Number(text, i, 65535);
+                    if (!Check(p, timeMs >= 0, "time bound needs 0-65535 ms")) return p;
+                }
+                if (!Check(p, !text[i] || Space(text[i]), "unexpected character in step")) return p;
+
+                if (direction == 0)
+                {
+                    if (!AddStep(p, id, true, timeAction, timeMs) || !AddStep(p, id, false, 0, 0))
+                        return p;
+                }
+                else if (!AddStep(p, id, direction == 2, timeAction, timeMs))
+                    return p;
+            }
+            Check(p, p.stepCount != 0, "no steps");
+            return p;
+        }
+
+        // state layout: buttonCount states waiting for each button up,
+        // then one state per step
+        constexpr Size SizeOf(const Parsed& p)
+        {
+            Size size;
+            if (!p.ok) return size;
+            const int k = p.buttonCount;
+            size.states = k + p.stepCount;
+            size.arrows = k * (k + 1) / 2 + p.stepCount * k + (p.withinMs ? p.stepCount - 1 : 0);
+            if (size.states > 255)
+            {
+                PatternError("more than 255 states");
+                return Size{};
+            }
+            return size;
+        }
+
+        constexpr PackedArrow MakeArrow(int dest, int id, int buttonAction, int timeAction, int timeMs, bool count = false)
+        {
+            return PackedArrow{
+                static_cast<uint8_t>(dest),
+                static_cast<uint8_t>(id),
+                static_cast<uint8_t>(buttonAction | (timeAction << 2)),
+                static_cast<uint8_t>(count ? 1 : 0),
+                static_cast<uint16_t>(timeMs),
+                0 };
+        }
+    }
+
+    // table size of a pattern, stops the build on a bad pattern
+    constexpr Size Measure(const char* text)
+    {
+        return Detail::SizeOf(Detail::Parse(text));
+    }
+
+    // build the table, States and Arrows from Measure, see BUTTON_PATTERN
+    template<int States, int Arrows>
+    constexpr Pattern<States, Arrows> Compile(const char* text)
+    {
+        using namespace Detail;
+        Pattern<States, Arrows> pattern;
+        const Parsed p = Parse(text);
+        const Size size = SizeOf(p);
+        if (!p.ok || size.states != States || size.arrows != Arrows)
+        { // one state, no arrows, never matches
+            if (p.ok) PatternError("sizes do not match the text");
+            for (auto& s : pattern.stateArrows) s = 0;
+            return pattern;
+        }
+
+        const int k = p.buttonCount;
+        int a = 0, s = 0;
+
+        // wait for each button up, a button already up going down starts over
+        for (; s < k; ++s)
+        {
+            pattern.stateArrows[s] = static_cast<uint16_t>(a);
+            for (auto j = 0; j < s; ++j)
+                pattern.arrows[a++] = MakeArrow(0, p.ids[j], 2, 0, 0);
+            pattern.arrows[a++] = MakeArrow(s + 1, p.ids[s], 1, 0, 0);
+        }
+
+        // then the steps
+        bool down[MaxButtons]{};
+        for (auto e = 0; e < p.stepCount; ++e, ++s)
+        {
+            const Step& step = p.steps[e];
+            const bool last = e + 1 == p.stepCount;
+            pattern.stateArrows[s] = static_cast<uint16_t>(a);
+            pattern.arrows[a++] = MakeArrow(last ? 0 : s + 1, p.ids[step.button], step.down ? 2 : 1,
+                step.timeAction, step.timeMs, last);
+            for (auto j = 0; j < k; ++j)
+                if (j != step.button) // leaving the expected level
+                    pattern.arrows[a++] = MakeArrow(0, p.ids[j], down[j] ? 1 : 2, 0, 0);
+            if (p.withinMs && e > 0)
+                pattern.arrows[a++] = MakeArrow(0, 0, 0, 3, p.withinMs);
+            down[step.button] = step.down;
+        }
+        pattern.stateArrows[s] = static_cast<uint16_t>(a);
+        return pattern;
+    }
+
+}}}}
+
+#endif //  PATTERN_DSL_H
@@ -0,0 +1,147 @@
+#pragma once
+#ifndef PATTERN_EVENTS_H
+#define PATTERN_EVENTS_H
+
+// Lomont Button system
+// event driven pattern evaluation, FSMs run only on edges and deadlines
+// Requires C++ 17
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include "ButtonHelp.h"
+#include "TimingWheel.h"
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // step observer for PatternEvents::Update, the default runs nothing
+    // one that is Enabled gets (pattern index, counter 0 went up, ms in state)
+    // for every arrow taken
+    struct NoPatternSteps
+    {
+        static constexpr bool Enabled = false;
+        void operator()(int, bool, uint64_t) const {}
+    };
+
+    // event driven pattern state for one button
+    //
+    // Patterns only change on a debounced edge, or when a time bound in the
+    // current state comes due (FSM::ButtonFSM::NextDeadlineMs). Update runs
+    // the FSMs at exactly those times, so an idle button costs nothing and
+    // matches happen at the exact ms they become true.
+    struct PatternEvents
+    {
+        // bound on pattern steps run at once, stops FSMs that loop without time passing
+        static constexpr int MaxSteps = 16;
+
+        bool down{ false };           // button state patterns have seen
+        uint64_t changedMs{ 0 };      // time of that state
+        uint64_t nextDeadlineMs{ 0 }; // next time patterns need running
+        uint64_t ranMs{ 0 };          // last time patterns ran
+        WheelTimer timer;             // nextDeadlineMs in a PatternScheduler
+
+        // true if the button state differs from what the patterns have seen
+        bool HasEdge(bool isDown, uint64_t stateChangedMs) const
+        {
+            return isDown != down || stateChangedMs != changedMs;
+        }
+
+        // give the patterns the current debounced button state,
+        // runs all edges and deadlines up to nowMs
+        // edges older than the state already seen are ignored
+        // returns next deadline, or FSM::NoDeadlineMs
+        template<typename Patterns, typename OnStep = NoPatternSteps>
+        uint64_t Update(int buttonId, Patterns& patterns, bool isDown, uint64_t stateChangedMs, uint64_t nowMs,
+            const OnStep& onStep = OnStep())
+        {
+            if (HasEdge(isDown, stateChangedMs) && changedMs <= stateChangedMs)
+            {
+                // finish the old button state, then evaluate at the edge
+                if (stateChangedMs > 0)
+                    RunDeadlines(buttonId, patterns, std::min(stateChangedMs - 1, nowMs), onStep);
+                down = isDown;
+                changedMs = stateChangedMs;
+                // an edge that arrives late runs now, time never goes back
+                nextDeadlineMs = std::max(stateChangedMs, ranMs);
+            }
+            RunDeadlines(buttonId, patterns, nowMs, onStep);
+            return nextDeadlineMs;
+        }
+
+    private:
+        // run pattern deadlines up to toMs with the current button state
+        template<typename Patterns, typename OnStep>
+        void RunDeadlines(int buttonId, Patterns& patterns, uint64_t toMs, const OnStep& onStep)
+        {
+            for (auto step = 0; step < MaxSteps && nextDeadlineMs <= toMs; ++step)
+            {
+                const uint64_t t = nextDeadlineMs;
+                ranMs = t;
+                if constexpr (OnStep::Enabled)
+                {
+                    for (auto i = 0U; i < patterns.size(); ++i)
+                    {
+                        auto& p = patterns[i];
+                        const int before = p.Peek(0);
+                        if (p.Update(buttonId, down, t - changedMs, t))
+                            onStep(static_cast<int>(i), p.Peek(0) > before, t - changedMs);
+                    }
+                }
+                else
+                {
+                    for (auto& p : patterns)
+                        p.Update(buttonId, down, t - changedMs, t);
+                }
+
+                // every pattern had its one step at t, as a 1 ms poll gives
+                // it, so an arrow leading to a state due at once waits for t+1
+                nextDeadlineMs = FSM::NoDeadlineMs;
+                for (auto& p : patterns)
+                    nextDeadlineMs = std::min(nextDeadlineMs, p.NextDeadlineMs(buttonId, down, changedMs, t));
+                nextDeadlineMs = std::max(nextDeadlineMs, t + 1);
+            }
+        }
+    };
+
+    // owns all pending pattern deadlines in a timing wheel
+    // arm and cancel are O(1), expired ones come back in batches
+    class PatternScheduler
+    {
+    public:
+        // track events.nextDeadlineMs, owner is handed back on expiry
+        void Schedule(PatternEvents& events, void* owner)
+        {
+            events.timer.owner = owner;
+            if (events.nextDeadlineMs == FSM::NoDeadlineMs)
+                wheel_.Cancel(events.timer);
+            else
+                wheel_.Arm(events.timer, events.nextDeadlineMs);
+        }
+
+        void Cancel(PatternEvents& events)
+        {
+            wheel_.Cancel(events.timer);
+        }
+
+        // owners of all deadlines due by nowMs, in deadline order
+        // valid until the next call
+        const std::vector<WheelTimer*>& Expire(uint64_t nowMs)
+        {
+            expired_.clear();
+            wheel_.Advance(nowMs, expired_);
+            return expired_;
+        }
+
+        // earliest pending deadline, ~0 if none
+        uint64_t NextDeadlineMs() const { return wheel_.NextDeadlineMs(); }
+
+        size_t Pending() const { return wheel_.Count(); }
+
+    private:
+        TimingWheel wheel_;
+        std::vector<WheelTimer*> expired_;
+    };
+
+}}
+
+#endif //  PATTERN_EVENTS_H
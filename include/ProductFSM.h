@@ -0,0 +1,216 @@
+#pragma once
+#ifndef PRODUCT_FSM_H
+#define PRODUCT_FSM_H
+
+// Lomont Button system
+// several per button patterns merged into one product state machine
+// Requires C++ 17
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "ButtonHelp.h"
+#include "ButtonFSMTable.h"
+
+namespace Lomont { namespace ButtonHelpers { namespace FSM {
+
+    // Each product state is a tuple of pattern states. Its button time axis is
+    // cut at every bound of the patterns' button time arrows, so within one
+    // cell (button up or down, time interval) every pattern's choice is fixed,
+    // except arrows on time in a pattern's own state. Those stay tests, run in
+    // the cell in arrow order, and their outcomes pick one of the cell's leaves.
+    // So one update is a cell lookup, a few state time compares, and one leaf.
+
+    // one outcome of a cell: where every pattern goes
+    struct ProductLeaf
+    {
+        uint16_t next;        // product state
+        uint16_t changedMask; // patterns that took an arrow, their state time resets
+        uint16_t firstAction; // into actions, counters are merged
+        uint16_t actionCount;
+    };
+
+    // state time test for one pattern, outcome j is the first bound with
+    // time in that pattern's state >= bounds[firstBound + j], else count
+    struct ProductTest
+    {
+        uint8_t pattern;
+        uint8_t count;
+        uint16_t firstBound;
+    };
+
+    // a (button down, button time interval) cell of a product state
+    struct ProductCell
+    {
+        uint16_t firstTest;
+        uint16_t testCount;
+        uint32_t firstLeaf; // leaves in mixed radix order of test outcomes
+    };
+
+    // compiled product, all arrays may be constexpr, see EmitProductTable
+    struct ProductTable
+    {
+        uint8_t patternCount;
+        uint16_t stateCount;
+        uint16_t counterCount;
+        const uint16_t* counterOffsets; // first merged counter of each pattern
+        const uint8_t* patternStates;   // stateCount x patternCount pattern states
+        const uint16_t* stateCuts;      // stateCount + 1 offsets into cuts
+        const uint32_t* cuts;           // start of each button time interval after the first
+        const uint32_t* stateCells;     // first cell of each state, up cells then down cells
+        const ProductCell* cells;
+        const ProductTest* tests;
+        const uint16_t* bounds;
+        const ProductLeaf* leaves;
+        const PackedAction* actions;
+    };
+
+    // heap backed table, output of CompileProduct
+    struct ProductTableStorage
+    {
+        int patternCount{ 0 };
+        std::vector<uint16_t> counterOffsets;
+        std::vector<uint8_t> patternStates;
+        std::vector<uint16_t> stateCuts;
+        std::vector<uint32_t> cuts;
+        std::vector<uint32_t> stateCells;
+        std::vector<ProductCell> cells;
+        std::vector<ProductTest> tests;
+        std::vector<uint16_t> bounds;
+        std::vector<ProductLeaf> leaves;
+        std::vector<PackedAction> actions;
+
+        int StateCount() const { return static_cast<int>(stateCuts.size()) - 1; }
+
+        // view for ProductFSM, valid while this lives
+        ProductTable Table() const
+        {
+            return ProductTable{
+                static_cast<uint8_t>(patternCount),
+                static_cast<uint16_t>(StateCount()),
+                counterOffsets.empty() ? uint16_t(0) : counterOffsets.back(),
+                counterOffsets.data(), patternStates.data(),
+                stateCuts.data(), cuts.data(), stateCells.data(),
+                cells.data(), tests.data(), bounds.data(), leaves.data(), actions.data() };
+        }
+
+        // bytes used by the table arrays
+        size_t Bytes() const
+        {
+            return sizeof(ProductTable) +
+                counterOffsets.size() * sizeof(uint16_t) +
+                patternStates.size() * sizeof(uint8_t) +
+                stateCuts.size() * sizeof(uint16_t) +
+                cuts.size() * sizeof(uint32_t) +
+                stateCells.size() * sizeof(uint32_t) +
+                cells.size() * sizeof(ProductCell) +
+                tests.size() * sizeof(ProductTest) +
+                bounds.size() * sizeof(uint16_t) +
+                leaves.size() * sizeof(ProductLeaf) +
+                actions.size() * sizeof(PackedAction);
+        }
+    };
+
+    // merge per button patterns (no arrow names a button id) into one machine
+    // only reachable product states are built
+    // prints error and returns false if a pattern is not per button or too large
+    bool CompileProduct(const std::vector<const FSMDef*>& defs, ProductTableStorage& table);
+
+    // write C++ source for constexpr arrays and a ProductTable named name
+    void EmitProductTable(const ProductTableStorage& table, const char* name, FILE* file);
+
+    // runs a compiled product, same behavior as a ButtonFSM per pattern
+    // updated with the same inputs
+    class ProductFSM
+    {
+    public:
+        ProductFSM() = default;
+
+        explicit ProductFSM(const ProductTable* table) : table_(table)
+        {
+            if (!table_) return;
+            counters_.assign(table_->counterCount, 0);
+            stateTimeChangedMs_.assign(table_->patternCount, 0);
+        }
+
+        // read counter j of pattern, set to 0, as ButtonFSM::Read0
+        int Read0(int pattern, int j = 0)
+        {
+            if (!table_ || pattern < 0 || table_->patternCount <= pattern) return 0;
+            const int c = table_->counterOffsets[pattern] + j;
+            if (j < 0 || table_->counterOffsets[pattern + 1] <= c) return 0;
+            const auto v = counters_[c];
+            counters_[c] = 0;
+            return v;
+        }
+
+        // call this often to monitor state
+        void Update(int buttonId, bool buttonDown, uint64_t timeInStateMs)
+        {
+            Update(buttonId, buttonDown, timeInStateMs, ButtonHW::NowMs());
+        }
+
+        // as above, evaluated at time nowMs
+        // returns true if any pattern took an arrow
+        bool Update(int /*buttonId*/, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+        {
+            if (!table_) return false;
+            const auto& t = *table_;
+
+            // button time interval, int compare as Arrow::Matches does
+            const int64_t tis = static_cast<int>(timeInStateMs);
+            const uint32_t* cuts = t.cuts + t.stateCuts[state_];
+            const int cutCount = t.stateCuts[state_ + 1] - t.stateCuts[state_];
+            int interval = 0;
+            while (interval < cutCount && tis >= static_cast<int64_t>(cuts[interval]))
+                ++interval;
+            const ProductCell& cell = t.cells[t.stateCells[state_] + (buttonDown ? cutCount + 1 : 0) + interval];
+
+            // deferred state time tests pick the leaf
+            uint32_t leafIndex = 0;
+            for (auto i = 0; i < cell.testCount; ++i)
+            {
+                const ProductTest& test = t.tests[cell.firstTest + i];
+                const int stateDt = static_cast<int>(nowMs - stateTimeChangedMs_[test.pattern]);
+                int outcome = test.count;
+                for (auto j = 0; j < test.count; ++j)
+                {
+                    if (stateDt >= t.bounds[test.firstBound + j])
+                    {
+                        outcome = j;
+                        break;
+                    }
+                }
+                leafIndex = leafIndex * (test.count + 1) + outcome;
+            }
+            const ProductLeaf& leaf = t.leaves[cell.firstLeaf + leafIndex];
+
+            const PackedAction* action = t.actions + leaf.firstAction;
+            for (auto i = 0; i < leaf.actionCount; ++i, ++action)
+                action->DoAction(counters_);
+            for (uint32_t mask = leaf.changedMask, p = 0; mask; mask >>= 1, ++p)
+                if (mask & 1)
+                    stateTimeChangedMs_[p] = nowMs;
+            state_ = leaf.next;
+            return leaf.changedMask != 0;
+        }
+
+        int StateIndex() const { return state_; }
+
+        // state of one merged pattern, as ButtonFSM::StateIndex
+        int PatternState(int pattern) const
+        {
+            if (!table_ || pattern < 0 || table_->patternCount <= pattern) return 0;
+            return table_->patternStates[state_ * table_->patternCount + pattern];
+        }
+
+    private:
+        const ProductTable* table_{ nullptr };
+        int state_{ 0 };
+        std::vector<int> counters_;
+        std::vector<uint64_t> stateTimeChangedMs_; // per pattern
+    };
+
+}}}
+
+#endif //  PRODUCT_FSM_H
@@ -0,0 +1,252 @@
+#pragma once
+#ifndef SAMPLE_TRACE_H
+#define SAMPLE_TRACE_H
+
+// Lomont Button system
+// compact binary trace of raw samples and debounced edges, for replay
+// Requires C++ 17
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "DebouncerBank.h"
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // Trace format, little endian, numbers are LEB128 varints (v):
+    //   header  'L' 'B' 'T' '1', debounceMs (u8), debouncerInterruptMs (u8)
+    //   then records, each a tag byte and its fields:
+    //   Time   v ms       first pass, at absolute ms
+    //   Pass   v dt       pass dt ms after the last, dt is the new period
+    //   Next              pass one period after the last
+    //   Run    v n        n passes one period apart, nothing changed
+    //   Levels u8 port, v xor     raw levels of port changed by xor this pass
+    //   Pin    u8 port * 32 + pin raw level of one pin flipped this pass
+    //   Edge   v id * 2 + down    debounced edge of a button this pass
+    //   Layout v count, then count times v id, v gpio, u8 downIsHigh
+    //          buttons in use from this pass on
+    //   End
+    // Pin, Levels, Edge and Layout follow the Time, Pass or Next of their
+    // pass. A pass with nothing to say at the usual period costs nothing
+    // until the Run is written, so an idle hour at 1 ms sampling is a few
+    // bytes, and a bounce is a Run, a Next and a Pin.
+    namespace Trace
+    {
+        enum Tag : uint8_t { Time = 1, Pass, Next, Run, Levels, Pin, Edge, Layout, End };
+
+        // ports 0 to MaxPorts - 1 are recorded
+        constexpr int MaxPorts = 8;
+
+        // gpio has its levels recorded, buttons on other pins are in the
+        // Layout and Edge records only
+        constexpr bool Traced(int gpio) { return 0 <= gpio && gpio < MaxPorts * 32; }
+
+        // longest record but Layout, space checked before each
+        constexpr int MaxRecordBytes = 12;
+    }
+
+    // Records the batched sampling path, set Button::trace to one of these.
+    // Per tick cost is a compare per pass, an xor per port and an add, bytes
+    // are written only when a level or the period changes or an edge is
+    // debounced. Bytes go to a caller buffer, passed to sink when full;
+    // without a sink recording stops at a full buffer, leaving a valid trace
+    // whose last pass may be missing records.
+    // Used from the interrupt only, between passes call Finish, then read
+    // the buffer (or the sink output) with TraceReader.
+    class TraceRecorder
+    {
+    public:
+        // sink gets each full buffer, and the rest on Finish
+        using Sink = void (*)(const uint8_t* bytes, size_t size, void* user);
+
+        TraceRecorder(uint8_t* buffer, size_t size, Sink sink = nullptr, void* user = nullptr);
+
+        // called by ButtonSystem::SamplePorts at the start of a pass, with
+        // the timings of the system sampling, which go in the header on the
+        // first pass. Returns true if Layout must be called for every
+        // button, the first pass and after buttons change
+        bool BeginPass(uint64_t elapsedMs, uint64_t layoutGeneration, uint8_t debounceMs, uint8_t debouncerInterruptMs)
+        {
+            if (!headerWritten_) WriteHeader(debounceMs, debouncerInterruptMs);
+            passMs_ = elapsedMs;
+            passWritten_ = false;
+            if (!started_ || elapsedMs - lastMs_ != periodMs_ || layoutGeneration != generation_)
+                WritePass();
+            if (layoutGeneration == generation_)
+                return false;
+            generation_ = layoutGeneration;
+            return true;
+        }
+
+        // after BeginPass returns true, Layout then LayoutButton for each
+        void Layout(size_t buttonCount);
+        void LayoutButton(int buttonId, int gpio, bool downIsHigh);
+
+        // raw levels of a port this pass
+        void Levels(int port, uint32_t levels)
+        {
+            if (static_cast<unsigned>(port) >= Trace::MaxPorts) return;
+            const uint32_t changed = levels ^ levels_[port];
+            if (!changed) return;
+            levels_[port] = levels;
+            if (!passWritten_) WritePass();
+            if (!Reserve()) return;
+            if ((changed & (changed - 1)) == 0)
+            { // one pin, the usual case
+                Put(Trace::Pin);
+                Put(static_cast<uint8_t>(port * 32 + LowestBitIndex(changed)));
+                return;
+            }
+            Put(Trace::Levels);
+            Put(static_cast<uint8_t>(port));
+            PutVarint(changed);
+        }
+
+        // debounced edge of a button this pass
+        void Edge(int buttonId, bool down)
+        {
+            if (!passWritten_) WritePass();
+            if (!Reserve()) return;
+            Put(Trace::Edge);
+            PutVarint(static_cast<uint64_t>(buttonId) * 2 + (down ? 1 : 0));
+        }
+
+        // end of a pass
+        void EndPass()
+        {
+            if (!passWritten_) ++run_;
+            lastMs_ = passMs_;
+        }
+
+        // write the pending run and End, hand the rest to the sink
+        // call once, after the last pass, writes nothing if no pass ran
+        void Finish();
+
+        // bytes written, counting those passed to the sink
+        uint64_t Bytes() const { return flushed_ + used_; }
+
+        // buffer filled without a sink, later passes were not recorded
+        bool Full() const { return full_; }
+
+        // a button was on a pin past Trace::MaxPorts, its levels are not
+        // in the trace and replay skips it
+        bool Untraced() const { return untraced_; }
+
+        // buffer contents not yet passed to the sink
+        const uint8_t* Data() const { return buffer_; }
+        size_t Size() const { return used_; }
+
+    private:
+        uint8_t* buffer_;
+        size_t size_;
+        size_t used_{ 0 };
+        uint64_t flushed_{ 0 };
+        Sink sink_;
+        void* user_;
+        bool full_{ false };
+        bool untraced_{ false };
+        bool headerWritten_{ false };
+
+        bool started_{ false };
+        bool passWritten_{ false };
+        uint64_t passMs_{ 0 };
+        uint64_t lastMs_{ 0 };
+        uint64_t periodMs_{ 0 };
+        uint64_t run_{ 0 };
+        uint64_t generation_{ ~0ULL };
+        uint32_t levels_[Trace::MaxPorts]{};
+
+        void WriteHeader(uint8_t debounceMs, uint8_t debouncerInterruptMs);
+        void WritePass();
+
+        // room for one record and the End, flushing to the sink if needed
+        bool Reserve(size_t bytes = Trace::MaxRecordBytes)
+        {
+            if (used_ + bytes < size_) return true;
+            return Flush(bytes);
+        }
+        bool Flush(size_t bytes);
+
+        void Put(uint8_t b) { buffer_[used_++] = b; }
+        void PutVarint(uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                Put(static_cast<uint8_t>(v | 0x80));
+                v >>= 7;
+            }
+            Put(static_cast<uint8_t>(v));
+        }
+    };
+
+    // Steps through a trace in memory (a buffer, or a mapped file) one
+    // sample pass at a time, runs expanded. Reads in place, no copies.
+    class TraceReader
+    {
+    public:
+        struct Edge
+        {
+            int buttonId;
+            bool down;
+        };
+
+        struct ButtonInfo
+        {
+            int buttonId;
+            int gpio;
+            bool downIsHigh;
+        };
+
+        TraceReader(const uint8_t* bytes, size_t size);
+
+        // header read, timings below are valid
+        bool Valid() const { return valid_; }
+        uint8_t DebounceMs() const { return debounceMs_; }
+        uint8_t DebouncerInterruptMs() const { return interruptMs_; }
+
+        // to the next pass, false at the end of the trace or a bad record
+        bool Next();
+
+        // bad record found, Next stopped there
+        bool Error() const { return error_; }
+
+        // the current pass
+        uint64_t NowMs() const { return nowMs_; }
+        uint32_t Levels(int port) const { return static_cast<unsigned>(port) < Trace::MaxPorts ? levels_[port] : 0; }
+        // raw level of a pin, gpio = 32 * port + pin, false if not Trace::Traced
+        bool Level(int gpio) const { return Trace::Traced(gpio) && ((levels_[gpio / 32] >> (gpio % 32)) & 1) != 0; }
+        // debounced edges recorded this pass
+        const std::vector<Edge>& Edges() const { return edges_; }
+        // buttons in use, LayoutChanged if this pass changed them
+        const std::vector<ButtonInfo>& Buttons() const { return buttons_; }
+        bool LayoutChanged() const { return layoutChanged_; }
+
+        // passes read so far
+        uint64_t Passes() const { return passes_; }
+
+    private:
+        const uint8_t* bytes_;
+        size_t size_;
+        size_t pos_{ 0 };
+        bool valid_{ false };
+        bool error_{ false };
+        bool started_{ false };
+        uint8_t debounceMs_{ 0 };
+        uint8_t interruptMs_{ 0 };
+
+        uint64_t nowMs_{ 0 };
+        uint64_t periodMs_{ 0 };
+        uint64_t runLeft_{ 0 };
+        uint64_t passes_{ 0 };
+        uint32_t levels_[Trace::MaxPorts]{};
+        std::vector<Edge> edges_;
+        std::vector<ButtonInfo> buttons_;
+        bool layoutChanged_{ false };
+
+        bool Varint(uint64_t& v);
+        bool Fail();
+    };
+
+}}
+
+#endif // SAMPLE_TRACE_H
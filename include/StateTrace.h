@@ -0,0 +1,160 @@
+#pragma once
+#ifndef STATE_TRACE_H
+#define STATE_TRACE_H
+
+// Lomont Button system
+// binary ring of FSM state changes, written by ButtonFSM::Update
+// Requires C++ 17
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+
+// state changes kept before the oldest is overwritten, power of 2
+#ifndef BUTTON_STATE_TRACE_SIZE
+#define BUTTON_STATE_TRACE_SIZE 256
+#endif
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // one arrow taken by a ButtonFSM
+    struct StateTraceRecord
+    {
+        // flags
+        static constexpr uint8_t InvalidAction = 1; // an action had an unknown code, skipped
+        static constexpr uint8_t StateReset = 2;    // arrow led outside the FSM, went to state 0
+        static constexpr uint8_t Table = 4;         // ran from a packed FSMTable
+
+        // bytes in the file format of ToBytes
+        static constexpr int Bytes = 12;
+
+        uint32_t timeMs{ 0 }; // low 32 bits of the update time
+        uint8_t buttonId{ 0 };
+        uint8_t pattern{ 0 }; // ButtonFSM::traceId
+        uint8_t fromState{ 0 };
+        uint8_t toState{ 0 };
+        uint8_t arrow{ 0 };   // index in fromState
+        uint8_t actions{ 0 }; // actions run
+        uint8_t flags{ 0 };
+
+        // little endian, the same on every platform, for host tools
+        void ToBytes(uint8_t* bytes) const
+        {
+            const uint8_t b[Bytes] = {
+                static_cast<uint8_t>(timeMs), static_cast<uint8_t>(timeMs >> 8),
+                static_cast<uint8_t>(timeMs >> 16), static_cast<uint8_t>(timeMs >> 24),
+                buttonId, pattern, fromState, toState, arrow, actions, flags, 0 };
+            for (auto i = 0; i < Bytes; ++i)
+                bytes[i] = b[i];
+        }
+
+        static StateTraceRecord FromBytes(const uint8_t* bytes)
+        {
+            StateTraceRecord r;
+            r.timeMs = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+            r.buttonId = bytes[4];
+            r.pattern = bytes[5];
+            r.fromState = bytes[6];
+            r.toState = bytes[7];
+            r.arrow = bytes[8];
+            r.actions = bytes[9];
+            r.flags = bytes[10];
+            return r;
+        }
+    };
+
+    // readable line for a record, as snprintf, for use off the update path
+    inline int FormatStateTrace(const StateTraceRecord& r, char* text, size_t size)
+    {
+        return snprintf(text, size, "%10u ms button %u pattern %u: state %u -> %u via arrow %u, %u actions%s%s%s",
+            r.timeMs, r.buttonId, r.pattern, r.fromState, r.toState, r.arrow, r.actions,
+            (r.flags & StateTraceRecord::InvalidAction) ? ", invalid action skipped" : "",
+            (r.flags & StateTraceRecord::StateReset) ? ", bad state, reset" : "",
+            (r.flags & StateTraceRecord::Table) ? ", table" : "");
+    }
+
+    // fixed size ring of state changes, newest overwrite oldest
+    // Write from one thread only (the pattern thread), Read from any
+    // thread at any time. Write is a release fence, three relaxed slot
+    // stores and a release of head, and never waits, so tracing can stay
+    // on in production. Needs only 32 bit atomics.
+    class StateTraceRing
+    {
+    public:
+        static constexpr uint32_t Capacity = BUTTON_STATE_TRACE_SIZE;
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+            "BUTTON_STATE_TRACE_SIZE must be a power of 2");
+
+        void Write(const StateTraceRecord& r)
+        {
+            const uint32_t n = head_.load(std::memory_order_relaxed);
+            auto& slot = slots_[n & (Capacity - 1)];
+            // a reader that sees these stores then sees head at least n, so the
+            // lap check in Read drops a slot caught mid write
+            std::atomic_thread_fence(std::memory_order_release);
+            slot[0].store(r.timeMs, std::memory_order_relaxed);
+            slot[1].store(r.buttonId | (r.pattern << 8) | (r.fromState << 16) |
+                (static_cast<uint32_t>(r.toState) << 24), std::memory_order_relaxed);
+            slot[2].store(r.arrow | (r.actions << 8) | (r.flags << 16), std::memory_order_relaxed);
+            head_.store(n + 1, std::memory_order_release);
+        }
+
+        // records written so far, wraps at 2^32
+        uint32_t Head() const { return head_.load(std::memory_order_acquire); }
+
+        // copy up to max records from cursor on into out, oldest first,
+        // advance cursor past them, return the number copied. Start with
+        // cursor 0, or Head() to skip what is there. Records overwritten
+        // before they were read are skipped and added to lost.
+        size_t Read(uint32_t& cursor, StateTraceRecord* out, size_t max, uint32_t* lost = nullptr) const
+        {
+            uint32_t missed = 0;
+            const uint32_t head = head_.load(std::memory_order_acquire);
+            if (head - cursor > Capacity)
+            {
+                missed += head - Capacity - cursor;
+                cursor = head - Capacity;
+            }
+            size_t count = head - cursor;
+            if (count > max) count = max;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& slot = slots_[(cursor + i) & (Capacity - 1)];
+                const uint32_t w0 = slot[0].load(std::memory_order_relaxed);
+                const uint32_t w1 = slot[1].load(std::memory_order_relaxed);
+                const uint32_t w2 = slot[2].load(std::memory_order_relaxed);
+                auto& r = out[i];
+                r.timeMs = w0;
+                r.buttonId = static_cast<uint8_t>(w1);
+                r.pattern = static_cast<uint8_t>(w1 >> 8);
+                r.fromState = static_cast<uint8_t>(w1 >> 16);
+                r.toState = static_cast<uint8_t>(w1 >> 24);
+                r.arrow = static_cast<uint8_t>(w2);
+                r.actions = static_cast<uint8_t>(w2 >> 8);
+                r.flags = static_cast<uint8_t>(w2 >> 16);
+            }
+
+            // the writer may have lapped the copy, drop slots it reached
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t after = head_.load(std::memory_order_relaxed);
+            const auto overwritten = static_cast<int32_t>(after - Capacity + 1 - cursor);
+            size_t bad = overwritten > 0 ? static_cast<size_t>(overwritten) : 0;
+            if (bad > count) bad = count;
+            for (size_t i = bad; i < count; ++i)
+                out[i - bad] = out[i];
+            missed += static_cast<uint32_t>(bad);
+
+            cursor += static_cast<uint32_t>(count);
+            if (lost) *lost += missed;
+            return count - bad;
+        }
+
+    private:
+        std::atomic<uint32_t> head_{ 0 };
+        std::atomic<uint32_t> slots_[Capacity][3]{};
+    };
+
+}}
+
+#endif // STATE_TRACE_H
@@ -0,0 +1,158 @@
+#pragma once
+#ifndef STATIC_BUTTONS_H
+#define STATIC_BUTTONS_H
+
+// Lomont Button system
+// fixed capacity buttons for targets with no heap after boot
+// Requires C++ 17
+
+// Button, FSMDef and ButtonFSM keep their parts in std::vector and buttons
+// are shared_ptrs. Here every size is a template parameter: patterns are
+// FSMTables in ROM (see EmitFSMTable and the fsm_tables example) run by
+// TableFSM, and buttons live in a std::array, so the whole set is one
+// object to place in static storage. Nothing in it allocates.
+//
+// RAM is known at compile time, StaticButtonSet::Ram() breaks it down.
+// Define BUTTON_RAM_BUDGET (bytes) to make any set larger than that a
+// build error, or check several sets together with FitsRamBudget.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "ButtonHelp.h"
+#include "ButtonFSMTable.h"
+
+// 0 for no limit
+#ifndef BUTTON_RAM_BUDGET
+#define BUTTON_RAM_BUDGET 0
+#endif
+
+namespace Lomont {
+
+    // the ButtonFSM of the no heap configuration
+    template<int MaxCounters = 4>
+    using StaticButtonFSM = ButtonHelpers::FSM::TableFSM<MaxCounters>;
+
+    // RAM used by a StaticButtonSet, all compile time constants
+    struct StaticRamReport
+    {
+        size_t fsmBytes;    // one pattern
+        size_t buttonBytes; // debouncer, pin and all pattern slots
+        size_t totalBytes;  // whole set
+    };
+
+    // MaxButtons buttons with up to MaxPatterns patterns each
+    template<int MaxButtons, int MaxPatterns, int MaxCounters = 4>
+    class StaticButtonSet
+    {
+    public:
+        using FSM = StaticButtonFSM<MaxCounters>;
+
+        StaticButtonSet()
+        {
+            static_assert(BUTTON_RAM_BUDGET == 0 || sizeof(StaticButtonSet) <= BUTTON_RAM_BUDGET,
+                "StaticButtonSet is larger than BUTTON_RAM_BUDGET");
+        }
+
+        // registered by address in interrupts, so no copies
+        StaticButtonSet(const StaticButtonSet&) = delete;
+        StaticButtonSet& operator=(const StaticButtonSet&) = delete;
+
+        static constexpr StaticRamReport Ram()
+        {
+            return StaticRamReport{ sizeof(FSM), sizeof(Slot), sizeof(StaticButtonSet) };
+        }
+
+        // add a button on gpio running the given tables, in pattern index order
+        // call at boot, before sampling starts
+        // returns the button index, or -1 and prints error if full
+        int Add(int gpioNum, bool downIsHigh, const ButtonHelpers::FSM::FSMTable* const* tables, int tableCount)
+        {
+            if (MaxButtons <= count_)
+            {
+                printf("ERROR - StaticButtonSet holds %d buttons\n", MaxButtons);
+                return -1;
+            }
+            if (tableCount < 0 || MaxPatterns < tableCount)
+            {
+                printf("ERROR - StaticButtonSet holds %d patterns per button, got %d\n", MaxPatterns, tableCount);
+                return -1;
+            }
+            auto& s = slots_[count_];
+            s.gpioNum = gpioNum;
+            s.downIsHigh = downIsHigh;
+            s.patternCount = static_cast<uint8_t>(tableCount);
+            for (auto i = 0; i < tableCount; ++i)
+                s.patterns[i] = FSM(tables[i]);
+            ButtonHelpers::ButtonHW::SetPinHardware(gpioNum, downIsHigh);
+            return count_++;
+        }
+
+        // call from the sampling interrupt, pinHigh reads one gpio level
+        // returns true if every button is settled, see Button::EndSamplePass
+        bool Sample(uint64_t elapsedMs, bool (*pinHigh)(int gpioNum))
+        {
+            bool settled = true;
+            for (auto i = 0; i < count_; ++i)
+            {
+                auto& s = slots_[i];
+                s.debouncer.DebounceInput(pinHigh(s.gpioNum) == s.downIsHigh, elapsedMs);
+                settled &= s.debouncer.Settled();
+            }
+            return settled;
+        }
+
+        // call often to look for button clicks, long presses, etc.
+        void UpdatePatternMatches(const ButtonHelpers::TickContext& tick = ButtonHelpers::TickContext())
+        {
+            for (auto i = 0; i < count_; ++i)
+            {
+                auto& s = slots_[i];
+                uint64_t changedMs;
+                const bool isDown = s.debouncer.IsDown(tick, &changedMs);
+                for (auto p = 0; p < s.patternCount; ++p)
+                    s.patterns[p].Update(i + 1, isDown, tick.AgeMs(changedMs), tick.nowMs);
+            }
+        }
+
+        // return counter from matches, clear counter, as HasPatterns::Clicks
+        int Clicks(int button, int patternIndex = 0, int counterIndex = 0)
+        {
+            if (button < 0 || count_ <= button || patternIndex < 0 || slots_[button].patternCount <= patternIndex)
+                return 0;
+            return slots_[button].patterns[patternIndex].Read0(counterIndex);
+        }
+
+        bool IsDown(int button) const
+        {
+            return 0 <= button && button < count_ && slots_[button].debouncer.IsDown();
+        }
+
+        int Count() const { return count_; }
+        int GpioNum(int button) const { return slots_[button].gpioNum; }
+
+    private:
+        struct Slot
+        {
+            Debouncer debouncer;
+            int gpioNum{ -1 };
+            bool downIsHigh{ true };
+            uint8_t patternCount{ 0 };
+            std::array<FSM, MaxPatterns> patterns{};
+        };
+
+        std::array<Slot, MaxButtons> slots_{};
+        int count_{ 0 };
+    };
+
+    // true if the sets fit in budgetBytes together, for static_assert
+    template<size_t budgetBytes, typename... Sets>
+    constexpr bool FitsRamBudget()
+    {
+        return (Sets::Ram().totalBytes + ... + 0) <= budgetBytes;
+    }
+
+}
+
+#endif //  STATIC_BUTTONS_H
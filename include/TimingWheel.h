@@ -0,0 +1,268 @@
+#pragma once
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+// Lomont Button system
+// hierarchical timing wheel for pattern deadlines
+// Requires C++ 17
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+namespace Lomont { namespace ButtonHelpers {
+
+    // a timer, embed in the object that owns the deadline
+    // intrusive, so arming and cancelling never allocate
+    struct WheelTimer
+    {
+        void* owner{ nullptr };    // user data, handed back on expiry
+        uint64_t deadlineMs{ 0 };
+
+        // wheel internals
+        WheelTimer* next{ nullptr };
+        WheelTimer* prev{ nullptr };
+        int8_t level{ -1 };        // -1 not armed
+        uint8_t slot{ 0 };
+    };
+
+    // Hashed hierarchical timing wheel, 1 ms ticks.
+    // Levels of 64 slots, level L slot spans 64^L ms, so 4 levels cover
+    // 2^24 ms (4.6 hours) with later deadlines parked in an overflow list.
+    // Arm and Cancel are O(1). Advance jumps over empty slots using an
+    // occupancy mask per level, so long idle gaps cost only a few steps.
+    class TimingWheel
+    {
+    public:
+        static constexpr int Levels = 4;
+        static constexpr int SlotBits = 6;
+        static constexpr int Slots = 1 << SlotBits;
+        static constexpr uint64_t Span = 1ULL << (Levels * SlotBits); // ms covered by wheel
+
+        explicit TimingWheel(uint64_t nowMs = 0) : currentMs_(nowMs) {}
+        TimingWheel(const TimingWheel&) = delete;
+        TimingWheel& operator=(const TimingWheel&) = delete;
+
+        // arm (or re-arm) a timer to expire at deadlineMs
+        // deadlines at or before the wheel time expire on the next Advance
+        void Arm(WheelTimer& timer, uint64_t deadlineMs)
+        {
+            Cancel(timer);
+            timer.deadlineMs = deadlineMs;
+            Insert(timer);
+            ++count_;
+        }
+
+        // cancel timer if armed
+        void Cancel(WheelTimer& timer)
+        {
+            if (timer.level < 0) return;
+            if (timer.prev)
+                timer.prev->next = timer.next;
+            else
+                ListHead(timer.level, timer.slot) = timer.next;
+            if (timer.next)
+                timer.next->prev = timer.prev;
+            if (timer.level < Levels && ListHead(timer.level, timer.slot) == nullptr)
+                occupied_[timer.level] &= ~(1ULL << timer.slot);
+            timer.next = timer.prev = nullptr;
+            timer.level = -1;
+            --count_;
+        }
+
+        // move wheel time to nowMs, appending expired timers to expired
+        // in deadline order. Expired timers are disarmed.
+        void Advance(uint64_t nowMs, std::vector<WheelTimer*>& expired)
+        {
+            TakeDue(expired); // deadlines already past when armed
+            while (count_ > 0)
+            {
+                const uint64_t t = NextEventMs();
+                if (t > nowMs) break;
+                currentMs_ = t;
+
+                // cascade levels whose slot boundary is t, top down
+                if ((t & (Span - 1)) == 0)
+                    Cascade(overflow_);
+                for (auto level = Levels - 1; level > 0; --level)
+                {
+                    if ((t & ((1ULL << (level * SlotBits)) - 1)) == 0)
+                    {
+                        const auto slot = static_cast<uint8_t>((t >> (level * SlotBits)) & (Slots - 1));
+                        WheelTimer*& head = slots_[level][slot];
+                        occupied_[level] &= ~(1ULL << slot);
+                        Cascade(head);
+                    }
+                }
+                TakeDue(expired);
+                const auto slot = static_cast<uint8_t>(t & (Slots - 1));
+                occupied_[0] &= ~(1ULL << slot);
+                TakeList(slots_[0][slot], expired);
+            }
+            if (currentMs_ < nowMs)
+                currentMs_ = nowMs;
+        }
+
+        // next time Advance has work to do, a cascade or an expiry
+        // may be earlier than the earliest deadline, never later
+        // ~0 if nothing armed
+        uint64_t NextEventMs() const
+        {
+            if (count_ == 0) return ~0ULL;
+            if (due_) return currentMs_;
+            uint64_t best = ~0ULL;
+            for (auto level = 0; level < Levels; ++level)
+            {
+                const int shift = level * SlotBits;
+                const auto cur = static_cast<int>((currentMs_ >> shift) & (Slots - 1));
+                // level 0 includes the current slot, higher levels are strictly ahead
+                const int first = level == 0 ? cur : cur + 1;
+                if (first >= Slots) continue;
+                const uint64_t ahead = occupied_[level] & (~0ULL << first);
+                if (!ahead) continue;
+                const int slot = LowestBit(ahead);
+                const uint64_t rotation = currentMs_ & ~((1ULL << (shift + SlotBits)) - 1);
+                const uint64_t t = rotation | (static_cast<uint64_t>(slot) << shift);
+                if (t < best) best = t;
+            }
+            if (overflow_)
+            {
+                const uint64_t t = (currentMs_ | (Span - 1)) + 1; // next wheel rotation
+                if (t < best) best = t;
+            }
+            return best;
+        }
+
+        // earliest armed deadline, ~0 if nothing armed
+        // lower levels always hold earlier deadlines than higher ones, so
+        // only the first occupied slot of the first non empty level is scanned
+        uint64_t NextDeadlineMs() const
+        {
+            if (count_ == 0) return ~0ULL;
+            if (due_) return currentMs_;
+            for (auto level = 0; level < Levels; ++level)
+            {
+                const auto cur = static_cast<int>((currentMs_ >> (level * SlotBits)) & (Slots - 1));
+                const uint64_t ahead = occupied_[level] & (~0ULL << cur);
+                if (ahead)
+                    return ListMin(slots_[level][LowestBit(ahead)]);
+            }
+            return ListMin(overflow_);
+        }
+
+        uint64_t NowMs() const { return currentMs_; }
+        size_t Count() const { return count_; }
+
+    private:
+        static int LowestBit(uint64_t v)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_ctzll(v);
+#else
+            int i = 0;
+            while ((v & 1) == 0) { v >>= 1; ++i; }
+            return i;
+#endif
+        }
+
+        static uint64_t ListMin(const WheelTimer* t)
+        {
+            uint64_t best = ~0ULL;
+            for (; t; t = t->next)
+                best = std::min(best, t->deadlineMs);
+            return best;
+        }
+
+        // place timer in level by how far its deadline is
+        void Insert(WheelTimer& timer)
+        {
+            const uint64_t d = timer.deadlineMs;
+            int level = Levels;   // overflow
+            uint8_t slot = 0;
+            if (d <= currentMs_)
+                level = Levels + 1;  // due
+            else
+            {
+                for (auto l = 0; l < Levels; ++l)
+                {
+                    const int shift = (l + 1) * SlotBits;
+                    if ((d >> shift) == (currentMs_ >> shift))
+                    {
+                        level = l;
+                        slot = static_cast<uint8_t>((d >> (l * SlotBits)) & (Slots - 1));
+                        break;
+                    }
+                }
+            }
+            WheelTimer*& head = ListHead(level, slot);
+            timer.level = static_cast<int8_t>(level);
+            timer.slot = slot;
+            timer.prev = nullptr;
+            timer.next = head;
+            if (head) head->prev = &timer;
+            head = &timer;
+            if (level < Levels)
+                occupied_[level] |= 1ULL << slot;
+        }
+
+        WheelTimer*& ListHead(int level, int slot)
+        {
+            if (level == Levels) return overflow_;
+            if (level == Levels + 1) return due_;
+            return slots_[level][slot];
+        }
+
+        // re-insert a list relative to the current time
+        void Cascade(WheelTimer*& head)
+        {
+            WheelTimer* t = head;
+            head = nullptr;
+            while (t)
+            {
+                WheelTimer* next = t->next;
+                Insert(*t);
+                t = next;
+            }
+        }
+
+        // due timers can have differing past deadlines, keep them ordered
+        void TakeDue(std::vector<WheelTimer*>& expired)
+        {
+            if (!due_) return;
+            const auto start = expired.size();
+            TakeList(due_, expired);
+            std::stable_sort(expired.begin() + start, expired.end(),
+                [](const WheelTimer* a, const WheelTimer* b) { return a->deadlineMs < b->deadlineMs; });
+        }
+
+        // move a list to expired, disarming each timer
+        void TakeList(WheelTimer*& head, std::vector<WheelTimer*>& expired)
+        {
+            const auto start = expired.size();
+            WheelTimer* t = head;
+            head = nullptr;
+            while (t)
+            {
+                WheelTimer* next = t->next;
+                t->next = t->prev = nullptr;
+                t->level = -1;
+                --count_;
+                expired.push_back(t);
+                t = next;
+            }
+            // lists are built by pushing to the front, restore arm order
+            for (auto i = start, j = expired.size(); i + 1 < j; ++i, --j)
+                std::swap(expired[i], expired[j - 1]);
+        }
+
+        uint64_t currentMs_;
+        size_t count_{ 0 };
+        WheelTimer* slots_[Levels][Slots]{};
+        uint64_t occupied_[Levels]{};
+        WheelTimer* overflow_{ nullptr }; // beyond the wheel span
+        WheelTimer* due_{ nullptr };      // deadline already passed when armed
+    };
+
+}}
+
+#endif //  TIMING_WHEEL_H
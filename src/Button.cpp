@@ -1,14 +1,16 @@
 #include <cstdio>
 #include <vector>
 #include <algorithm>
+#include <mutex>
+#include <thread>
 #include "Button.h"
+#include "ButtonFSMTable.h"
 
 
 /*
 TODO: 
 - make timing items more user-settable, unified, clean
 - make FSM smaller (template sizes?), list limitations
-- FSM builds to a table, exportable, useful as const in ROM
 - constexpr FSM
 - simplify FSM, only patterns used so far are u/d > some time
 - cleaner way to make patterns
@@ -25,25 +27,28 @@ using namespace std;
 using namespace Lomont::ButtonHelpers;
 using namespace Lomont;
 
-// these based on some empirical work
-// median up/down times 150ms, gaussian, std dev 120ms
-// so 1.5 std dev gives range of [60,240]
-// shhorten a little for faster clickers:
+// the default system's timings and hooks, in static storage so the
+// globals below refer to them before any constructor runs
+namespace {
+SystemTimings defaultTimings;
+SystemHooks defaultHooks;
+}
 
 // system timing items
-int ButtonTimings::clickUpLowMs = 40; // wait to start looking for down
-int ButtonTimings::clickUpHighMs = 210; // 
-int ButtonTimings::clickDownLowMs = 40; // length for min down click
-int ButtonTimings::clickDownHighMs = 210; // max down click
+uint8_t& ButtonTimings::debounceMs = defaultTimings.debounceMs;
+uint8_t& ButtonTimings::debouncerInterruptMs = defaultTimings.debouncerInterruptMs;
 
-int ButtonTimings::repeatClickDelayMs = 300; // repeat        
-int ButtonTimings::mediumPressMs = 600; // medium hold
-int ButtonTimings::longPressMs = 2500; // long hold
+int& ButtonTimings::clickUpLowMs = defaultTimings.clickUpLowMs;
+int& ButtonTimings::clickUpHighMs = defaultTimings.clickUpHighMs;
+int& ButtonTimings::clickDownLowMs = defaultTimings.clickDownLowMs;
+int& ButtonTimings::clickDownHighMs = defaultTimings.clickDownHighMs;
 
-// this can be set globally, preferably before any debouncers started
-uint8_t ButtonTimings::debounceMs = 5;
+int& ButtonTimings::repeatClickDelayMs = defaultTimings.repeatClickDelayMs;
+int& ButtonTimings::mediumPressMs = defaultTimings.mediumPressMs;
+int& ButtonTimings::longPressMs = defaultTimings.longPressMs;
 
-uint8_t ButtonTimings::debouncerInterruptMs = 1; // 1 ms default
+int& ButtonTimings::idleAfterMs = defaultTimings.idleAfterMs;
+int& ButtonTimings::idleSampleMs = defaultTimings.idleSampleMs;
 
 
 namespace {
@@ -51,47 +56,44 @@ namespace {
 
 /********************** default button patterns *****************************************/
 using namespace Lomont::ButtonHelpers::FSM;
-using namespace Lomont::ButtonHelpers::ButtonTimings;
-
-vector<FSMDef> defaultFSM;
 
 // add default click-N FSM
-void AddClickN_FSM()
+void AddClickN_FSM(vector<FSMDef>& defs, const PatternTimings& t)
 {
     // counter for hidden clicks, published clicks
-    auto & f = defaultFSM.emplace_back(2);
+    auto & f = defs.emplace_back(2);
 
     f.Build({
         State({
-            Arrow(1,false,clickUpLowMs),
+            Arrow(1,false,t.clickUpLowMs),
             }),
         
         State({
-            Arrow(2,true,clickDownLowMs,{
+            Arrow(2,true,t.clickDownLowMs,{
 				SetCounter(1,0)})}), // clear hidden counter 1
 
         State({
-        	Arrow(0,true,clickDownHighMs,{
+        	Arrow(0,true,t.clickDownHighMs,{
 				CopyCounter(0,1)}), // publish clicks
-			Arrow(3,false,clickUpLowMs,{
+			Arrow(3,false,t.clickUpLowMs,{
 				IncrementCounter(1)})}), // increment private click counter
 
         State({
-			Arrow(2,true,clickDownLowMs),
-            Arrow(0,false,clickUpHighMs,{
+			Arrow(2,true,t.clickDownLowMs),
+            Arrow(0,false,t.clickUpHighMs,{
 				CopyCounter(0,1)})})            
         });
 }
 
 // add default med or long click
-void AddClickLongerFSM(int minLenMs)
+void AddClickLongerFSM(vector<FSMDef>& defs, const PatternTimings& t, int minLenMs)
 {
     // single counter
-    auto & f = defaultFSM.emplace_back(1);
+    auto & f = defs.emplace_back(1);
 
     f.Build({
         State({
-        	Arrow(1,false,clickUpLowMs)}),
+        	Arrow(1,false,t.clickUpLowMs)}),
 
     	State({
 			Arrow(2,true,minLenMs,{
@@ -103,25 +105,25 @@ void AddClickLongerFSM(int minLenMs)
 }
 
 // add default repeat clicker
-void AddClickRepeatFSM()
+void AddClickRepeatFSM(vector<FSMDef>& defs, const PatternTimings& t)
 {
     // single counter
-    auto & f = defaultFSM.emplace_back(1);
+    auto & f = defs.emplace_back(1);
 
     // average click time
     const auto clickDelay =
-        (clickUpLowMs + clickDownLowMs +
-            clickUpHighMs + clickDownHighMs) / 2;
+        (t.clickUpLowMs + t.clickDownLowMs +
+            t.clickUpHighMs + t.clickDownHighMs) / 2;
 
     // clickUpLowMs
     f.Build({
         // state 0 - ensure up some time
         State({
-            Arrow(1,false,clickUpLowMs)}), 
+            Arrow(1,false,t.clickUpLowMs)}), 
 
         // state 1 - held long enough to trigger repeat
         State({
-            Arrow(2,true,repeatClickDelayMs,{
+            Arrow(2,true,t.repeatClickDelayMs,{
                 IncrementCounter(0)})}), // increment click counter
 
 		// state 2 - repeat click until button up
@@ -132,77 +134,779 @@ void AddClickRepeatFSM()
     });
 }
 
-void EnsureDefaultFSM()
+} // namespace
+
+/********************** button registry *****************************************/
+
+ButtonRegistry::ButtonRegistry()
 {
-    if (!defaultFSM.empty()) return; // already done
-    
-    // add default buttons
-    // AddClickFSM(); // single clicker lowest button
-    AddClickN_FSM(); // N clicker, lowest button
-    AddClickLongerFSM(mediumPressMs);
-    AddClickLongerFSM(longPressMs);
-    AddClickRepeatFSM();
+    readers_[0] = 0;
+    readers_[1] = 0;
+    current_ = new Snapshot();
 }
 
-// set up default button patterns
-void InitFSM(Button * b)
+ButtonRegistry::~ButtonRegistry()
 {
-    EnsureDefaultFSM();
+    delete current_.load();
+}
 
-    for (auto& fsmDef : defaultFSM)
-        b->patterns.emplace_back(&fsmDef); // add pattern
+void ButtonRegistry::Synchronize()
+{
+    // two epoch flips: a reader that read the epoch just before the first
+    // flip is counted in the other parity, caught by the second wait
+    for (auto phase = 0; phase < 2; ++phase)
+    {
+        const auto epoch = epoch_.fetch_add(1, std::memory_order_seq_cst);
+        while (readers_[epoch & 1].load(std::memory_order_seq_cst) != 0)
+            this_thread::yield();
+    }
 }
 
-// global next button
-int nextButtonId{1};
+void ButtonRegistry::Publish(unique_ptr<Snapshot> next)
+{
+    next->generation = current_.load()->generation + 1;
+    BuildPorts(*next);
+    BuildIndex(*next);
+    const Snapshot* old = current_.exchange(next.release(), std::memory_order_seq_cst);
+    Synchronize();
+    delete old;
+}
 
-} // namespace
+// group buttons by 32 pin port for Button::SamplePorts
+void ButtonRegistry::BuildPorts(Snapshot& snapshot)
+{
+    snapshot.ports.clear();
+    for (auto b : snapshot.buttons)
+    {
+        const int gpio = b->GpioNum();
+        if (gpio < 0)
+        {
+            printf("ERROR - invalid button gpio %d\n", gpio);
+            continue;
+        }
+        const int port = gpio / 32;
+        const uint32_t bit = 1U << (gpio % 32);
+
+        PortLayout* layout = nullptr;
+        for (auto& p : snapshot.ports)
+            if (p.port == port)
+                layout = &p;
+        if (!layout)
+        {
+            layout = &snapshot.ports.emplace_back();
+            layout->port = port;
+            // debouncer state outlives snapshots, one per port ever used
+            while (static_cast<int>(portStates_.size()) <= port)
+                portStates_.emplace_back(nullptr);
+            if (!portStates_[port])
+            {
+                portStates_[port] = make_unique<PortState>();
+                if (bankSamples_ > 0)
+                    portStates_[port]->bank.SetSamples(bankSamples_);
+            }
+            layout->state = portStates_[port].get();
+        }
+        if (layout->mask & bit)
+        { // one debouncer lane per pin, its edges go to every button on it
+            const int lane = gpio % 32;
+            layout->sharedMask |= bit;
+            layout->shared.push_back(SharedLane{ lane, b, b->DownIsHigh() != layout->lanes[lane]->DownIsHigh() });
+            continue;
+        }
+        layout->mask |= bit;
+        if (!b->DownIsHigh())
+            layout->downIsLow |= bit;
+        layout->lanes[gpio % 32] = b;
+    }
+}
+
+// sort buttons by id for ReadGuard::Find
+void ButtonRegistry::BuildIndex(Snapshot& snapshot)
+{
+    snapshot.byId = snapshot.buttons;
+    sort(snapshot.byId.begin(), snapshot.byId.end(),
+        [](const Button* a, const Button* b) { return a->buttonId < b->buttonId; });
+}
+
+Button* ButtonRegistry::ReadGuard::Find(int buttonId) const
+{
+    const auto& byId = snapshot_->byId;
+    const auto i = lower_bound(byId.begin(), byId.end(), buttonId,
+        [](const Button* b, int id) { return b->buttonId < id; });
+    return i != byId.end() && (*i)->buttonId == buttonId ? *i : nullptr;
+}
+
+RegistryHandle ButtonRegistry::Add(Button* button)
+{
+    lock_guard<mutex> lock(writeLock_);
+    RegistryHandle handle;
+    if (!freeSlots_.empty())
+    {
+        handle.slot = freeSlots_.back();
+        freeSlots_.pop_back();
+    }
+    else
+    {
+        handle.slot = static_cast<uint32_t>(generations_.size());
+        generations_.push_back(0);
+    }
+    handle.generation = ++generations_[handle.slot]; // odd = in use
+
+    auto next = make_unique<Snapshot>(*current_.load());
+    next->buttons.push_back(button);
+    next->slots.push_back(handle.slot);
+    Publish(std::move(next));
+    return handle;
+}
+
+void ButtonRegistry::Remove(RegistryHandle handle)
+{
+    lock_guard<mutex> lock(writeLock_);
+    if (generations_.size() <= handle.slot || generations_[handle.slot] != handle.generation)
+        return; // stale handle
+    ++generations_[handle.slot]; // even = free
+    freeSlots_.push_back(handle.slot);
+
+    auto next = make_unique<Snapshot>(*current_.load());
+    auto& slots = next->slots;
+    for (auto i = 0U; i < slots.size(); ++i)
+    {
+        if (slots[i] != handle.slot) continue;
+        // swap with last
+        next->buttons[i] = next->buttons.back();
+        slots[i] = slots.back();
+        next->buttons.pop_back();
+        slots.pop_back();
+        break;
+    }
+    Publish(std::move(next));
+}
+
+void ButtonRegistry::SetBankSamples(int samples)
+{
+    lock_guard<mutex> lock(writeLock_);
+    bankSamples_ = samples;
+}
+
+/********************** button systems *****************************************/
+
+// batched read hook, set by platform code if supported
+uint32_t (*&ButtonHW::ReadPins)(int port, uint32_t portMask) = defaultHooks.readPins;
+
+// adaptive sampling hooks, set by platform code if supported
+void (*&ButtonHW::SetSamplePeriodMs)(uint32_t periodMs) = defaultHooks.setSamplePeriodMs;
+bool (*&ButtonHW::ArmEdgeWakeup)(bool arm) = defaultHooks.armEdgeWakeup;
+
+// clock override, set by simulations and tests
+uint64_t (*&ButtonHW::ClockMs)() = defaultHooks.clockMs;
+
+ButtonSystem::ButtonSystem()
+    : timings_(&ownTimings_)
+    , hooks_(&ownHooks_)
+{
+}
+
+ButtonSystem::ButtonSystem(const SystemTimings& timings)
+    : ownTimings_(timings)
+    , timings_(&ownTimings_)
+    , hooks_(&ownHooks_)
+{
+}
+
+ButtonSystem::ButtonSystem(SystemTimings* timings, SystemHooks* hooks)
+    : timings_(timings)
+    , hooks_(hooks)
+    , isDefault_(true)
+{
+}
+
+ButtonSystem& ButtonSystem::Default()
+{
+    static ButtonSystem system(&defaultTimings, &defaultHooks);
+    return system;
+}
+
+bool ButtonSystem::SetNextButtonId(int id)
+{
+    if (id < nextButtonId_) return false;
+    nextButtonId_ = id;
+    return true;
+}
+
+// called from interrupt when Hooks().readPins is set
+void ButtonSystem::SamplePorts(uint64_t elapsedMs)
+{
+#if BUTTON_STATS
+    const uint32_t passStartNs = hooks_->nowNs ? hooks_->nowNs() : 0;
+#endif
+    const auto snapshot = buttonPtrs.Read();
+    auto* const recorder = hooks_->trace;
+    if (recorder && recorder->BeginPass(elapsedMs, snapshot.Generation(),
+        timings_->debounceMs, timings_->debouncerInterruptMs))
+    {
+        recorder->Layout(snapshot.size());
+        for (const auto& b : snapshot)
+            recorder->LayoutButton(b->buttonId, b->GpioNum(), b->DownIsHigh());
+    }
+    uint32_t anyChanged = 0;
+    bool settled = true;
+    for (auto& g : snapshot.Ports())
+    {
+        auto& st = *g.state;
+        if (st.layoutGeneration != snapshot.Generation())
+        { // buttons changed, restart lanes that have a new owner
+            uint32_t fresh = 0;
+            for (auto lane = 0; lane < 32; ++lane)
+            {
+                const int owner = g.lanes[lane] ? g.lanes[lane]->buttonId : 0;
+                if (st.owners[lane] != owner)
+                    fresh |= 1U << lane;
+                st.owners[lane] = owner;
+            }
+            st.bank.Reset(fresh);
+            st.layoutGeneration = snapshot.Generation();
+            // a button added to a pin in use starts from the lane's state
+            for (const auto& s : g.shared)
+            {
+                const bool isDown = (((st.bank.State() >> s.lane) & 1) != 0) != s.flip;
+                if (s.button->IsDown(TickContext(elapsedMs)) != isDown)
+                    s.button->SetDebounced(isDown, elapsedMs);
+            }
+        }
+
+        const uint32_t levels = hooks_->readPins(g.port, g.mask);
+        if (recorder)
+            recorder->Levels(g.port, levels & g.mask);
+        const uint32_t down = (levels ^ g.downIsLow) & g.mask;
+        uint32_t changed = st.bank.DebounceInput(down, elapsedMs);
+        anyChanged |= changed;
+        const uint32_t state = st.bank.State();
+        while (changed)
+        {
+            const int lane = LowestBitIndex(changed);
+            const bool isDown = ((state >> lane) & 1) != 0;
+            g.lanes[lane]->SetDebounced(isDown, elapsedMs);
+            if (recorder)
+                recorder->Edge(g.lanes[lane]->buttonId, isDown);
+            if (g.sharedMask & (1U << lane))
+                for (const auto& s : g.shared)
+                    if (s.lane == lane)
+                    {
+                        s.button->SetDebounced(isDown != s.flip, elapsedMs);
+                        if (recorder)
+                            recorder->Edge(s.button->buttonId, isDown != s.flip);
+                    }
+            changed &= changed - 1;
+        }
+        settled &= st.bank.Settled();
+    }
+    if (recorder)
+        recorder->EndPass();
+    if (anyChanged && hooks_->edgeWake)
+        hooks_->edgeWake();
+    EndSamplePass(settled, elapsedMs);
+#if BUTTON_STATS
+    if (hooks_->nowNs)
+    { // period the next pass comes at, as EndSamplePass left it
+        const auto rate = sampleRate_.load();
+        const int periodMs = rate == SampleRate::Stopped ? 0 :
+            rate == SampleRate::Slow ? timings_->idleSampleMs : timings_->debouncerInterruptMs;
+        stats.Pass(passStartNs, hooks_->nowNs(), static_cast<uint32_t>(periodMs));
+    }
+#endif
+}
+
+void ButtonSystem::EndSamplePass(bool settled, uint64_t elapsedMs)
+{
+    const auto setPeriod = hooks_->setSamplePeriodMs;
+    if (!setPeriod) return;
+    if (!settled || wakeRequested_.exchange(false))
+    { // input moving, sample at full rate
+        wasSettled_ = false;
+        if (sampleRate_.load() == SampleRate::Slow)
+        {
+            sampleRate_ = SampleRate::Full;
+            setPeriod(timings_->debouncerInterruptMs);
+        }
+        return;
+    }
+    if (!wasSettled_)
+    {
+        wasSettled_ = true;
+        settledSinceMs_ = elapsedMs;
+    }
+    if (sampleRate_.load() != SampleRate::Full || elapsedMs - settledSinceMs_ < static_cast<uint64_t>(timings_->idleAfterMs))
+        return;
+
+    if (hooks_->armEdgeWakeup && hooks_->armEdgeWakeup(true))
+    { // stop until a pin changes
+        setPeriod(0);
+        sampleRate_ = SampleRate::Stopped;
+        // a wake that came before the store saw Full and only left a request
+        if (wakeRequested_.exchange(false))
+            SamplerWake();
+    }
+    else if (timings_->idleSampleMs > timings_->debouncerInterruptMs)
+    {
+        sampleRate_ = SampleRate::Slow;
+        setPeriod(timings_->idleSampleMs);
+    }
+}
+
+void ButtonSystem::SamplerWake()
+{
+    if (!hooks_->setSamplePeriodMs) return;
+    auto expected = SampleRate::Stopped;
+    if (sampleRate_.compare_exchange_strong(expected, SampleRate::Full))
+    {
+        if (hooks_->armEdgeWakeup)
+            hooks_->armEdgeWakeup(false);
+        hooks_->setSamplePeriodMs(timings_->debouncerInterruptMs);
+    }
+    else
+        wakeRequested_ = true; // running, next pass goes to full rate
+}
+
+// sampling runs while any buttons exist
+void ButtonSystem::ButtonAdded()
+{
+    lock_guard<mutex> lock(samplingLock_);
+    if (!samplingRunning_)
+    {
+        sampleRate_ = SampleRate::Full;
+        wakeRequested_ = false;
+        wasSettled_ = false;
+#if BUTTON_STATS
+        stats.SamplingStarted(); // the stopped gap is not jitter
+#endif
+        if (isDefault_)
+            ButtonHW::StartDebouncerInterrupt();
+        else if (hooks_->startSampling)
+            hooks_->startSampling();
+        samplingRunning_ = true;
+    }
+    else
+        SamplerWake(); // sample the new pin at full rate
+}
+
+void ButtonSystem::ButtonRemoved()
+{
+    lock_guard<mutex> lock(samplingLock_);
+    if (samplingRunning_ && buttonPtrs.empty())
+    {
+        if (sampleRate_ == SampleRate::Stopped && hooks_->armEdgeWakeup)
+            hooks_->armEdgeWakeup(false);
+        if (isDefault_)
+            ButtonHW::StopDebouncerInterrupt();
+        else if (hooks_->stopSampling)
+            hooks_->stopSampling();
+        samplingRunning_ = false;
+    }
+}
+
+const vector<FSMDef>& ButtonSystem::DefaultPatterns()
+{
+    if (defaultPatterns_.empty())
+        defaultPatterns_ = Button::MakeDefaultPatterns(timings_->Patterns());
+    return defaultPatterns_;
+}
+
+const vector<FSMTable>& ButtonSystem::DefaultPatternTables()
+{
+    if (defaultTables_.empty())
+    {
+        vector<const FSMDef*> defs;
+        for (auto& d : DefaultPatterns())
+            defs.push_back(&d);
+        if (!CompileFSMSet(defs, tablePool_))
+            return defaultTables_; // empty
+        for (auto i = 0; i < tablePool_.Count(); ++i)
+            defaultTables_.push_back(tablePool_.Table(i));
+    }
+    return defaultTables_;
+}
+
+void ButtonSystem::UpdateAllPatternMatches(const TickContext& tick)
+{
+#if BUTTON_STATS
+    uint32_t updates = 0;
+    for (const auto& b : buttonPtrs.Read())
+    {
+        b->UpdatePatternMatches(tick);
+        updates += static_cast<uint32_t>(b->patterns.size());
+    }
+    stats.fsmUpdates.Add(updates);
+#else
+    for (const auto& b : buttonPtrs.Read())
+        b->UpdatePatternMatches(tick);
+#endif
+}
+
+uint64_t ButtonSystem::UpdateAllPatternEvents(uint64_t nowMs)
+{
+    // guard keeps buttons alive, Remove waits for it
+    const auto snapshot = buttonPtrs.Read();
+
+    // first call: buttons post edges from now on, earlier ones are caught
+    // up from the debounced state below, as after an overflow
+    const bool first = !eventsUsed_.load(std::memory_order_relaxed);
+    if (first)
+        eventsUsed_.store(true);
+
+    // each edge at its own time, deadlines before it run first
+    ButtonEdge edge;
+    while (edgeEvents.Pop(edge))
+    {
+        if (auto b = snapshot.Find(edge.buttonId))
+            b->ApplyPatternEvents(edge.down, edge.timeMs, edge.timeMs);
+    }
+
+    // queue overflowed, edges lost, catch up to the debounced state
+    if (edgeEvents.TakeDropped() != 0 || first)
+    {
+        for (const auto& b : snapshot)
+        {
+            uint64_t changedMs;
+            const bool isDown = b->IsDown(TickContext(nowMs), &changedMs);
+            if (b->events_.HasEdge(isDown, changedMs))
+                b->ApplyPatternEvents(isDown, changedMs, changedMs);
+        }
+    }
+
+    // buttons with due deadlines, in the state the patterns last saw
+    for (auto timer : patternScheduler_.Expire(nowMs))
+    {
+        auto b = static_cast<Button*>(timer->owner);
+        b->ApplyPatternEvents(b->events_.down, b->events_.changedMs, nowMs);
+    }
+    return patternScheduler_.NextDeadlineMs();
+}
 
-// buttons in play
-vector<Button*> Button::buttonPtrs;
+/********************** buttons *****************************************/
 
+// the default system's, as they were before systems
+ButtonRegistry& Button::buttonPtrs = ButtonSystem::Default().buttonPtrs;
+EdgeQueue& Button::edgeEvents = ButtonSystem::Default().edgeEvents;
+
+// edge wake hook, set by user code if needed
+void (*&Button::edgeWake)() = defaultHooks.edgeWake;
+
+// sample recorder, set by user code if needed
+ButtonHelpers::TraceRecorder*& Button::trace = defaultHooks.trace;
+
+bool Button::DebounceInput(bool buttonDown, uint64_t elapsedMs)
+{
+    const auto& t = *system_->timings_;
+    if (!Debouncer::DebounceInput(buttonDown, elapsedMs, t.debounceMs, t.debouncerInterruptMs))
+        return false;
+    system_->PostEdge(buttonId, buttonDown, elapsedMs);
+    return true;
+}
+
+void Button::SetDebounced(bool buttonDown, uint64_t elapsedMs)
+{
+    Debouncer::SetDebounced(buttonDown, elapsedMs);
+    system_->PostEdge(buttonId, buttonDown, elapsedMs);
+}
+
+bool Button::Settled() const
+{
+    const auto& t = *system_->timings_;
+    return Debouncer::Settled(t.debounceMs, t.debouncerInterruptMs);
+}
+
+void Button::SamplePorts(uint64_t elapsedMs)
+{
+    ButtonSystem::Default().SamplePorts(elapsedMs);
+}
+
+void Button::EndSamplePass(bool settled, uint64_t elapsedMs)
+{
+    ButtonSystem::Default().EndSamplePass(settled, elapsedMs);
+}
+
+void Button::SamplerWake()
+{
+    ButtonSystem::Default().SamplerWake();
+}
 
 Button::Button(int gpioNum, bool downIsHigh)
-    : buttonId(nextButtonId++)
+    : Button(ButtonSystem::Default(), gpioNum, downIsHigh)
+{
+}
+
+Button::Button(ButtonSystem& system, int gpioNum, bool downIsHigh)
+    : buttonId(system.nextButtonId_++)
+    , system_(&system)
     , gpioNum_(gpioNum)
     , downIsHigh_(downIsHigh)
 {
-    InitFSM(this);
-
-    // add button
-    // pause task, update internals, restart task
-    if (!buttonPtrs.empty())
-        ButtonHW::StopDebouncerInterrupt();
-    
-    buttonPtrs.push_back(this);
-    ButtonHW::SetPinHardware(gpioNum, downIsHigh);
-    ButtonHW::StartDebouncerInterrupt();
+    // set up default button patterns
+    for (auto& fsmDef : system.DefaultPatterns())
+        patterns.emplace_back(&fsmDef);
+    // patterns start evaluating at time 0, as UpdatePatternMatches does
+    system.patternScheduler_.Schedule(events_, this);
+
+    // add button, sampling keeps running
+    if (system.isDefault_)
+        ButtonHW::SetPinHardware(gpioNum, downIsHigh);
+    else if (system.hooks_->setPinHardware)
+        system.hooks_->setPinHardware(gpioNum, downIsHigh);
+    system.buttonPtrs.SetBankSamples(system.timings_->DebounceSamples());
+    registryHandle_ = system.buttonPtrs.Add(this);
+    system.ButtonAdded();
 }
 
 Button::~Button()
 {
-    // remove button
-    if (buttonPtrs.empty()) return;
+    // remove button, once done the interrupt no longer sees it
+    system_->buttonPtrs.Remove(registryHandle_);
+    system_->patternScheduler_.Cancel(events_);
+    ReleaseBank();
+
+    // interrupt stopped on last button gone
+    system_->ButtonRemoved();
+}
+
+void Button::UseBank(FSMBankSet& set, const vector<FSMTable>& tables)
+{
+    ReleaseBank();
+    patterns.clear();
+    bankSet = &set;
+    for (auto& t : tables)
+        banked.push_back(set.Add(&t, this, buttonId));
+}
 
-    // pause task, update internals, restart task
-    ButtonHW::StopDebouncerInterrupt();
+void Button::ReleaseBank()
+{
+    if (bankSet)
+        for (auto ref : banked)
+            bankSet->Remove(ref);
+    banked.clear();
+    bankSet = nullptr;
+}
+
+vector<FSMDef> Button::MakeDefaultPatterns(const PatternTimings& timings)
+{
+    vector<FSMDef> defs;
+    // AddClickFSM(); // single clicker lowest button
+    AddClickN_FSM(defs, timings); // N clicker, lowest button
+    AddClickLongerFSM(defs, timings, timings.mediumPressMs);
+    AddClickLongerFSM(defs, timings, timings.longPressMs);
+    AddClickRepeatFSM(defs, timings);
+    return defs;
+}
+
+const vector<FSMDef>& Button::DefaultPatterns()
+{
+    return ButtonSystem::Default().DefaultPatterns();
+}
 
-    buttonPtrs.erase(std::remove(buttonPtrs.begin(), buttonPtrs.end(), this), buttonPtrs.end());
-    if (!buttonPtrs.empty())
-        ButtonHW::StartDebouncerInterrupt();
+const vector<FSMTable>& Button::DefaultPatternTables()
+{
+    return ButtonSystem::Default().DefaultPatternTables();
 }
 
 // call often to look for button clicks, long presses, etc.
+bool Button::IsDown(uint64_t* stateChangeTimeMs) const
+{
+    return IsDownAt([this] { return system_->NowMs(); }, stateChangeTimeMs);
+}
+
 void Button::UpdatePatternMatches()
+{
+    UpdatePatternMatches(TickContext(system_->NowMs()));
+}
+
+void Button::UpdatePatternMatches(const TickContext& tick)
 {
     // current button state and info
     uint64_t timeStateChangedMs;
-    const bool isDown = IsDown(&timeStateChangedMs);
+    const bool isDown = IsDown(tick, &timeStateChangedMs);
+
+    const uint64_t stateTime = tick.AgeMs(timeStateChangedMs); // for Up/Down
+
+#if BUTTON_STATS
+    auto& stats = system_->stats;
+    for (auto i = 0U; i < patterns.size(); ++i)
+    {
+        auto& p = patterns[i];
+        const int before = p.Peek(0);
+        if (p.Update(buttonId, isDown, stateTime, tick.nowMs))
+            stats.Transition(static_cast<int>(i), p.Peek(0) > before, stateTime);
+    }
+#else
+    for (auto & p : patterns)
+        p.Update(buttonId, isDown, stateTime, tick.nowMs);
+#endif
+}
 
-    const uint64_t stateTime = ButtonHW::ElapsedMs() - timeStateChangedMs; // for Up/Down
+void Button::UpdateAllPatternMatches(const TickContext& tick)
+{
+    ButtonSystem::Default().UpdateAllPatternMatches(tick);
+}
 
-    for (auto & p : patterns)
-        p.Update(buttonId, isDown, stateTime);
+// event driven pattern update
+uint64_t Button::UpdatePatternEvents(uint64_t nowMs)
+{
+    uint64_t changedMs;
+    const bool isDown = IsDown(TickContext(nowMs), &changedMs);
+    return ApplyPatternEvents(isDown, changedMs, nowMs);
 }
 
+#if BUTTON_STATS
+namespace {
+    // PatternEvents step observer feeding ButtonStats
+    struct StatsSteps
+    {
+        static constexpr bool Enabled = true;
+        ButtonStats& stats;
+        void operator()(int pattern, bool matched, uint64_t stateMs) const
+        {
+            stats.Transition(pattern, matched, stateMs);
+        }
+    };
+}
+#endif
+
+uint64_t Button::ApplyPatternEvents(bool isDown, uint64_t changedMs, uint64_t nowMs)
+{
+#if BUTTON_STATS
+    events_.Update(buttonId, patterns, isDown, changedMs, nowMs, StatsSteps{ system_->stats });
+#else
+    events_.Update(buttonId, patterns, isDown, changedMs, nowMs);
+#endif
+    system_->patternScheduler_.Schedule(events_, this);
+    return events_.nextDeadlineMs;
+}
 
+uint64_t Button::UpdateAllPatternEvents(uint64_t nowMs)
+{
+    return ButtonSystem::Default().UpdateAllPatternEvents(nowMs);
+}
+
+/********************** multi button patterns *****************************************/
+
+void ButtonMultiPattern::UpdatePatternMatches()
+{
+    UpdatePatternMatches(TickContext(system_->NowMs()));
+}
+
+void ButtonMultiPattern::UpdatePatternMatches(const TickContext& tick)
+{
+    BuildDispatch();
+    for (const auto& b : system_->buttonPtrs.Read())
+    {
+        // each button state and info
+        uint64_t timeStateChangedMs;
+        const bool isDown = b->IsDown(tick, &timeStateChangedMs);
+
+        const uint64_t stateTime = tick.AgeMs(timeStateChangedMs); // for Up/Down
+
+        // copy, patterns moving state change the lists
+        const int id = b->buttonId;
+        visit_ = anyWatchers_;
+        if (0 <= id && id < static_cast<int>(watchers_.size()))
+            visit_.insert(visit_.end(), watchers_[id].begin(), watchers_[id].end());
+
+        for (auto p : visit_)
+        {
+#if BUTTON_STATS
+            const int before = patterns[p].Peek(0);
+#endif
+            if (patterns[p].Update(id, isDown, stateTime, tick.nowMs, indexes_[indexOf_[p]]))
+            {
+#if BUTTON_STATS
+                system_->stats.MultiTransition(p, patterns[p].Peek(0) > before, stateTime);
+#endif
+                Unwatch(p);
+                Watch(p);
+            }
+        }
+    }
+}
+
+void ButtonMultiPattern::BuildDispatch()
+{
+    bool same = indexedDefs_.size() == patterns.size();
+    for (auto i = 0U; same && i < patterns.size(); ++i)
+        same = indexedDefs_[i] == patterns[i].Def() && indexedTables_[i] == patterns[i].Table() &&
+            watchState_[i] == patterns[i].StateIndex();
+    if (same) return;
+
+    indexes_.clear();
+    indexedDefs_.clear();
+    indexedTables_.clear();
+    indexOf_.clear();
+    watchState_.clear();
+    watchers_.clear();
+    anyWatchers_.clear();
+    for (auto i = 0U; i < patterns.size(); ++i)
+    {
+        const FSMDef* def = patterns[i].Def();
+        int index = -1;
+        for (auto j = 0U; j < i && index < 0; ++j)
+            if (indexedDefs_[j] == def)
+                index = indexOf_[j];
+        if (index < 0)
+        {
+            index = static_cast<int>(indexes_.size());
+            indexes_.emplace_back(def ? *def : FSMDef(0));
+        }
+        indexedDefs_.push_back(def);
+        indexedTables_.push_back(patterns[i].Table());
+        indexOf_.push_back(index);
+        watchState_.push_back(0);
+        Watch(static_cast<int>(i));
+    }
+}
+
+void ButtonMultiPattern::Watch(int pattern)
+{
+    const int state = patterns[pattern].StateIndex();
+    watchState_[pattern] = state;
+    if (!patterns[pattern].Def())
+    { // packed table, or empty, not indexed
+        if (patterns[pattern].Table())
+            anyWatchers_.push_back(pattern);
+        return;
+    }
+    const auto& index = indexes_[indexOf_[pattern]];
+    if (index.HasWildcard(state))
+    { // any button can move it
+        anyWatchers_.push_back(pattern);
+        return;
+    }
+    for (auto id : index.ButtonIds(state))
+    {
+        if (id < 0) continue;
+        if (static_cast<int>(watchers_.size()) <= id)
+            watchers_.resize(id + 1);
+        watchers_[id].push_back(pattern);
+    }
+}
+
+void ButtonMultiPattern::Unwatch(int pattern)
+{
+    const auto remove = [pattern](vector<int>& list)
+    {
+        const auto i = find(list.begin(), list.end(), pattern);
+        if (i == list.end()) return;
+        *i = list.back();
+        list.pop_back();
+    };
+    if (!patterns[pattern].Def())
+    {
+        if (patterns[pattern].Table())
+            remove(anyWatchers_);
+        return;
+    }
+    const int state = watchState_[pattern];
+    const auto& index = indexes_[indexOf_[pattern]];
+    if (index.HasWildcard(state))
+        remove(anyWatchers_);
+    else
+        for (auto id : index.ButtonIds(state))
+            if (0 <= id && id < static_cast<int>(watchers_.size()))
+                remove(watchers_[id]);
+}
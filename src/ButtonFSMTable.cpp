@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "Button.h"
+#include "ButtonFSMTable.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+bool Fits(int v, int lo, int hi)
+{
+    return lo <= v && v <= hi;
+}
+
+// index of list in pool, appended if not already there
+size_t Pool(vector<PackedAction>& pool, const vector<PackedAction>& list)
+{
+    const auto same = [](const PackedAction& a, const PackedAction& b)
+    {
+        return a.action == b.action && a.q == b.q && a.p == b.p;
+    };
+    if (list.empty()) return 0;
+    const auto i = search(pool.begin(), pool.end(), list.begin(), list.end(), same);
+    if (i != pool.end())
+        return static_cast<size_t>(i - pool.begin());
+    pool.insert(pool.end(), list.begin(), list.end());
+    return pool.size() - list.size();
+}
+
+// add def to the arrays, its stateCount + 1 offsets to stateArrows
+bool Append(const FSMDef& def, vector<uint16_t>& stateArrows, vector<PackedArrow>& arrows, vector<PackedAction>& actions)
+{
+    const int stateCount = static_cast<int>(def.states_.size());
+    if (!Fits(stateCount, 1, 255) || !Fits(def.counters_, 0, 255))
+    {
+        printf("ERROR - FSM has %d states, %d counters, table needs 1-255 and 0-255\n", stateCount, def.counters_);
+        return false;
+    }
+
+    for (auto s = 0; s < stateCount; ++s)
+    {
+        stateArrows.push_back(static_cast<uint16_t>(arrows.size()));
+        for (auto& arrow : def.states_[s].arrows_)
+        {
+            if (!Fits(arrow.destState, 0, stateCount - 1) ||
+                !Fits(arrow.buttonId_, 0, 255) ||
+                !Fits(arrow.buttonAction, 0, 2) ||
+                !Fits(arrow.timeAction, 0, 3) ||
+                !Fits(arrow.timeBoundMs, 0, 65535) ||
+                !Fits(static_cast<int>(arrow.actions_.size()), 0, 255))
+            {
+                printf("ERROR - FSM state %d arrow %d does not fit table\n",
+                    s, static_cast<int>(arrows.size()) - stateArrows.back());
+                return false;
+            }
+
+            PackedArrow p{};
+            p.destState = static_cast<uint8_t>(arrow.destState);
+            p.buttonId = static_cast<uint8_t>(arrow.buttonId_);
+            p.match = static_cast<uint8_t>(arrow.buttonAction | (arrow.timeAction << 2));
+            p.actionCount = static_cast<uint8_t>(arrow.actions_.size());
+            p.timeBoundMs = static_cast<uint16_t>(arrow.timeBoundMs);
+            vector<PackedAction> list;
+            for (auto& action : arrow.actions_)
+            {
+                const bool pIsCounter = action.action == 3;
+                if (!Fits(action.action, 1, 4) ||
+                    !Fits(action.q, 0, def.counters_ - 1) ||
+                    (pIsCounter && !Fits(action.p, 0, def.counters_ - 1)) ||
+                    !Fits(action.p, -32768, 32767))
+                {
+                    printf("ERROR - invalid button action in FSM state %d\n", s);
+                    return false;
+                }
+                list.push_back(PackedAction{
+                    static_cast<uint8_t>(action.action),
+                    static_cast<uint8_t>(action.q),
+                    static_cast<int16_t>(action.p) });
+            }
+            p.firstAction = static_cast<uint16_t>(Pool(actions, list));
+            if (!Fits(static_cast<int>(actions.size()), 0, 65535) ||
+                !Fits(static_cast<int>(arrows.size()), 0, 65534))
+            {
+                printf("ERROR - FSM too large for table\n");
+                return false;
+            }
+            arrows.push_back(p);
+        }
+    }
+    stateArrows.push_back(static_cast<uint16_t>(arrows.size()));
+    return true;
+}
+
+}
+
+bool Lomont::ButtonHelpers::FSM::CompileFSM(const FSMDef& def, FSMTableStorage& table)
+{
+    table = FSMTableStorage();
+    table.counters = def.counters_;
+    return Append(def, table.stateArrows, table.arrows, table.actions);
+}
+
+bool Lomont::ButtonHelpers::FSM::CompileFSMSet(const vector<const FSMDef*>& defs, FSMTableSetStorage& set)
+{
+    set = FSMTableSetStorage();
+    for (auto def : defs)
+    {
+        set.firstState.push_back(static_cast<int>(set.stateArrows.size()));
+        if (!def || !Append(*def, set.stateArrows, set.arrows, set.actions))
+            return false;
+        set.counters.push_back(def->counters_);
+    }
+    set.firstState.push_back(static_cast<int>(set.stateArrows.size()));
+    return true;
+}
+
+void Lomont::ButtonHelpers::FSM::EmitFSMTable(const FSMTableStorage& table, const char* name, FILE* file)
+{
+    fprintf(file, "// %s: %d states, %d arrows, %d actions, %d counters, %d bytes\n",
+        name,
+        static_cast<int>(table.stateArrows.size()) - 1,
+        static_cast<int>(table.arrows.size()),
+        static_cast<int>(table.actions.size()),
+        table.counters,
+        static_cast<int>(table.Bytes()));
+
+    fprintf(file, "constexpr uint16_t %s_states[] = {", name);
+    for (auto i = 0U; i < table.stateArrows.size(); ++i)
+        fprintf(file, "%s%u", i ? ", " : " ", table.stateArrows[i]);
+    fprintf(file, " };\n");
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::PackedArrow %s_arrows[] = {\n", name);
+    for (auto& a : table.arrows)
+        fprintf(file, "    { %u, %u, 0x%02X, %u, %u, %u },\n",
+            a.destState, a.buttonId, a.match, a.actionCount, a.timeBoundMs, a.firstAction);
+    fprintf(file, "};\n");
+
+    // zero length arrays are not legal, keep one unused entry
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::PackedAction %s_actions[] = {\n", name);
+    for (auto& a : table.actions)
+        fprintf(file, "    { %u, %u, %d },\n", a.action, a.q, a.p);
+    if (table.actions.empty())
+        fprintf(file, "    { 0, 0, 0 },\n");
+    fprintf(file, "};\n");
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::FSMTable %s = { %d, %d, %s_states, %s_arrows, %s_actions };\n\n",
+        name,
+        static_cast<int>(table.stateArrows.size()) - 1,
+        table.counters,
+        name, name, name);
+}
+
+void Lomont::ButtonHelpers::FSM::EmitFSMTableSet(const FSMTableSetStorage& set, const char* poolName, const vector<const char*>& names, FILE* file)
+{
+    fprintf(file, "// %s: %d tables, %d arrows, %d pooled actions, %d bytes\n",
+        poolName, set.Count(),
+        static_cast<int>(set.arrows.size()),
+        static_cast<int>(set.actions.size()),
+        static_cast<int>(set.Bytes()));
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::PackedArrow %s_arrows[] = {\n", poolName);
+    for (auto& a : set.arrows)
+        fprintf(file, "    { %u, %u, 0x%02X, %u, %u, %u },\n",
+            a.destState, a.buttonId, a.match, a.actionCount, a.timeBoundMs, a.firstAction);
+    fprintf(file, "};\n");
+
+    // zero length arrays are not legal, keep one unused entry
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::PackedAction %s_actions[] = {\n", poolName);
+    for (auto& a : set.actions)
+        fprintf(file, "    { %u, %u, %d },\n", a.action, a.q, a.p);
+    if (set.actions.empty())
+        fprintf(file, "    { 0, 0, 0 },\n");
+    fprintf(file, "};\n");
+
+    for (auto i = 0; i < set.Count() && i < static_cast<int>(names.size()); ++i)
+    {
+        const auto table = set.Table(i);
+        fprintf(file, "constexpr uint16_t %s_states[] = {", names[i]);
+        for (auto s = 0; s <= table.stateCount; ++s)
+            fprintf(file, "%s%u", s ? ", " : " ", table.stateArrows[s]);
+        fprintf(file, " };\n");
+        fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::FSMTable %s = { %d, %d, %s_states, %s_arrows, %s_actions };\n",
+            names[i], table.stateCount, table.counterCount, names[i], poolName, poolName);
+    }
+    fprintf(file, "\n");
+}
+
+size_t Lomont::ButtonHelpers::FSM::DefBytes(const FSMDef& def)
+{
+    size_t bytes = sizeof(FSMDef) + def.states_.capacity() * sizeof(State);
+    for (auto& s : def.states_)
+    {
+        bytes += s.arrows_.capacity() * sizeof(Arrow);
+        for (auto& a : s.arrows_)
+            bytes += a.actions_.capacity() * sizeof(Action);
+    }
+    return bytes;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <vector>
+#include "FSMBank.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers;
+using namespace Lomont::ButtonHelpers::FSM;
+
+FSMBank::FSMBank(const FSMTable* table)
+    : table_(table)
+    , counterCount_(table ? table->counterCount : 0)
+{
+    const int states = table ? table->stateCount : 0;
+    hi1_.assign(states * 2, INT_MIN);
+    lo2_.assign(states * 2, INT_MAX);
+    lo3_.assign(states * 2, INT_MAX);
+    for (auto s = 0; s < states; ++s)
+    {
+        for (auto a = table->stateArrows[s]; a < table->stateArrows[s + 1]; ++a)
+        {
+            const PackedArrow& arrow = table->arrows[a];
+            for (auto down = 0; down < 2; ++down)
+            {
+                const int ba = arrow.ButtonAction();
+                if (ba != 0 && ba != (down ? 2 : 1))
+                    continue;
+                const int k = s * 2 + down;
+                switch (arrow.TimeAction())
+                {
+                case 1: hi1_[k] = max<int32_t>(hi1_[k], arrow.timeBoundMs); break;
+                case 2: lo2_[k] = min<int32_t>(lo2_[k], arrow.timeBoundMs); break;
+                case 3: lo3_[k] = min<int32_t>(lo3_[k], arrow.timeBoundMs); break;
+                default: lo2_[k] = INT_MIN; break; // untimed, may match any time
+                }
+            }
+        }
+    }
+}
+
+int FSMBank::Add(int buttonId)
+{
+    if (!table_)
+    { // no per state bounds for UpdateAll to read
+        printf("ERROR - FSMBank has no table, cannot add button %d\n", buttonId);
+        return -1;
+    }
+    int slot;
+    if (!free_.empty())
+    {
+        slot = free_.back();
+        free_.pop_back();
+    }
+    else
+    {
+        slot = Size();
+        state_.push_back(0);
+        stateChangedMs_.push_back(0);
+        buttonId_.push_back(0);
+        live_.push_back(0);
+        counters_.resize(counters_.size() + counterCount_);
+    }
+    state_[slot] = 0;
+    stateChangedMs_[slot] = 0;
+    buttonId_[slot] = buttonId;
+    live_[slot] = 1;
+    fill_n(counters_.begin() + slot * counterCount_, counterCount_, 0);
+    return slot;
+}
+
+void FSMBank::Remove(int slot)
+{
+    if (slot < 0 || Size() <= slot || !live_[slot]) return;
+    live_[slot] = 0;
+    free_.push_back(slot);
+}
+
+void FSMBank::UpdateAll(const uint8_t* down, const uint32_t* timeInStateMs, uint64_t nowMs)
+{
+    const int n = Size();
+    const auto now = static_cast<uint32_t>(nowMs);
+    due_.resize(n);
+
+    // branch free: list slots where some arrow could match
+    const uint8_t* state = state_.data();
+    const uint32_t* changed = stateChangedMs_.data();
+    const uint8_t* live = live_.data();
+    const int32_t* hi1 = hi1_.data();
+    const int32_t* lo2 = lo2_.data();
+    const int32_t* lo3 = lo3_.data();
+    uint32_t* due = due_.data();
+    int count = 0;
+    for (auto i = 0; i < n; ++i)
+    {
+        const int k = state[i] * 2 + down[i];
+        const auto tis = static_cast<int32_t>(timeInStateMs[i]);
+        const auto dt = static_cast<int32_t>(now - changed[i]);
+        const int may = (tis <= hi1[k]) | (tis >= lo2[k]) | (dt >= lo3[k]);
+        due[count] = static_cast<uint32_t>(i);
+        count += may & live[i];
+    }
+
+    for (auto j = 0; j < count; ++j)
+    {
+        const auto i = due[j];
+        Step(static_cast<int>(i), down[i] != 0, timeInStateMs[i], now);
+    }
+}
+
+bool FSMBank::Update(int slot, bool buttonDown, uint64_t timeInStateMs, uint64_t nowMs)
+{
+    if (slot < 0 || Size() <= slot || !live_[slot]) return false;
+    return Step(slot, buttonDown, static_cast<uint32_t>(timeInStateMs), static_cast<uint32_t>(nowMs));
+}
+
+bool FSMBank::Step(int slot, bool buttonDown, uint32_t timeInStateMs, uint32_t nowMs)
+{
+    const int s = state_[slot];
+    const uint32_t stateDt = nowMs - stateChangedMs_[slot];
+    const auto end = table_->stateArrows[s + 1];
+    for (auto a = table_->stateArrows[s]; a < end; ++a)
+    {
+        const PackedArrow& arrow = table_->arrows[a];
+        if (!arrow.Matches(buttonId_[slot], buttonDown, timeInStateMs, stateDt))
+            continue;
+        int32_t* counters = counters_.data() + slot * counterCount_;
+        const PackedAction* action = table_->actions + arrow.firstAction;
+        for (auto i = 0; i < arrow.actionCount; ++i, ++action)
+            action->DoAction(counters);
+        state_[slot] = arrow.destState;
+        stateChangedMs_[slot] = nowMs;
+        return true;
+    }
+    return false;
+}
+
+int FSMBank::Read0(int slot, int j)
+{
+    if (slot < 0 || Size() <= slot || j < 0 || counterCount_ <= j) return 0;
+    auto& c = counters_[slot * counterCount_ + j];
+    const int v = c;
+    c = 0;
+    return v;
+}
+
+BankRef FSMBankSet::Add(const FSMTable* table, const Debouncer* input, int buttonId)
+{
+    BankRef ref;
+    if (!table)
+    {
+        printf("ERROR - FSMBankSet given a null table for button %d\n", buttonId);
+        return ref;
+    }
+    for (auto b = 0; b < BankCount(); ++b)
+        if (banks_[b].Table() == table)
+            ref.bank = b;
+    if (ref.bank < 0)
+    {
+        ref.bank = BankCount();
+        banks_.emplace_back(table);
+        inputOf_.emplace_back();
+    }
+
+    // share the input with other instances of this debouncer
+    int k = static_cast<int>(find(inputs_.begin(), inputs_.end(), input) - inputs_.begin());
+    if (k == static_cast<int>(inputs_.size()))
+    {
+        k = static_cast<int>(find(inputs_.begin(), inputs_.end(), nullptr) - inputs_.begin());
+        if (k == static_cast<int>(inputs_.size()))
+        {
+            inputs_.push_back(nullptr);
+            inputUses_.push_back(0);
+        }
+        inputs_[k] = input;
+    }
+    ++inputUses_[k];
+
+    ref.slot = banks_[ref.bank].Add(buttonId);
+    auto& inputOf = inputOf_[ref.bank];
+    if (static_cast<int>(inputOf.size()) <= ref.slot)
+        inputOf.resize(ref.slot + 1, -1);
+    inputOf[ref.slot] = k;
+    return ref;
+}
+
+void FSMBankSet::Remove(BankRef ref)
+{
+    if (ref.bank < 0 || BankCount() <= ref.bank) return;
+    auto& inputOf = inputOf_[ref.bank];
+    if (ref.slot < 0 || static_cast<int>(inputOf.size()) <= ref.slot || inputOf[ref.slot] < 0) return;
+    const int input = inputOf[ref.slot];
+    inputOf[ref.slot] = -1;
+    if (--inputUses_[input] == 0)
+        inputs_[input] = nullptr;
+    banks_[ref.bank].Remove(ref.slot);
+}
+
+void FSMBankSet::Update(const TickContext& tick)
+{
+    // each debouncer read once
+    const auto inputCount = inputs_.size();
+    inputDown_.resize(inputCount);
+    inputTime_.resize(inputCount);
+    for (auto i = 0U; i < inputCount; ++i)
+    {
+        uint64_t changedMs = tick.nowMs;
+        inputDown_[i] = inputs_[i] && inputs_[i]->IsDown(tick, &changedMs) ? 1 : 0;
+        inputTime_[i] = static_cast<uint32_t>(tick.AgeMs(changedMs));
+    }
+
+    for (auto b = 0; b < BankCount(); ++b)
+    {
+        const auto& inputOf = inputOf_[b];
+        const int n = banks_[b].Size();
+        down_.resize(n);
+        time_.resize(n);
+        for (auto i = 0; i < n; ++i)
+        {
+            const int input = i < static_cast<int>(inputOf.size()) ? inputOf[i] : -1;
+            down_[i] = input < 0 ? 0 : inputDown_[input];
+            time_[i] = input < 0 ? 0 : inputTime_[input];
+        }
+        banks_[b].UpdateAll(down_.data(), time_.data(), tick.nowMs);
+    }
+}
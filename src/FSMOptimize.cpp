@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <vector>
+#include "FSMOptimize.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// one point in each cell where every arrow test of a def is constant
+class Grid
+{
+public:
+    explicit Grid(const FSMDef& def)
+    {
+        set<int> named;
+        vector<int64_t> timeCuts, stateCuts;
+        for (auto& s : def.states_)
+            for (auto& a : s.arrows_)
+            {
+                if (a.buttonId_ != 0) named.insert(a.buttonId_);
+                if (a.timeAction == 1) timeCuts.push_back(static_cast<int64_t>(a.timeBoundMs) + 1);
+                if (a.timeAction == 2) timeCuts.push_back(a.timeBoundMs);
+                if (a.timeAction == 3) stateCuts.push_back(a.timeBoundMs);
+            }
+        ids_.assign(named.begin(), named.end());
+        int other = -1; // any button no arrow names
+        while (named.count(other)) --other;
+        ids_.push_back(other);
+        times_ = Points(timeCuts);
+        stateTimes_ = Points(stateCuts);
+    }
+
+    size_t Size() const { return ids_.size() * 2 * times_.size() * stateTimes_.size(); }
+
+    bool Matches(const Arrow& arrow, size_t cell) const
+    {
+        const auto dt = stateTimes_[cell % stateTimes_.size()];
+        cell /= stateTimes_.size();
+        const auto tis = times_[cell % times_.size()];
+        cell /= times_.size();
+        const bool down = (cell & 1) != 0;
+        const int id = ids_[cell / 2];
+        return arrow.Matches(id, down, static_cast<uint64_t>(tis), static_cast<uint64_t>(dt));
+    }
+
+private:
+    // a value below the first cut, and each cut
+    static vector<int64_t> Points(vector<int64_t> cuts)
+    {
+        sort(cuts.begin(), cuts.end());
+        cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+        vector<int64_t> points;
+        points.push_back(cuts.empty() ? 0 : cuts[0] - 1);
+        points.insert(points.end(), cuts.begin(), cuts.end());
+        return points;
+    }
+
+    vector<int> ids_;
+    vector<int64_t> times_;
+    vector<int64_t> stateTimes_;
+};
+
+// destination as ButtonFSM takes it, out of range resets to 0
+int Dest(const FSMDef& def, const Arrow& arrow)
+{
+    const int d = arrow.destState;
+    return d < 0 || static_cast<int>(def.states_.size()) <= d ? 0 : d;
+}
+
+int ArrowCount(const FSMDef& def)
+{
+    int count = 0;
+    for (auto& s : def.states_)
+        count += static_cast<int>(s.arrows_.size());
+    return count;
+}
+
+// run def over trace as ButtonFSM does, returns arrows tested per update
+double Replay(const FSMDef& def, const FSMTrace& trace, vector<vector<uint64_t>>* counts)
+{
+    if (counts)
+    {
+        counts->clear();
+        for (auto& s : def.states_)
+            counts->emplace_back(s.arrows_.size(), 0);
+    }
+    if (def.states_.empty() || trace.empty()) return 0;
+    int state = 0;
+    uint64_t stateTimeChangedMs = 0, tested = 0;
+    for (auto& step : trace)
+    {
+        const auto& arrows = def.states_[state].arrows_;
+        for (auto i = 0U; i < arrows.size(); ++i)
+        {
+            ++tested;
+            if (arrows[i].Matches(step.buttonId, step.buttonDown, step.timeInStateMs, step.nowMs - stateTimeChangedMs))
+            {
+                if (counts) ++(*counts)[state][i];
+                state = Dest(def, arrows[i]);
+                stateTimeChangedMs = step.nowMs;
+                break;
+            }
+        }
+    }
+    return static_cast<double>(tested) / trace.size();
+}
+
+}
+
+vector<vector<uint64_t>> Lomont::ButtonHelpers::FSM::CountArrowMatches(const FSMDef& def, const FSMTrace& trace)
+{
+    vector<vector<uint64_t>> counts;
+    Replay(def, trace, &counts);
+    return counts;
+}
+
+bool Lomont::ButtonHelpers::FSM::SameOnTrace(const FSMDef& a, const FSMDef& b, const FSMTrace& trace, size_t* firstMismatch)
+{
+    if (firstMismatch) *firstMismatch = 0;
+    if (a.counters_ != b.counters_) return false;
+    ButtonFSM fa(&a), fb(&b);
+    for (auto i = 0U; i < trace.size(); ++i)
+    {
+        const auto& step = trace[i];
+        bool same = fa.Update(step.buttonId, step.buttonDown, step.timeInStateMs, step.nowMs) ==
+            fb.Update(step.buttonId, step.buttonDown, step.timeInStateMs, step.nowMs);
+        for (auto j = 0; j < a.counters_; ++j)
+            same &= fa.Read0(j) == fb.Read0(j);
+        if (!same)
+        {
+            if (firstMismatch) *firstMismatch = i;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Lomont::ButtonHelpers::FSM::OptimizeFSM(const FSMDef& def, FSMDef& optimized, OptimizeReport& report, const FSMTrace* trace)
+{
+    report = OptimizeReport();
+    const int n = static_cast<int>(def.states_.size());
+    report.statesBefore = n;
+    report.arrowsBefore = ArrowCount(def);
+    optimized = def;
+    if (n == 0)
+        return true;
+
+    // first arrow to match in each cell of each state, -1 for none
+    const Grid grid(def);
+    const size_t cells = grid.Size();
+    vector<vector<int>> first(n, vector<int>(cells, -1));
+    for (auto s = 0; s < n; ++s)
+    {
+        const auto& arrows = def.states_[s].arrows_;
+        for (auto c = 0U; c < cells; ++c)
+            for (auto i = 0U; i < arrows.size(); ++i)
+                if (grid.Matches(arrows[i], c))
+                {
+                    first[s][c] = static_cast<int>(i);
+                    break;
+                }
+    }
+    const auto destOf = [&](int s, int arrow) { return Dest(def, def.states_[s].arrows_[arrow]); };
+
+    // states reachable from 0 over arrows that can be taken, breadth first
+    vector<int> order{ 0 };
+    vector<bool> seen(n, false);
+    seen[0] = true;
+    for (auto i = 0U; i < order.size(); ++i)
+        for (auto a : first[order[i]])
+            if (a >= 0 && !seen[destOf(order[i], a)])
+            {
+                seen[destOf(order[i], a)] = true;
+                order.push_back(destOf(order[i], a));
+            }
+    report.unreachableStates = n - static_cast<int>(order.size());
+
+    // start with states split by the actions they do in each cell
+    map<vector<array<int, 3>>, int> actionIds;
+    vector<int> cls(n, -1);
+    size_t classCount = 0;
+    {
+        map<vector<int>, int> keys;
+        for (auto s : order)
+        {
+            vector<int> key(cells, -1);
+            for (auto c = 0U; c < cells; ++c)
+            {
+                if (first[s][c] < 0) continue;
+                vector<array<int, 3>> actions;
+                for (auto& act : def.states_[s].arrows_[first[s][c]].actions_)
+                    actions.push_back({ act.action, act.q, act.p });
+                key[c] = actionIds.emplace(actions, static_cast<int>(actionIds.size())).first->second;
+            }
+            cls[s] = keys.emplace(key, static_cast<int>(keys.size())).first->second;
+        }
+        classCount = keys.size();
+    }
+
+    // then split by the classes they move to until nothing splits
+    while (true)
+    {
+        map<vector<int>, int> keys;
+        vector<int> next(n, -1);
+        for (auto s : order)
+        {
+            vector<int> key{ cls[s] };
+            for (auto c = 0U; c < cells; ++c)
+                key.push_back(first[s][c] < 0 ? -1 : cls[destOf(s, first[s][c])]);
+            next[s] = keys.emplace(key, static_cast<int>(keys.size())).first->second;
+        }
+        cls = next;
+        const bool stable = keys.size() == classCount;
+        classCount = keys.size();
+        if (stable) break;
+    }
+    report.mergedStates = static_cast<int>(order.size() - classCount);
+
+    // number classes in reach order so state 0 stays 0, keep the state
+    // with fewest live arrows from each
+    vector<int> newIndex(classCount, -1), keep;
+    vector<set<int>> live(n);
+    for (auto s : order)
+    {
+        live[s].insert(first[s].begin(), first[s].end());
+        live[s].erase(-1);
+    }
+    for (auto s : order)
+    {
+        auto& k = newIndex[cls[s]];
+        if (k < 0)
+        {
+            k = static_cast<int>(keep.size());
+            keep.push_back(s);
+        }
+        else if (live[s].size() < live[keep[k]].size())
+            keep[k] = s;
+    }
+
+    FSMDef out(def.counters_);
+    for (auto s : keep)
+    {
+        out.AddState();
+        const auto& arrows = def.states_[s].arrows_;
+        for (auto i = 0; i < static_cast<int>(arrows.size()); ++i)
+        {
+            if (!live[s].count(i))
+            {
+                ++report.deadArrows;
+                continue;
+            }
+            out.states_.back().arrows_.push_back(arrows[i]);
+            out.states_.back().arrows_.back().destState = newIndex[cls[destOf(s, i)]];
+        }
+    }
+
+    if (trace)
+    {
+        // move often matched arrows ahead of neighbors they never overlap,
+        // then the first match is the same in every cell
+        const auto disjoint = [&](const Arrow& a, const Arrow& b)
+        {
+            for (auto c = 0U; c < cells; ++c)
+                if (grid.Matches(a, c) && grid.Matches(b, c))
+                    return false;
+            return true;
+        };
+        auto counts = CountArrowMatches(out, *trace);
+        for (auto s = 0U; s < out.states_.size(); ++s)
+        {
+            auto& arrows = out.states_[s].arrows_;
+            auto& count = counts[s];
+            for (auto i = 1U; i < arrows.size(); ++i)
+            {
+                auto j = i;
+                while (j > 0 && count[j] > count[j - 1] && disjoint(arrows[j], arrows[j - 1]))
+                {
+                    swap(arrows[j], arrows[j - 1]);
+                    swap(count[j], count[j - 1]);
+                    --j;
+                }
+                if (j < i) ++report.movedArrows;
+            }
+        }
+
+        report.traceSteps = trace->size();
+        report.arrowsTestedBefore = Replay(def, *trace, nullptr);
+        report.arrowsTestedAfter = Replay(out, *trace, nullptr);
+        size_t mismatch = 0;
+        report.verified = SameOnTrace(def, out, *trace, &mismatch);
+        if (!report.verified)
+        {
+            printf("ERROR - optimized FSM differs from original at trace step %zu\n", mismatch);
+            return false;
+        }
+    }
+
+    report.statesAfter = static_cast<int>(out.states_.size());
+    report.arrowsAfter = ArrowCount(out);
+    optimized = out;
+    return true;
+}
+
+void Lomont::ButtonHelpers::FSM::PrintOptimizeReport(const OptimizeReport& report, const char* name, FILE* file)
+{
+    fprintf(file, "%s: states %d -> %d (%d unreachable, %d merged), arrows %d -> %d (%d dead), %d moved\n",
+        name, report.statesBefore, report.statesAfter, report.unreachableStates, report.mergedStates,
+        report.arrowsBefore, report.arrowsAfter, report.deadArrows, report.movedArrows);
+    if (report.traceSteps > 0)
+        fprintf(file, "    trace %zu steps: %.3f -> %.3f arrows tested per update, %s\n",
+            report.traceSteps, report.arrowsTestedBefore, report.arrowsTestedAfter,
+            report.verified ? "same behavior" : "DIFFERENT behavior");
+}
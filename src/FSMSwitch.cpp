@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <string>
+#include "FSMSwitch.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// condition of arrow, "true" if it matches anything
+string Condition(const Arrow& arrow)
+{
+    string c;
+    const auto add = [&c](const string& term)
+    {
+        if (!c.empty()) c += " && ";
+        c += term;
+    };
+    if (arrow.buttonId_ != 0)
+        add("buttonId == " + to_string(arrow.buttonId_));
+    if (arrow.buttonAction == 1)
+        add("!buttonDown");
+    else if (arrow.buttonAction == 2)
+        add("buttonDown");
+    if (arrow.timeAction == 1)
+        add("buttonMs <= " + to_string(arrow.timeBoundMs));
+    else if (arrow.timeAction == 2)
+        add("buttonMs >= " + to_string(arrow.timeBoundMs));
+    else if (arrow.timeAction == 3)
+        add("stateMs >= " + to_string(arrow.timeBoundMs));
+    return c.empty() ? "true" : c;
+}
+
+bool ValidCounter(const FSMDef& def, int counter)
+{
+    return 0 <= counter && counter < def.counters_;
+}
+
+}
+
+bool Lomont::ButtonHelpers::FSM::EmitFSMSwitch(const FSMDef& def, const char* name, FILE* file)
+{
+    const int stateCount = static_cast<int>(def.states_.size());
+    if (stateCount == 0)
+    {
+        printf("ERROR - FSM %s has no states\n", name);
+        return false;
+    }
+
+    // check everything before writing
+    int arrowCount = 0;
+    bool usesId = false, usesDown = false, usesButtonTime = false, usesStateTime = false;
+    for (auto s = 0; s < stateCount; ++s)
+    {
+        for (auto& arrow : def.states_[s].arrows_)
+        {
+            ++arrowCount;
+            usesId |= arrow.buttonId_ != 0;
+            usesDown |= arrow.buttonAction != 0;
+            usesButtonTime |= arrow.timeAction == 1 || arrow.timeAction == 2;
+            usesStateTime |= arrow.timeAction == 3;
+            for (auto& action : arrow.actions_)
+            {
+                const bool ok = 1 <= action.action && action.action <= 4 &&
+                    ValidCounter(def, action.q) &&
+                    (action.action != 3 || ValidCounter(def, action.p));
+                if (!ok)
+                {
+                    printf("ERROR - invalid button action in FSM %s state %d\n", name, s);
+                    return false;
+                }
+            }
+        }
+    }
+
+    fprintf(file, "// %s: %d states, %d arrows, %d counters\n", name, stateCount, arrowCount, def.counters_);
+    fprintf(file, "struct %s : Lomont::ButtonHelpers::FSM::SwitchFSM<%d>\n{\n", name, def.counters_);
+    fprintf(file, "    bool Update(%sint buttonId, %sbool buttonDown, %suint64_t timeInStateMs, uint64_t nowMs)\n    {\n",
+        usesId ? "" : "[[maybe_unused]] ",
+        usesDown ? "" : "[[maybe_unused]] ",
+        usesButtonTime ? "" : "[[maybe_unused]] ");
+    // same int comparisons as Arrow::Matches
+    if (usesButtonTime)
+        fprintf(file, "        const int buttonMs = static_cast<int>(timeInStateMs);\n");
+    if (usesStateTime)
+        fprintf(file, "        const int stateMs = static_cast<int>(nowMs - stateChangedMs_);\n");
+    fprintf(file, "        switch (state_)\n        {\n");
+
+    for (auto s = 0; s < stateCount; ++s)
+    {
+        fprintf(file, "        case %d:\n", s);
+        for (auto& arrow : def.states_[s].arrows_)
+        {
+            // out of range goes to 0, as ButtonFSM
+            const int dest = 0 <= arrow.destState && arrow.destState < stateCount ? arrow.destState : 0;
+            fprintf(file, "            if (%s)\n            {\n", Condition(arrow).c_str());
+            for (auto& a : arrow.actions_)
+            {
+                if (a.action == 1)
+                    fprintf(file, "                counters_[%d] += %d;\n", a.q, a.p);
+                else if (a.action == 2)
+                    fprintf(file, "                counters_[%d] -= %d;\n", a.q, a.p);
+                else if (a.action == 3)
+                    fprintf(file, "                counters_[%d] = counters_[%d];\n", a.q, a.p);
+                else
+                    fprintf(file, "                counters_[%d] = %d;\n", a.q, a.p);
+            }
+            fprintf(file, "                return Go(%d, nowMs);\n            }\n", dest);
+        }
+        fprintf(file, "            return false;\n");
+    }
+    fprintf(file, "        default:\n            return false;\n        }\n    }\n};\n\n");
+    return true;
+}
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <map>
+#include <vector>
+#include "Button.h"
+#include "ProductFSM.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers::FSM;
+
+namespace {
+
+// what one pattern does in one cell of a product state
+struct PatternChoice
+{
+    vector<int> timed;  // state time arrows that can match, in order
+    int final{ -1 };    // first arrow that surely matches, -1 none
+};
+
+// start of button time intervals in a product state
+// ta1 (time <= b) flips after b, ta2 (time >= b) flips at b
+vector<uint32_t> Cuts(const vector<FSMTableStorage>& tables, const vector<int>& states)
+{
+    vector<uint32_t> cuts;
+    for (auto p = 0U; p < tables.size(); ++p)
+    {
+        const auto& t = tables[p];
+        for (auto a = t.stateArrows[states[p]]; a < t.stateArrows[states[p] + 1]; ++a)
+        {
+            const auto& arrow = t.arrows[a];
+            if (arrow.TimeAction() == 1)
+                cuts.push_back(arrow.timeBoundMs + 1U);
+            else if (arrow.TimeAction() == 2)
+                cuts.push_back(arrow.timeBoundMs);
+        }
+    }
+    sort(cuts.begin(), cuts.end());
+    cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+    return cuts;
+}
+
+PatternChoice Choose(const FSMTableStorage& t, int state, bool down, int64_t tis)
+{
+    PatternChoice choice;
+    for (auto a = t.stateArrows[state]; a < t.stateArrows[state + 1]; ++a)
+    {
+        const auto& arrow = t.arrows[a];
+        const int ba = arrow.ButtonAction();
+        if (ba != 0 && ba != (down ? 2 : 1))
+            continue;
+        const int ta = arrow.TimeAction();
+        if (ta == 1 && tis > arrow.timeBoundMs) continue;
+        if (ta == 2 && tis < arrow.timeBoundMs) continue;
+        if (ta == 3)
+        {
+            choice.timed.push_back(a);
+            continue;
+        }
+        choice.final = a;
+        break;
+    }
+    return choice;
+}
+
+}
+
+bool Lomont::ButtonHelpers::FSM::CompileProduct(const vector<const FSMDef*>& defs, ProductTableStorage& table)
+{
+    table = ProductTableStorage();
+    const int n = static_cast<int>(defs.size());
+    if (n < 1 || 16 < n)
+    {
+        printf("ERROR - product needs 1 to 16 patterns, got %d\n", n);
+        return false;
+    }
+
+    // each pattern as a checked flat table
+    vector<FSMTableStorage> tables(n);
+    table.counterOffsets.push_back(0);
+    for (auto p = 0; p < n; ++p)
+    {
+        if (!defs[p] || !CompileFSM(*defs[p], tables[p]))
+            return false;
+        for (auto& arrow : tables[p].arrows)
+        {
+            if (arrow.buttonId != 0)
+            {
+                printf("ERROR - product pattern %d names button %d, only per button patterns merge\n", p, arrow.buttonId);
+                return false;
+            }
+        }
+        table.counterOffsets.push_back(static_cast<uint16_t>(table.counterOffsets.back() + tables[p].counters));
+    }
+    table.patternCount = n;
+
+    // reachable product states, breadth first from all patterns in state 0
+    map<vector<int>, int> stateIds;
+    vector<vector<int>> states;
+    const auto stateId = [&](const vector<int>& s)
+    {
+        const auto i = stateIds.find(s);
+        if (i != stateIds.end()) return i->second;
+        const int id = static_cast<int>(states.size());
+        stateIds.emplace(s, id);
+        states.push_back(s);
+        return id;
+    };
+    stateId(vector<int>(n, 0));
+
+    for (auto s = 0U; s < states.size(); ++s)
+    {
+        if (65535 <= s)
+        {
+            printf("ERROR - product has more than 65535 states\n");
+            return false;
+        }
+        const vector<int> current = states[s]; // copy, states grows
+
+        table.stateCuts.push_back(static_cast<uint16_t>(table.cuts.size()));
+        table.stateCells.push_back(static_cast<uint32_t>(table.cells.size()));
+        for (auto p = 0; p < n; ++p)
+            table.patternStates.push_back(static_cast<uint8_t>(current[p]));
+
+        const auto cuts = Cuts(tables, current);
+        table.cuts.insert(table.cuts.end(), cuts.begin(), cuts.end());
+
+        for (auto down = 0; down < 2; ++down)
+        {
+            for (auto interval = 0U; interval <= cuts.size(); ++interval)
+            {
+                // any button time in the interval decides the same arrows
+                const int64_t tis = interval == 0
+                    ? (cuts.empty() ? 0 : static_cast<int64_t>(cuts[0]) - 1)
+                    : cuts[interval - 1];
+
+                vector<PatternChoice> choices(n);
+                ProductCell cell{};
+                cell.firstTest = static_cast<uint16_t>(table.tests.size());
+                cell.firstLeaf = static_cast<uint32_t>(table.leaves.size());
+                uint32_t leafCount = 1;
+                for (auto p = 0; p < n; ++p)
+                {
+                    choices[p] = Choose(tables[p], current[p], down != 0, tis);
+                    const auto& timed = choices[p].timed;
+                    if (timed.empty()) continue;
+                    if (255 < timed.size())
+                    {
+                        printf("ERROR - product pattern %d state %d has too many state time arrows\n", p, current[p]);
+                        return false;
+                    }
+                    ProductTest test{};
+                    test.pattern = static_cast<uint8_t>(p);
+                    test.count = static_cast<uint8_t>(timed.size());
+                    test.firstBound = static_cast<uint16_t>(table.bounds.size());
+                    for (auto a : timed)
+                        table.bounds.push_back(tables[p].arrows[a].timeBoundMs);
+                    table.tests.push_back(test);
+                    ++cell.testCount;
+                    leafCount *= static_cast<uint32_t>(timed.size() + 1);
+                }
+                table.cells.push_back(cell);
+
+                // one leaf per combination of test outcomes, last test varies fastest
+                for (auto leafIndex = 0U; leafIndex < leafCount; ++leafIndex)
+                {
+                    vector<int> next = current;
+                    ProductLeaf leaf{};
+                    leaf.firstAction = static_cast<uint16_t>(table.actions.size());
+                    uint32_t rest = leafIndex;
+                    vector<int> outcome(n, 0);
+                    for (auto i = cell.testCount - 1; i >= 0; --i)
+                    {
+                        const auto& test = table.tests[cell.firstTest + i];
+                        outcome[test.pattern] = static_cast<int>(rest % (test.count + 1U));
+                        rest /= test.count + 1U;
+                    }
+                    for (auto p = 0; p < n; ++p)
+                    {
+                        const auto& choice = choices[p];
+                        const int o = outcome[p];
+                        const int a = o < static_cast<int>(choice.timed.size()) ? choice.timed[o] : choice.final;
+                        if (a < 0) continue; // no arrow taken
+                        const auto& arrow = tables[p].arrows[a];
+                        next[p] = arrow.destState;
+                        leaf.changedMask |= static_cast<uint16_t>(1U << p);
+                        const int offset = table.counterOffsets[p];
+                        for (auto i = 0; i < arrow.actionCount; ++i)
+                        {
+                            PackedAction action = tables[p].actions[arrow.firstAction + i];
+                            action.q = static_cast<uint8_t>(action.q + offset);
+                            if (action.action == 3)
+                                action.p = static_cast<int16_t>(action.p + offset);
+                            if (255 < action.q + 0 || (action.action == 3 && 255 < action.p))
+                            {
+                                printf("ERROR - product has more than 256 counters\n");
+                                return false;
+                            }
+                            table.actions.push_back(action);
+                        }
+                    }
+                    const auto actionCount = table.actions.size() - leaf.firstAction;
+                    if (65535 < table.actions.size() || 65535 < actionCount)
+                    {
+                        printf("ERROR - product has too many actions\n");
+                        return false;
+                    }
+                    leaf.actionCount = static_cast<uint16_t>(actionCount);
+                    leaf.next = static_cast<uint16_t>(stateId(next));
+                    table.leaves.push_back(leaf);
+                }
+            }
+        }
+    }
+    table.stateCuts.push_back(static_cast<uint16_t>(table.cuts.size()));
+    table.stateCells.push_back(static_cast<uint32_t>(table.cells.size()));
+    if (65535 < table.cuts.size() || 65535 < table.tests.size() || 65535 < table.bounds.size())
+    {
+        printf("ERROR - product table too large\n");
+        return false;
+    }
+    return true;
+}
+
+void Lomont::ButtonHelpers::FSM::EmitProductTable(const ProductTableStorage& table, const char* name, FILE* file)
+{
+    const auto list = [file](const char* type, const char* name, const char* suffix, auto& values)
+    {
+        fprintf(file, "constexpr %s %s_%s[] = {", type, name, suffix);
+        for (auto i = 0U; i < values.size(); ++i)
+            fprintf(file, "%s%s%u", i ? "," : "", (i % 16) ? " " : "\n    ", static_cast<unsigned>(values[i]));
+        if (values.empty())
+            fprintf(file, " 0"); // zero length arrays are not legal
+        fprintf(file, "\n};\n");
+    };
+
+    fprintf(file, "// %s: %d patterns, %d states, %d cells, %d leaves, %d actions, %d bytes\n",
+        name, table.patternCount, table.StateCount(),
+        static_cast<int>(table.cells.size()), static_cast<int>(table.leaves.size()),
+        static_cast<int>(table.actions.size()), static_cast<int>(table.Bytes()));
+    list("uint16_t", name, "counterOffsets", table.counterOffsets);
+    list("uint8_t", name, "patternStates", table.patternStates);
+    list("uint16_t", name, "stateCuts", table.stateCuts);
+    list("uint32_t", name, "cuts", table.cuts);
+    list("uint32_t", name, "stateCells", table.stateCells);
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::ProductCell %s_cells[] = {\n", name);
+    for (auto& c : table.cells)
+        fprintf(file, "    { %u, %u, %u },\n", c.firstTest, c.testCount, c.firstLeaf);
+    fprintf(file, "};\n");
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::ProductTest %s_tests[] = {\n", name);
+    for (auto& t : table.tests)
+        fprintf(file, "    { %u, %u, %u },\n", t.pattern, t.count, t.firstBound);
+    if (table.tests.empty())
+        fprintf(file, "    { 0, 0, 0 },\n");
+    fprintf(file, "};\n");
+
+    list("uint16_t", name, "bounds", table.bounds);
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::ProductLeaf %s_leaves[] = {\n", name);
+    for (auto& l : table.leaves)
+        fprintf(file, "    { %u, 0x%04X, %u, %u },\n", l.next, l.changedMask, l.firstAction, l.actionCount);
+    fprintf(file, "};\n");
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::PackedAction %s_actions[] = {\n", name);
+    for (auto& a : table.actions)
+        fprintf(file, "    { %u, %u, %d },\n", a.action, a.q, a.p);
+    if (table.actions.empty())
+        fprintf(file, "    { 0, 0, 0 },\n");
+    fprintf(file, "};\n");
+
+    fprintf(file, "constexpr Lomont::ButtonHelpers::FSM::ProductTable %s = { %d, %d, %u,\n"
+        "    %s_counterOffsets, %s_patternStates, %s_stateCuts, %s_cuts, %s_stateCells,\n"
+        "    %s_cells, %s_tests, %s_bounds, %s_leaves, %s_actions };\n\n",
+        name, table.patternCount, table.StateCount(),
+        static_cast<unsigned>(table.counterOffsets.back()),
+        name, name, name, name, name, name, name, name, name, name);
+}
@@ -0,0 +1,227 @@
+#include <cstdio>
+#include "SampleTrace.h"
+
+using namespace std;
+using namespace Lomont::ButtonHelpers;
+
+TraceRecorder::TraceRecorder(uint8_t* buffer, size_t size, Sink sink, void* user)
+    : buffer_(buffer)
+    , size_(size)
+    , sink_(sink)
+    , user_(user)
+{
+}
+
+void TraceRecorder::WriteHeader(uint8_t debounceMs, uint8_t debouncerInterruptMs)
+{
+    headerWritten_ = true;
+    if (!Reserve(6)) return;
+    Put('L');
+    Put('B');
+    Put('T');
+    Put('1');
+    Put(debounceMs);
+    Put(debouncerInterruptMs);
+}
+
+void TraceRecorder::WritePass()
+{
+    passWritten_ = true;
+    if (!Reserve(2 * Trace::MaxRecordBytes)) return;
+    if (run_)
+    {
+        Put(Trace::Run);
+        PutVarint(run_);
+        run_ = 0;
+    }
+    if (!started_)
+    {
+        Put(Trace::Time);
+        PutVarint(passMs_);
+        started_ = true;
+        periodMs_ = 0;
+        return;
+    }
+    if (passMs_ - lastMs_ == periodMs_)
+    {
+        Put(Trace::Next);
+        return;
+    }
+    periodMs_ = passMs_ - lastMs_;
+    Put(Trace::Pass);
+    PutVarint(periodMs_);
+}
+
+void TraceRecorder::Layout(size_t buttonCount)
+{
+    if (!passWritten_) WritePass();
+    // room for all of it, so a full buffer never ends in a partial layout
+    if (!Reserve((buttonCount + 1) * Trace::MaxRecordBytes)) return;
+    Put(Trace::Layout);
+    PutVarint(buttonCount);
+}
+
+void TraceRecorder::LayoutButton(int buttonId, int gpio, bool downIsHigh)
+{
+    if (full_) return;
+    untraced_ |= !Trace::Traced(gpio);
+    PutVarint(static_cast<uint32_t>(buttonId));
+    PutVarint(static_cast<uint32_t>(gpio));
+    Put(downIsHigh ? 1 : 0);
+}
+
+void TraceRecorder::Finish()
+{
+    if (!headerWritten_) return; // no passes, no trace
+    if (run_ && Reserve())
+    {
+        Put(Trace::Run);
+        PutVarint(run_);
+        run_ = 0;
+    }
+    if (used_ < size_)
+        Put(Trace::End);
+    if (sink_ && used_)
+    {
+        sink_(buffer_, used_, user_);
+        flushed_ += used_;
+        used_ = 0;
+    }
+}
+
+bool TraceRecorder::Flush(size_t bytes)
+{
+    if (full_) return false;
+    if (sink_ && used_)
+    {
+        sink_(buffer_, used_, user_);
+        flushed_ += used_;
+        used_ = 0;
+    }
+    if (used_ + bytes < size_) return true;
+    full_ = true;
+    return false;
+}
+
+TraceReader::TraceReader(const uint8_t* bytes, size_t size)
+    : bytes_(bytes)
+    , size_(size)
+{
+    if (size < 6 || bytes[0] != 'L' || bytes[1] != 'B' || bytes[2] != 'T' || bytes[3] != '1')
+    {
+        printf("ERROR - not a button trace\n");
+        return;
+    }
+    debounceMs_ = bytes[4];
+    interruptMs_ = bytes[5];
+    pos_ = 6;
+    valid_ = true;
+}
+
+bool TraceReader::Varint(uint64_t& v)
+{
+    v = 0;
+    for (auto shift = 0; shift < 64; shift += 7)
+    {
+        if (pos_ >= size_) return false;
+        const uint8_t b = bytes_[pos_++];
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+bool TraceReader::Fail()
+{
+    printf("ERROR - bad trace record at byte %zu\n", pos_);
+    error_ = true;
+    runLeft_ = 0;
+    return false;
+}
+
+bool TraceReader::Next()
+{
+    if (!valid_ || error_) return false;
+    edges_.clear();
+    layoutChanged_ = false;
+    if (runLeft_)
+    {
+        --runLeft_;
+        nowMs_ += periodMs_;
+        ++passes_;
+        return true;
+    }
+
+    // a pass record, then the records of that pass
+    uint64_t v = 0;
+    if (pos_ >= size_) return false; // cut short, as by a full recorder
+    const uint8_t tag = bytes_[pos_++];
+    if (tag == Trace::End)
+        return false;
+    if (tag != Trace::Next && !Varint(v)) return Fail();
+    if (tag == Trace::Run)
+    {
+        if (!started_ || v == 0) return Fail();
+        runLeft_ = v;
+        return Next();
+    }
+    if (tag == Trace::Time)
+    {
+        nowMs_ = v;
+        periodMs_ = 0;
+        started_ = true;
+    }
+    else if (tag == Trace::Pass && started_)
+    {
+        nowMs_ += v;
+        periodMs_ = v;
+    }
+    else if (tag == Trace::Next && started_)
+        nowMs_ += periodMs_;
+    else
+        return Fail();
+    ++passes_;
+
+    while (pos_ < size_)
+    {
+        const uint8_t t = bytes_[pos_];
+        if (t == Trace::Levels)
+        {
+            ++pos_;
+            if (pos_ >= size_) return Fail();
+            const uint8_t port = bytes_[pos_++];
+            if (port >= Trace::MaxPorts || !Varint(v)) return Fail();
+            levels_[port] ^= static_cast<uint32_t>(v);
+        }
+        else if (t == Trace::Pin)
+        {
+            ++pos_;
+            if (pos_ >= size_ || bytes_[pos_] >= Trace::MaxPorts * 32) return Fail();
+            const uint8_t pin = bytes_[pos_++];
+            levels_[pin / 32] ^= 1U << (pin % 32);
+        }
+        else if (t == Trace::Edge)
+        {
+            ++pos_;
+            if (!Varint(v)) return Fail();
+            edges_.push_back(Edge{ static_cast<int>(v / 2), (v & 1) != 0 });
+        }
+        else if (t == Trace::Layout)
+        {
+            ++pos_;
+            uint64_t count = 0;
+            if (!Varint(count)) return Fail();
+            buttons_.clear();
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                uint64_t id = 0, gpio = 0;
+                if (!Varint(id) || !Varint(gpio) || pos_ >= size_) return Fail();
+                buttons_.push_back(ButtonInfo{ static_cast<int>(id), static_cast<int>(gpio), bytes_[pos_++] != 0 });
+            }
+            layoutChanged_ = true;
+        }
+        else
+            break;
+    }
+    return true;
+}